@@ -1,25 +1,38 @@
 #include "acceptor.h"
 
-struct acceptor* acceptor_new(int type, int port)
+struct acceptor* acceptor_new(int type, int port, int flags)
 {
+    int listenfd = -1;
     struct acceptor* acceptor = malloc(sizeof(struct acceptor));
     if (acceptor == NULL) goto failed; 
 
     int ret = 0;
 
-    // TODO:only using ipv4 server address for now, supporting ipv6 server address later
-    struct sockaddr_in servaddr;
+    /* wildcard address of the listening family, ipv6 socket also takes ipv4 clients as mapped addresses in dual-stack mode */
+    struct sockaddr_storage servaddr;
+    socklen_t servaddrLen;
+    int family = flags & (ACCEPTOR_IPV6 | ACCEPTOR_DUALSTACK) ? AF_INET6 : AF_INET;
     bzero(&servaddr, sizeof(servaddr));
-    servaddr.sin_addr.s_addr = AF_INET;
-    servaddr.sin_port = htons(port);
-    servaddr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (family == AF_INET6) {
+        struct sockaddr_in6* addr6 = (struct sockaddr_in6*)&servaddr;
+        addr6->sin6_family = AF_INET6;
+        addr6->sin6_port = htons(port);
+        addr6->sin6_addr = in6addr_any;
+        servaddrLen = sizeof(struct sockaddr_in6);
+    } else {
+        struct sockaddr_in* addr4 = (struct sockaddr_in*)&servaddr;
+        addr4->sin_family = AF_INET;
+        addr4->sin_port = htons(port);
+        addr4->sin_addr.s_addr = htonl(INADDR_ANY);
+        servaddrLen = sizeof(struct sockaddr_in);
+    }
     
-    int listenfd = -1;
+    /* non-blocking listening socket, not inherited by exec'd children */
     if (type == TCP_SERVER) {
-        listenfd = socket(AF_INET, SOCK_STREAM, 0);
+        listenfd = socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
         LOG(LT_INFO, "using tcp acceptor, listen fd = %d", listenfd);
     } else if (type == UDP_SERVER) {
-        listenfd = socket(AF_INET, SOCK_DGRAM, 0);
+        listenfd = socket(family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
         LOG(LT_INFO, "using udp acceptor, listen fd = %d", listenfd);
     } else {
         LOG(LT_FATAL_ERROR, "unknown server type %d", type);
@@ -30,8 +43,14 @@ struct acceptor* acceptor_new(int type, int port)
         goto failed;
     }
 
-    /* set listening socket to non-blocking */
-    make_nonblocking(listenfd);
+    if (family == AF_INET6) {
+        int v6only = flags & ACCEPTOR_DUALSTACK ? 0 : 1;
+        ret = setsockopt(listenfd, IPPROTO_IPV6, IPV6_V6ONLY, &v6only, sizeof(v6only));
+        if (ret < 0) {
+            LOG(LT_ERROR, "%s", strerror(errno));
+            goto failed;
+        }
+    }
 
     /* set SO_REUSEADDR on listening socket so that server can quickly restart by resuing SERVER_PORT even if it's in TIME_WAIT state after actively close */
     int on = 1;
@@ -41,7 +60,16 @@ struct acceptor* acceptor_new(int type, int port)
         goto failed;
     }
 
-    ret = bind(listenfd, (SA*)&servaddr, sizeof(servaddr));
+    /* every reactor binds its own listening socket to the same port, kernel hashes incoming connections among them */
+    if (flags & ACCEPTOR_REUSEPORT) {
+        ret = setsockopt(listenfd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+        if (ret < 0) {
+            LOG(LT_ERROR, "%s", strerror(errno));
+            goto failed;
+        }
+    }
+
+    ret = bind(listenfd, (SA*)&servaddr, servaddrLen);
     if (ret < 0) {
         LOG(LT_ERROR, "%s", strerror(errno));
         goto failed;
@@ -56,6 +84,9 @@ struct acceptor* acceptor_new(int type, int port)
     acceptor->listen_port = port;
     acceptor->listen_fd = listenfd;
     acceptor->connAccepted = 0;
+    acceptor->flags = flags;
+    acceptor->eventLoop = NULL;
+    acceptor->data = NULL;
 
     return acceptor;
 
@@ -66,8 +97,18 @@ failed:
     return NULL;
 }
 
+int acceptor_set_incoming_cpu(struct acceptor* acceptor, int cpu)
+{
+    if (setsockopt(acceptor->listen_fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu)) < 0) {
+        LOG(LT_WARN, "failed to set SO_INCOMING_CPU %d on listen fd %d, %s", cpu, acceptor->listen_fd, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
 void acceptor_cleanup(struct acceptor* acceptor)
 {
     if (acceptor == NULL) return;
     if (acceptor->listen_fd > 0) close(acceptor->listen_fd);
+    free(acceptor);
 }
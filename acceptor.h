@@ -2,6 +2,12 @@
 #define ACCEPTOR_H
 #include "common.h"
 
+#define ACCEPTOR_REUSEPORT 0x01     // SO_REUSEPORT, several acceptors share one port and kernel balances connections among them
+#define ACCEPTOR_IPV6 0x02          // listen on ipv6 wildcard address only
+#define ACCEPTOR_DUALSTACK 0x04     // listen on ipv6 wildcard address, ipv4 clients arrive as v4-mapped addresses
+
+struct event_loop;
+
 /* acceptor abstration, for server is listening socket */
 struct acceptor {
     /* server listening port */
@@ -10,10 +16,22 @@ struct acceptor {
     int listen_fd;
     /* totalnum of connections accepted by acceptor */
     long long connAccepted;
+    /* ACCEPTOR_* flags */
+    int flags;
+    /* event loop whose thread accepts on listen_fd */
+    struct event_loop* eventLoop;
+    /* for callback use: server */
+    void* data;
 };
 
-/* create and init a tcp/udp acceptor listening on certain port */
-struct acceptor* acceptor_new(int type, int port);
+/* create and init a tcp/udp acceptor listening on certain port, flags is a combination of ACCEPTOR_* */
+struct acceptor* acceptor_new(int type, int port, int flags);
+
+/**
+ * set SO_INCOMING_CPU on a SO_REUSEPORT listening socket, kernel prefers it for connections received on cpu
+ * only helps when the thread accepting on it runs on that cpu
+ */
+int acceptor_set_incoming_cpu(struct acceptor* acceptor, int cpu);
 
 /* clean up struct acceptor */
 void acceptor_cleanup(struct acceptor* acceptor);
@@ -0,0 +1,110 @@
+#define _GNU_SOURCE // cpu_set_t, pthread_attr_setaffinity_np
+#include "affinity.h"
+#include "log.h"
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+int affinity_attr_set_cpu(pthread_attr_t* attr, int cpu)
+{
+    if (cpu < 0 || cpu >= CPU_SETSIZE) return -1;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int ret = pthread_attr_setaffinity_np(attr, sizeof(set), &set);
+    if (ret != 0) {
+        LOG(LT_WARN, "failed to set affinity to cpu %d, %s", cpu, strerror(ret));
+        return -1;
+    }
+    return 0;
+}
+
+int affinity_attr_set_realtime(pthread_attr_t* attr, int priority)
+{
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = priority;
+    if (pthread_attr_setinheritsched(attr, PTHREAD_EXPLICIT_SCHED) != 0 ||
+        pthread_attr_setschedpolicy(attr, SCHED_FIFO) != 0 ||
+        pthread_attr_setschedparam(attr, &param) != 0) {
+        LOG(LT_WARN, "failed to set SCHED_FIFO priority %d", priority);
+        return -1;
+    }
+    return 0;
+}
+
+int affinity_pin_current(int cpu)
+{
+    if (cpu < 0 || cpu >= CPU_SETSIZE) return -1;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (ret != 0) {
+        LOG(LT_WARN, "failed to pin thread to cpu %d, %s", cpu, strerror(ret));
+        return -1;
+    }
+    return 0;
+}
+
+int affinity_set_current_realtime(int priority)
+{
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = priority;
+    int ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (ret != 0) {
+        LOG(LT_WARN, "failed to set SCHED_FIFO priority %d, %s", priority, strerror(ret));
+        return -1;
+    }
+    return 0;
+}
+
+int affinity_bind_memory_local()
+{
+    /* glibc has no wrapper and libnuma is not required, MPOL_LOCAL allocates on the node of the running cpu */
+    if (syscall(SYS_set_mempolicy, MPOL_LOCAL, NULL, 0) < 0) {
+        LOG(LT_WARN, "failed to bind memory to local node, %s", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+int affinity_cpu_node(int cpu)
+{
+    /* cpuN directory holds a nodeM link to the node it belongs to */
+    for (int node = 0; node < AFFINITY_MAX_CPUS; node++) {
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/node%d", cpu, node);
+        if (access(path, F_OK) == 0) return node;
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d", node);
+        if (access(path, F_OK) != 0) break;
+    }
+    return 0;
+}
+
+int affinity_isolated_cpus(int* cpus, int max)
+{
+    FILE* fp = fopen("/sys/devices/system/cpu/isolated", "r");
+    if (fp == NULL) return 0;
+    char line[256];
+    int n = 0;
+    if (fgets(line, sizeof(line), fp) != NULL) {
+        /* cpu list format: "2-5,8" */
+        char* save = NULL;
+        for (char* tok = strtok_r(line, ",\n", &save); tok != NULL; tok = strtok_r(NULL, ",\n", &save)) {
+            int lo, hi;
+            int nfield = sscanf(tok, "%d-%d", &lo, &hi);
+            if (nfield < 1) continue;
+            if (nfield == 1) hi = lo;
+            for (int cpu = lo; cpu <= hi && n < max; cpu++)
+                cpus[n++] = cpu;
+        }
+    }
+    fclose(fp);
+    return n;
+}
@@ -0,0 +1,36 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+#include <pthread.h>
+
+#define AFFINITY_CPU_UNBOUND -1     // thread left to scheduler
+#define AFFINITY_MAX_CPUS 1024
+
+/**
+ * cpu placement of reactor threads
+ * - a thread pinned to one cpu keeps its cache warm and is never migrated away from the NIC queue it serves;
+ * - memory a pinned reactor allocates is bound to the local node, so its loop, buffers and connections stay NUMA-local;
+ * - isolated cpus (kernel isolcpus=) are free of other tasks, realtime priority keeps remaining ones from preempting reactors.
+ */
+
+/* add cpu affinity to attr of a thread yet to be created, return -1 on failure */
+int affinity_attr_set_cpu(pthread_attr_t* attr, int cpu);
+
+/* add SCHED_FIFO with priority to attr of a thread yet to be created, return -1 on failure */
+int affinity_attr_set_realtime(pthread_attr_t* attr, int priority);
+
+/* pin calling thread to cpu, return -1 on failure */
+int affinity_pin_current(int cpu);
+
+/* run calling thread with SCHED_FIFO at priority, return -1 on failure, usually for lack of CAP_SYS_NICE */
+int affinity_set_current_realtime(int priority);
+
+/* allocate memory of calling thread from the node it runs on, regardless of policy inherited from process */
+int affinity_bind_memory_local();
+
+/* numa node of cpu, 0 if it can't be told */
+int affinity_cpu_node(int cpu);
+
+/* read isolated cpus from /sys/devices/system/cpu/isolated into cpus, return their count */
+int affinity_isolated_cpus(int* cpus, int max);
+
+#endif
@@ -1,13 +1,20 @@
 #include "buffer.h"
+#include "scan.h"
+#include <unistd.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
 
 const char* CRLF = "\r\n";
 
 struct buffer* buffer_new()
 {
-    struct buffer* buff = malloc(sizeof(struct buffer));
+    struct buffer* buff = calloc(1, sizeof(struct buffer));
     if (buff == NULL)
         goto failed;
 
+    buff->mode = BUFFER_MODE_FLAT;
     buff->size = INIT_BUFFER_SIZE + CHEAP_PREPEND_SIZE;
     buff->data = malloc(buff->size);
     if (buff->data == NULL)
@@ -19,65 +26,346 @@ struct buffer* buffer_new()
     return buff;
 
 failed:
-    if (buff->data != NULL)
-        free(buff->data);
     if (buff != NULL)
         free(buff);
     return NULL;
 }
 
+struct buffer* buffer_new_with_pool(struct buffer_pool* pool)
+{
+    if (pool == NULL)
+        return buffer_new();
+
+    struct buffer* buff = calloc(1, sizeof(struct buffer));
+    if (buff == NULL)
+        return NULL;
+    /* storage is taken from pool on first use, by the thread owning the pool */
+    buff->mode = BUFFER_MODE_FLAT;
+    buff->pool = pool;
+    buff->readIdx = CHEAP_PREPEND_SIZE;
+    buff->writeIdx = CHEAP_PREPEND_SIZE;
+    return buff;
+}
+
+struct buffer* buffer_chain_new(struct buffer_pool* pool)
+{
+    struct buffer* buff = calloc(1, sizeof(struct buffer));
+    if (buff == NULL)
+        return NULL;
+    /* blocks are allocated on first append or read */
+    buff->mode = BUFFER_MODE_CHAIN;
+    buff->pool = pool;
+    return buff;
+}
+
+static struct buffer_block* buffer_block_get(struct buffer* buff)
+{
+    struct buffer_block* block = buff->spare;
+    if (block != NULL) {
+        buff->spare = block->next;
+        buff->nspare--;
+    } else {
+        size_t realSize;
+        block = buffer_pool_alloc(buff->pool, BUFFER_BLOCK_SIZE, &realSize);
+        if (block == NULL)
+            return NULL;
+        block->size = realSize - sizeof(struct buffer_block);
+    }
+    block->type = BUFFER_BLOCK_MEMORY;
+    block->fd = -1;
+    block->offset = 0;
+    block->shared = NULL;
+    block->release = NULL;
+    block->releaseArg = NULL;
+    block->zcPinned = 0;
+    block->zcSeq = 0;
+    block->next = NULL;
+    block->readIdx = 0;
+    block->writeIdx = 0;
+    return block;
+}
+
+/* readable bytes of a memory or shared block start here, minus readIdx */
+static inline char* buffer_block_bytes(struct buffer_block* block)
+{
+    return block->type == BUFFER_BLOCK_SHARED ? (char*)block->shared : block->data;
+}
+
+/* give back a block allocated by malloc(), what it references is released by its owner */
+static void buffer_block_destroy(struct buffer_block* block)
+{
+    if (block->release != NULL)
+        block->release(block->releaseArg);
+    free(block);
+}
+
+static void buffer_block_free(struct buffer* buff, struct buffer_block* block)
+{
+    if (block->type != BUFFER_BLOCK_MEMORY) {
+        buffer_block_destroy(block);
+        return;
+    }
+    buffer_pool_free(buff->pool, block, block->size + sizeof(struct buffer_block));
+}
+
+/* consumed blocks go back to pool when there is one, pool is the cache shared by all buffers of a loop */
+static void buffer_block_put(struct buffer* buff, struct buffer_block* block)
+{
+    if (block->type != BUFFER_BLOCK_MEMORY || buff->pool != NULL || buff->nspare >= BUFFER_MAX_SPARE) {
+        buffer_block_free(buff, block);
+        return;
+    }
+    block->next = buff->spare;
+    buff->spare = block;
+    buff->nspare++;
+}
+
+static void buffer_block_link(struct buffer* buff, struct buffer_block* block)
+{
+    if (buff->tail == NULL) {
+        buff->head = buff->tail = block;
+    } else {
+        buff->tail->next = block;
+        buff->tail = block;
+    }
+}
+
 size_t buffer_readable_size(struct buffer* buff)
 {
+    if (buff->mode == BUFFER_MODE_CHAIN)
+        return buff->chainSize;
     return buff->writeIdx - buff->readIdx;
 }
 
 size_t buffer_writeable_size(struct buffer* buff)
 {
+    if (buff->mode == BUFFER_MODE_CHAIN)
+        return buff->tail == NULL ? 0 : buff->tail->size - buff->tail->writeIdx;
     return buff->size - buff->writeIdx;
 }
 
 size_t buffer_prependable_size(struct buffer* buff)
 {
+    if (buff->mode == BUFFER_MODE_CHAIN)
+        return buff->head == NULL ? 0 : buff->head->readIdx;
     return buff->readIdx;
 }
 
+char* buffer_peek(struct buffer* buff, size_t* len)
+{
+    if (buff->mode == BUFFER_MODE_FLAT && buff->data == NULL) {
+        *len = 0;
+        return NULL;
+    }
+    if (buff->mode == BUFFER_MODE_CHAIN) {
+        struct buffer_block* head = buff->head;
+        if (head == NULL) {
+            *len = 0;
+            return NULL;
+        }
+        if (head->type == BUFFER_BLOCK_FILE) {
+            *len = 0;
+            return NULL;
+        }
+        *len = head->writeIdx - head->readIdx;
+        return buffer_block_bytes(head) + head->readIdx;
+    }
+    *len = buffer_readable_size(buff);
+    return &buff->data[buff->readIdx];
+}
+
+static void buffer_storage_release(struct buffer* buff)
+{
+    buffer_pool_free(buff->pool, buff->data, buff->size);
+    buff->data = NULL;
+    buff->size = 0;
+}
+
+/* consumed block whose bytes may still be read by kernel waits on pending list for zerocopy completion */
+static void buffer_block_pend(struct buffer* buff, struct buffer_block* block)
+{
+    block->next = NULL;
+    if (buff->zcPendingTail == NULL) {
+        buff->zcPendingHead = buff->zcPendingTail = block;
+    } else {
+        buff->zcPendingTail->next = block;
+        buff->zcPendingTail = block;
+    }
+}
+
+static void buffer_block_retire(struct buffer* buff, struct buffer_block* block)
+{
+    if (block->zcPinned)
+        buffer_block_pend(buff, block);
+    else
+        buffer_block_put(buff, block);
+}
+
+void buffer_drain(struct buffer* buff, size_t size)
+{
+    if (buff->mode == BUFFER_MODE_FLAT) {
+        assert(size <= buffer_readable_size(buff));
+        buff->readIdx += size;
+        if (buff->readIdx == buff->writeIdx) { // no readable bytes, reset readIdx writeIdx to front
+            buff->readIdx = CHEAP_PREPEND_SIZE;
+            buff->writeIdx = CHEAP_PREPEND_SIZE;
+            /* pooled storage is given back as soon as it's idle */
+            if (buff->pool != NULL)
+                buffer_storage_release(buff);
+        }
+        return;
+    }
+
+    assert(size <= buff->chainSize);
+    buff->chainSize -= size;
+    while (size > 0) {
+        struct buffer_block* head = buff->head;
+        size_t readable = head->writeIdx - head->readIdx;
+        if (size < readable) {
+            head->readIdx += size;
+            return;
+        }
+        size -= readable;
+        /* block fully consumed, keep tail block for appending, unless pool can take it back */
+        if (head == buff->tail) {
+            if (buff->pool != NULL || head->type != BUFFER_BLOCK_MEMORY || head->zcPinned) {
+                buff->head = buff->tail = NULL;
+                buffer_block_retire(buff, head);
+            } else {
+                head->readIdx = head->writeIdx = 0;
+            }
+            return;
+        }
+        buff->head = head->next;
+        buffer_block_retire(buff, head);
+    }
+}
+
 static void ensure_space(struct buffer* buff, size_t need)
 {
     size_t writeableSize = buffer_writeable_size(buff);
-    if (writeableSize >= need) // back space enough
+    if (buff->data != NULL && writeableSize >= need) // back space enough
         return;
 
     size_t readableSize = buffer_readable_size(buff);
     size_t prependableSize = buffer_prependable_size(buff);
 
-    if (writeableSize + prependableSize >= need) { // avaliable space enough, trigger move copy
-        memcpy(buff->data + CHEAP_PREPEND_SIZE, buff + buff->readIdx, readableSize);
+    if (buff->data != NULL && writeableSize + prependableSize >= need + CHEAP_PREPEND_SIZE) { // avaliable space enough, trigger move copy
+        memmove(buff->data + CHEAP_PREPEND_SIZE, buff->data + buff->readIdx, readableSize);
         buff->readIdx = CHEAP_PREPEND_SIZE;
         buff->writeIdx = buff->readIdx + readableSize;
-    } else { // avaliable space not enough, trigger realloc.
-        // TODO: how about combine prependable space in this step
-        size_t nsize = buff->size;
-        while (nsize < buff->size + need) nsize <<= 1;
-        LOG(LT_INFO, "buffer size incresing from %zu to %zu", buff->size, nsize);
-        char* tmp = realloc(buff->data, nsize);
+    } else { // avaliable space not enough, move readable bytes to a larger storage, prependable space is combined in this step
+        size_t nsize = buff->size > 0 ? buff->size : INIT_BUFFER_SIZE + CHEAP_PREPEND_SIZE;
+        while (nsize < CHEAP_PREPEND_SIZE + readableSize + need) nsize = ((nsize - CHEAP_PREPEND_SIZE) << 1) + CHEAP_PREPEND_SIZE;
+        if (buff->data != NULL)
+            LOG(LT_DEBUG, "buffer size incresing from %zu to %zu", buff->size, nsize);
+        char* tmp = buffer_pool_alloc(buff->pool, nsize, &nsize);
         assert(tmp != NULL);
+        if (buff->data != NULL) {
+            memcpy(tmp + CHEAP_PREPEND_SIZE, buff->data + buff->readIdx, readableSize);
+            buffer_storage_release(buff);
+        }
         buff->data = tmp;
         buff->size = nsize;
+        buff->readIdx = CHEAP_PREPEND_SIZE;
+        buff->writeIdx = buff->readIdx + readableSize;
+    }
+}
+
+static size_t buffer_chain_append(struct buffer* buff, const char* data, size_t size)
+{
+    size_t nleft = size;
+    while (nleft > 0) {
+        struct buffer_block* tail = buff->tail;
+        if (tail == NULL || tail->writeIdx == tail->size) {
+            tail = buffer_block_get(buff);
+            assert(tail != NULL);
+            buffer_block_link(buff, tail);
+        }
+        size_t n = tail->size - tail->writeIdx;
+        if (n > nleft) n = nleft;
+        memcpy(&tail->data[tail->writeIdx], data, n);
+        tail->writeIdx += n;
+        data += n;
+        nleft -= n;
     }
+    buff->chainSize += size;
+    return size;
 }
 
 size_t buffer_append(struct buffer* buff, const void* data, size_t size)
 {
     if (data == NULL)
         return 0;
+    if (buff->mode == BUFFER_MODE_CHAIN)
+        return buffer_chain_append(buff, data, size);
     ensure_space(buff, size);
     memcpy(&buff->data[buff->writeIdx], data, size);
     buff->writeIdx += size;
     return size;
 }
 
+size_t buffer_append_file(struct buffer* buff, int fd, off_t offset, size_t len)
+{
+    return buffer_append_file_shared(buff, fd, offset, len, NULL, NULL);
+}
+
+size_t buffer_append_file_shared(struct buffer* buff, int fd, off_t offset, size_t len, buffer_release_callback release, void* arg)
+{
+    assert(buff->mode == BUFFER_MODE_CHAIN);
+    if (len == 0) {
+        if (release != NULL)
+            release(arg);
+        return 0;
+    }
+    struct buffer_block* block = malloc(sizeof(struct buffer_block));
+    assert(block != NULL);
+    block->next = NULL;
+    block->type = BUFFER_BLOCK_FILE;
+    block->zcPinned = 0;
+    block->zcSeq = 0;
+    block->fd = fd;
+    block->offset = offset;
+    block->shared = NULL;
+    block->release = release;
+    block->releaseArg = arg;
+    block->readIdx = 0;
+    block->writeIdx = block->size = len; // full, bytes appended later go to a new memory block
+    buffer_block_link(buff, block);
+    buff->chainSize += len;
+    return len;
+}
+
+size_t buffer_append_shared(struct buffer* buff, const void* data, size_t len, buffer_release_callback release, void* arg)
+{
+    assert(buff->mode == BUFFER_MODE_CHAIN);
+    if (len == 0) {
+        if (release != NULL)
+            release(arg);
+        return 0;
+    }
+    struct buffer_block* block = malloc(sizeof(struct buffer_block));
+    assert(block != NULL);
+    block->next = NULL;
+    block->type = BUFFER_BLOCK_SHARED;
+    block->zcPinned = 0;
+    block->zcSeq = 0;
+    block->fd = -1;
+    block->offset = 0;
+    block->shared = data;
+    block->release = release;
+    block->releaseArg = arg;
+    block->readIdx = 0;
+    block->writeIdx = block->size = len; // full, bytes appended later go to a new memory block
+    buffer_block_link(buff, block);
+    buff->chainSize += len;
+    return len;
+}
+
 size_t buffer_append_char(struct buffer* buff, char c)
 {
+    if (buff->mode == BUFFER_MODE_CHAIN)
+        return buffer_chain_append(buff, &c, 1);
     ensure_space(buff, 1);
     buff->data[buff->writeIdx++] = c;
     return 1;
@@ -97,48 +385,363 @@ size_t buffer_append_string(struct buffer* buff, const char* str)
 
 char* buffer_find_CRLF(struct buffer* buff)
 {
-    char* crlf = memmem(&buff->data[buff->readIdx], buffer_readable_size(buff), CRLF, 2);
-    return crlf;
+    assert(buff->mode == BUFFER_MODE_FLAT);
+    if (buff->data == NULL)
+        return NULL;
+    size_t n = buffer_readable_size(buff);
+    size_t off = scan_crlf(&buff->data[buff->readIdx], n);
+    return off < n ? &buff->data[buff->readIdx + off] : NULL;
 }
 
-char buffer_read_char(struct buffer* buff)
+/* a pattern of patlen bytes may straddle the end of readable bytes, keep its first patlen-1 bytes for next scan */
+static ssize_t buffer_scan_result(size_t n, size_t from, size_t off, size_t patlen, size_t* scanned)
 {
-    char c = buff->data[buff->readIdx++];
-    if (buff->readIdx == buff->writeIdx) { // no readable bytes, reset readIdx writeIdx to front
-        buff->readIdx = CHEAP_PREPEND_SIZE;
-        buff->writeIdx = CHEAP_PREPEND_SIZE;
+    if (from + off < n) {
+        *scanned = from + off;
+        return from + off;
     }
+    *scanned = n >= patlen - 1 ? n - (patlen - 1) : 0;
+    if (*scanned < from) *scanned = from;
+    return -1;
+}
+
+ssize_t buffer_find_byte(struct buffer* buff, char c, size_t* scanned)
+{
+    assert(buff->mode == BUFFER_MODE_FLAT);
+    size_t n = buffer_readable_size(buff);
+    size_t from = *scanned;
+    if (buff->data == NULL || from >= n) return -1;
+    return buffer_scan_result(n, from, scan_byte(&buff->data[buff->readIdx + from], n - from, c), 1, scanned);
+}
+
+ssize_t buffer_find_CRLF_from(struct buffer* buff, size_t* scanned)
+{
+    assert(buff->mode == BUFFER_MODE_FLAT);
+    size_t n = buffer_readable_size(buff);
+    size_t from = *scanned;
+    if (buff->data == NULL || from >= n) return -1;
+    return buffer_scan_result(n, from, scan_crlf(&buff->data[buff->readIdx + from], n - from), 2, scanned);
+}
+
+ssize_t buffer_find_CRLFCRLF(struct buffer* buff, size_t* scanned)
+{
+    assert(buff->mode == BUFFER_MODE_FLAT);
+    size_t n = buffer_readable_size(buff);
+    size_t from = *scanned;
+    if (buff->data == NULL || from >= n) return -1;
+    return buffer_scan_result(n, from, scan_crlfcrlf(&buff->data[buff->readIdx + from], n - from), 4, scanned);
+}
+
+int buffer_read_char(struct buffer* buff)
+{
+    size_t len;
+    char* data = buffer_peek(buff, &len);
+    if (data == NULL || len == 0)
+        return -1;
+    unsigned char c = *data;
+    buffer_drain(buff, 1);
     return c;
 }
 
+/**
+ * chain mode: readv() into free space of tail block followed by BUFFER_READ_BLOCKS fresh blocks,
+ * fresh blocks which receive no bytes go back to spare list, no byte is copied after reading.
+ */
+static ssize_t buffer_chain_read_fd(struct buffer* buff, int fd)
+{
+    struct iovec vec[BUFFER_READ_BLOCKS + 1];
+    struct buffer_block* fresh[BUFFER_READ_BLOCKS];
+    int nvec = 0, nfresh = 0;
+
+    struct buffer_block* tail = buff->tail;
+    if (tail != NULL && tail->writeIdx < tail->size) {
+        vec[nvec].iov_base = &tail->data[tail->writeIdx];
+        vec[nvec].iov_len = tail->size - tail->writeIdx;
+        nvec++;
+    }
+    while (nfresh < BUFFER_READ_BLOCKS) {
+        struct buffer_block* block = buffer_block_get(buff);
+        if (block == NULL) break;
+        fresh[nfresh++] = block;
+        vec[nvec].iov_base = block->data;
+        vec[nvec].iov_len = block->size;
+        nvec++;
+    }
+
+    ssize_t n = readv(fd, vec, nvec);
+    if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+        LOG(LT_ERROR, "failed to readv fd %d, %s", fd, strerror(errno));
+
+    size_t nleft = n > 0 ? n : 0;
+    buff->chainSize += nleft;
+    if (tail != NULL && tail->writeIdx < tail->size) {
+        size_t m = tail->size - tail->writeIdx;
+        if (m > nleft) m = nleft;
+        tail->writeIdx += m;
+        nleft -= m;
+    }
+    for (int i = 0; i < nfresh; i++) {
+        if (nleft > 0) {
+            size_t m = fresh[i]->size < nleft ? fresh[i]->size : nleft;
+            fresh[i]->writeIdx = m;
+            nleft -= m;
+            buffer_block_link(buff, fresh[i]);
+        } else {
+            buffer_block_put(buff, fresh[i]);
+        }
+    }
+    return n;
+}
+
 ssize_t buffer_read_fd(struct buffer* buff, int fd)
 {
     assert(fd > 0);
-    char stackBuffer[INIT_BUFFER_SIZE]; // NOTE: temporary stack buffer struct iovec vec[2];
-    size_t writeableSize = buffer_writeable_size(buff);
+    if (buff->mode == BUFFER_MODE_CHAIN)
+        return buffer_chain_read_fd(buff, fd);
+
+    /* no storage held, e.g. pooled buffer drained idle: read into stack buffer only, so that a wakeup
+     * without bytes takes nothing from the pool, storage is allocated by buffer_append() once bytes arrive */
+    char stackBuffer[INIT_BUFFER_SIZE]; // NOTE: temporary stack buffer
+    size_t writeableSize = buff->data != NULL ? buffer_writeable_size(buff) : 0;
     struct iovec vec[2];
-    vec[0].iov_base = &buff->data[buff->writeIdx];
-    vec[0].iov_len = writeableSize;
-    vec[1].iov_base = stackBuffer;
-    vec[1].iov_len = sizeof(stackBuffer);
-    ssize_t n = readv(fd, vec, 2);
+    int nvec = 0;
+    if (writeableSize > 0) {
+        vec[nvec].iov_base = &buff->data[buff->writeIdx];
+        vec[nvec].iov_len = writeableSize;
+        nvec++;
+    }
+    vec[nvec].iov_base = stackBuffer;
+    vec[nvec].iov_len = sizeof(stackBuffer);
+    nvec++;
+    ssize_t n = readv(fd, vec, nvec);
     if (n < 0) {
-        LOG(LT_ERROR, "failed to readv fd %d, %s", fd, strerror(errno));
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            LOG(LT_ERROR, "failed to readv fd %d, %s", fd, strerror(errno));
         return -1;
     } else if (n <= writeableSize) { // read no bytes to tmpBuffer
         buff->writeIdx += n;
     } else { // read n - writeableSize bytes to tmpBuffer
-        buff->writeIdx = buff->size;
+        buff->writeIdx += writeableSize;
         buffer_append(buff, stackBuffer, n - writeableSize);
     }
     return n;
 }
 
+/* send readable part of the file block at head, file bytes go from page cache to socket directly */
+static ssize_t buffer_block_sendfile(struct buffer* buff, int fd, size_t* want)
+{
+    struct buffer_block* head = buff->head;
+    off_t offset = head->offset + head->readIdx;
+    *want = head->writeIdx - head->readIdx;
+    ssize_t n = sendfile(fd, head->fd, &offset, *want);
+    if (n == 0) {
+        /* file shrank after being queued, the rest of region is consumed as if sent instead of spinning on it,
+         * so that caller drains and accounts for it like any written bytes and goes on with the next segment */
+        LOG(LT_WARN, "file fd %d reached EOF with %zu bytes left to send", head->fd, *want);
+        return *want;
+    }
+    return n;
+}
+
+/* writev() memory blocks from head up to the first file block */
+static ssize_t buffer_chain_writev(struct buffer* buff, int fd, size_t* want)
+{
+    struct iovec vec[BUFFER_MAX_IOV];
+    int nvec = 0;
+    *want = 0;
+    for (struct buffer_block* block = buff->head; block != NULL && nvec < BUFFER_MAX_IOV; block = block->next) {
+        if (block->type == BUFFER_BLOCK_FILE) break;
+        if (block->writeIdx == block->readIdx) continue;
+        vec[nvec].iov_base = buffer_block_bytes(block) + block->readIdx;
+        vec[nvec].iov_len = block->writeIdx - block->readIdx;
+        *want += vec[nvec].iov_len;
+        nvec++;
+    }
+    if (nvec == 0) return 0;
+
+    if (buff->zerocopyThreshold > 0 && *want >= buff->zerocopyThreshold) {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = vec;
+        msg.msg_iovlen = nvec;
+        ssize_t n = sendmsg(fd, &msg, MSG_ZEROCOPY);
+        if (n >= 0) {
+            /* kernel numbers every successful zerocopy send, pin the blocks it references */
+            uint32_t seq = buff->zcNextSeq++;
+            size_t nleft = n;
+            for (struct buffer_block* block = buff->head; block != NULL && nleft > 0; block = block->next) {
+                size_t readable = block->writeIdx - block->readIdx;
+                if (readable == 0) continue;
+                block->zcPinned = 1;
+                block->zcSeq = seq;
+                nleft -= readable < nleft ? readable : nleft;
+            }
+            buff->zcSends++;
+            return n;
+        }
+        /* ENOBUFS when optmem limit is reached, copy this time */
+        if (errno != ENOBUFS) return n;
+    }
+    return writev(fd, vec, nvec);
+}
+
+ssize_t buffer_write_fd(struct buffer* buff, int fd)
+{
+    ssize_t n;
+    if (buff->mode == BUFFER_MODE_FLAT) {
+        if (buff->data == NULL) return 0;
+        n = write(fd, &buff->data[buff->readIdx], buffer_readable_size(buff));
+        if (n > 0)
+            buffer_drain(buff, n);
+        return n;
+    }
+
+    /* keep writing segments in order until buffer is empty or fd accepts less than offered */
+    ssize_t nwritten = 0;
+    while (buff->chainSize > 0) {
+        size_t want = 0;
+        if (buff->head->type == BUFFER_BLOCK_FILE)
+            n = buffer_block_sendfile(buff, fd, &want);
+        else
+            n = buffer_chain_writev(buff, fd, &want);
+        if (n < 0) return nwritten > 0 ? nwritten : -1;
+        if (n > 0) {
+            buffer_drain(buff, n);
+            nwritten += n;
+        }
+        if (n == 0 || (size_t)n < want) break;
+    }
+    return nwritten;
+}
+
+size_t buffer_move(struct buffer* dst, struct buffer* src)
+{
+    size_t size = buffer_readable_size(src);
+    if (size == 0)
+        return 0;
+    if (dst->mode != BUFFER_MODE_CHAIN || src->mode != BUFFER_MODE_CHAIN) {
+        size_t len;
+        char* data;
+        while ((data = buffer_peek(src, &len)) != NULL && len > 0) {
+            buffer_append(dst, data, len);
+            buffer_drain(src, len);
+        }
+        return size;
+    }
+
+    /* splice the block list, blocks later go back to dst's pool, which is fine since storage sizes are the same */
+    if (dst->tail == NULL) {
+        dst->head = src->head;
+    } else {
+        dst->tail->next = src->head;
+    }
+    dst->tail = src->tail;
+    dst->chainSize += src->chainSize;
+    src->head = src->tail = NULL;
+    src->chainSize = 0;
+    return size;
+}
+
+/* a before b, sequence numbers wrap around */
+static int zc_seq_before(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) < 0;
+}
+
+/* merge completed range [lo, hi] into completion watermark */
+static void buffer_zerocopy_advance(struct buffer* buff, uint32_t lo, uint32_t hi)
+{
+    if (zc_seq_before(buff->zcCompleted, lo)) {
+        /* completed out of order, remember it until the gap is filled */
+        if (buff->nzcRange < BUFFER_ZEROCOPY_MAX_RANGES) {
+            buff->zcRanges[buff->nzcRange][0] = lo;
+            buff->zcRanges[buff->nzcRange][1] = hi;
+            buff->nzcRange++;
+        } else {
+            LOG(LT_WARN, "too many out-of-order zerocopy completions, range [%u, %u] dropped", lo, hi);
+        }
+        return;
+    }
+    if (zc_seq_before(hi, buff->zcCompleted)) return;
+    buff->zcCompleted = hi + 1;
+
+    /* remembered ranges may be contiguous now */
+    int merged = 1;
+    while (merged) {
+        merged = 0;
+        for (int i = 0; i < buff->nzcRange; i++) {
+            if (zc_seq_before(buff->zcCompleted, buff->zcRanges[i][0])) continue;
+            if (!zc_seq_before(buff->zcRanges[i][1], buff->zcCompleted))
+                buff->zcCompleted = buff->zcRanges[i][1] + 1;
+            buff->zcRanges[i][0] = buff->zcRanges[buff->nzcRange - 1][0];
+            buff->zcRanges[i][1] = buff->zcRanges[buff->nzcRange - 1][1];
+            buff->nzcRange--;
+            merged = 1;
+            break;
+        }
+    }
+}
+
+int buffer_zerocopy_complete(struct buffer* buff, int fd)
+{
+    int ncompleted = 0;
+    char control[128];
+    struct msghdr msg;
+
+    while (1) {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(fd, &msg, MSG_ERRQUEUE) < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                LOG(LT_WARN, "failed to read error queue of fd %d, %s", fd, strerror(errno));
+            break;
+        }
+        for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm)) {
+            if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+                !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))
+                continue;
+            struct sock_extended_err* serr = (struct sock_extended_err*)CMSG_DATA(cm);
+            if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+                continue;
+            /* notifications of consecutive sends are coalesced into range [ee_info, ee_data] */
+            if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+                buff->zcCopied++;
+            ncompleted += serr->ee_data - serr->ee_info + 1;
+            buffer_zerocopy_advance(buff, serr->ee_info, serr->ee_data);
+        }
+    }
+
+    while (buff->zcPendingHead != NULL && zc_seq_before(buff->zcPendingHead->zcSeq, buff->zcCompleted)) {
+        struct buffer_block* block = buff->zcPendingHead;
+        buff->zcPendingHead = block->next;
+        if (buff->zcPendingHead == NULL) buff->zcPendingTail = NULL;
+        block->zcPinned = 0;
+        buffer_block_put(buff, block);
+    }
+    return ncompleted;
+}
+
+int buffer_zerocopy_pending(struct buffer* buff)
+{
+    return buff->zcPendingHead != NULL;
+}
+
 void buffer_show_content(struct buffer* buff)
 {
+    printf("buffer: [");
+    if (buff->mode == BUFFER_MODE_CHAIN) {
+        for (struct buffer_block* block = buff->head; block != NULL; block = block->next) {
+            if (block->type == BUFFER_BLOCK_FILE)
+                printf("<file fd = %d, offset = %lld, len = %zu>", block->fd, (long long)(block->offset + block->readIdx), block->writeIdx - block->readIdx);
+            else
+                printf("%.*s", (int)(block->writeIdx - block->readIdx), buffer_block_bytes(block) + block->readIdx);
+        }
+        printf("]\n");
+        return;
+    }
     size_t idx = buff->readIdx;
     size_t left = buffer_readable_size(buff);
-    printf("buffer: [");
     while (left > 0) {
         printf("%c", buff->data[idx++]);
         left--;
@@ -146,10 +749,27 @@ void buffer_show_content(struct buffer* buff)
     printf("]\n");
 }
 
+/* pinned blocks are left alone, kernel may still read them, see buffer_cleanup() */
+static void buffer_block_list_free(struct buffer* buff, struct buffer_block* block)
+{
+    while (block != NULL) {
+        struct buffer_block* next = block->next;
+        if (!block->zcPinned)
+            buffer_block_free(buff, block);
+        block = next;
+    }
+}
+
 void buffer_cleanup(struct buffer* buff)
 {
+    if (buff == NULL)
+        return;
     if (buff->data != NULL)
-        free(buff->data);
-    if (buff != NULL)
-        free(buff);
+        buffer_storage_release(buff);
+    /* owner waits for zerocopy completions before cleaning up, storage kernel may still read is never freed */
+    if (buff->zcPendingHead != NULL)
+        LOG(LT_WARN, "buffer cleaned up with zerocopy sends pending, their blocks are leaked");
+    buffer_block_list_free(buff, buff->head);
+    buffer_block_list_free(buff, buff->spare);
+    free(buff);
 }
@@ -5,18 +5,63 @@
 #include <string.h>
 #include <sys/uio.h>
 #include <assert.h>
+#include <sys/types.h>
+#include <stdint.h>
+#include "buffer_pool.h"
 
 #define INIT_BUFFER_SIZE (1 << 16)  // 64kb
 #define MAX_BUFFER_SIZE
 #define CHEAP_PREPEND_SIZE 8     // append in front of data at low cost, space for time
 
+#define BUFFER_MODE_FLAT 0       // one contiguous array, realloc when full
+#define BUFFER_MODE_CHAIN 1      // list of fixed-size blocks, queued bytes never move
+
+#define BUFFER_BLOCK_SIZE (1 << 14) // 16kb, storage of every block in chain mode, header included
+#define BUFFER_READ_BLOCKS 4        // fresh blocks offered to one readv() in chain mode
+#define BUFFER_MAX_SPARE 4          // empty blocks cached by a chain buffer for reuse
+#define BUFFER_MAX_IOV 16           // max iovec count of one writev() in chain mode
+
+#define BUFFER_BLOCK_MEMORY 0       // bytes stored in block data
+#define BUFFER_BLOCK_FILE 1         // file region [offset, offset + size) of fd, sent by sendfile()
+#define BUFFER_BLOCK_SHARED 2       // bytes owned by someone else, referenced in place until block is freed
+
+#define BUFFER_ZEROCOPY_MAX_RANGES 8 // out-of-order zerocopy completion ranges remembered by a buffer
+
+typedef void (*buffer_release_callback)(void* arg);
+
+/**
+ * fixed-size block of a chain mode buffer
+ *
+ * |  consumed  |  readable | writeable |
+ * 0         readIdx    writeIdx     size
+ *
+ * a file block holds no data, readIdx counts bytes of the file region already sent and writeIdx = size = region length,
+ * a shared block likewise points to bytes it doesn't own, they are sent from where they are
+ */
+struct buffer_block {
+    struct buffer_block* next;
+    size_t readIdx;
+    size_t writeIdx;
+    size_t size;
+    int type;
+    int fd;         // file block only
+    off_t offset;   // file block only
+    const char* shared; // shared block only
+    buffer_release_callback release; // file and shared block, called with releaseArg once block is freed, e.g. to drop a reference
+    void* releaseArg;
+    int zcPinned;   // bytes of block were sent with MSG_ZEROCOPY, kernel may still read them
+    uint32_t zcSeq; // sequence number of the latest zerocopy send covering this block
+    char data[];
+};
+
 /**
  * self-adaptable application-level buffer
  * non-thread-safe, but using safely
  *
+ * flat mode:
  * | prependable |  readable | writeable |
  * ---------------------------------------
- * |             |  content  |           |     
+ * |             |  content  |           |
  * ---------------------------------------
  * 0          readIdx     writeIdx    size()
  * invariants:
@@ -24,17 +69,60 @@
  * - prependable = readIdx;
  * - readable = writeIdx - readIdx;
  * - writeable = size() - writeIdx;
+ *
+ * chain mode:
+ * head -> [block] -> [block] -> ... -> [block] <- tail
+ * - appending never moves bytes already queued, a new block is linked when tail is full;
+ * - readable = chainSize, bytes of all blocks from head to tail, file regions included;
+ * - file regions are queued as file blocks in order with other bytes, they never pass through user space;
+ * - with zerocopy enabled, large writes use sendmsg(MSG_ZEROCOPY), blocks consumed by such sends stay pinned
+ *   in a pending list until kernel reports their completion on socket error queue;
+ * - fully consumed blocks are unlinked from head and kept as spare (or returned to pool) for later appending.
+ * chain mode is meant for output buffers, which are only appended and drained by readv()/writev(),
+ * APIs that need contiguous readable bytes (buffer_find_CRLF) only work in flat mode.
+ *
+ * storage (flat data or chain blocks) of a buffer created with a pool is taken from and returned to that pool,
+ * flat storage is allocated on first use and given back whenever buffer becomes empty,
+ * so that idle connections hold no storage.
  */
 struct buffer {
+    int mode;
+    struct buffer_pool* pool;
+
+    /* flat mode */
     char* data;
     size_t readIdx;
     size_t writeIdx;
     size_t size;
+
+    /* chain mode */
+    struct buffer_block* head;
+    struct buffer_block* tail;
+    struct buffer_block* spare;
+    int nspare;
+    size_t chainSize;
+
+    /* MSG_ZEROCOPY, chain mode only */
+    size_t zerocopyThreshold;               // writev() of at least this many bytes uses MSG_ZEROCOPY, 0 to disable
+    uint32_t zcNextSeq;                     // sequence number of next zerocopy send, counted by kernel per socket
+    uint32_t zcCompleted;                   // every zerocopy send numbered below it has completed
+    uint32_t zcRanges[BUFFER_ZEROCOPY_MAX_RANGES][2]; // completed ranges beyond zcCompleted
+    int nzcRange;
+    struct buffer_block* zcPendingHead;     // consumed blocks still pinned by kernel, in sequence order
+    struct buffer_block* zcPendingTail;
+    unsigned long zcSends;
+    unsigned long zcCopied;                 // completions for which kernel fell back to copying
 };
 
 /* 分配并初始化一块应用层缓冲区 */
 struct buffer* buffer_new();
 
+/* 分配并初始化一块应用层缓冲区，存储空间从pool中获取，pool可为NULL */
+struct buffer* buffer_new_with_pool(struct buffer_pool* pool);
+
+/* 分配并初始化一块分段链式缓冲区，数据块从pool中获取，pool可为NULL */
+struct buffer* buffer_chain_new(struct buffer_pool* pool);
+
 /* 获取缓冲区当前可读字节数 */
 size_t buffer_readable_size(struct buffer* buff);
 
@@ -44,6 +132,12 @@ size_t buffer_writeable_size(struct buffer* buff);
 /* 获取缓冲区当前首部可写空间字节大小 */
 size_t buffer_prependable_size(struct buffer* buff);
 
+/* 获取缓冲区首段连续可读数据的起始地址，len返回其长度；首段为文件区域时返回NULL */
+char* buffer_peek(struct buffer* buff, size_t* len);
+
+/* 丢弃缓冲区头部size个可读字节 */
+void buffer_drain(struct buffer* buff, size_t size);
+
 /* 向缓冲区中写入由data指向的size个字节 */
 size_t buffer_append(struct buffer* buff, const void* data, size_t size);
 
@@ -53,19 +147,71 @@ size_t buffer_append_char(struct buffer* buff, char c);
 /* 向缓冲区写入指定字符串 */
 size_t buffer_append_string(struct buffer* buff, const char* str);
 
+/**
+ * 向链式缓冲区追加文件fd中[offset, offset + len)区域，仅适用于chain模式
+ * 文件内容不会被读入用户空间，fd须保持打开直到该区域被发送或缓冲区被释放
+ */
+size_t buffer_append_file(struct buffer* buff, int fd, off_t offset, size_t len);
+
+/**
+ * 同buffer_append_file()，区域发送完毕或缓冲区被释放时调用release(arg)，由fd的持有者决定何时关闭fd
+ * len为0时立即调用release(arg)
+ */
+size_t buffer_append_file_shared(struct buffer* buff, int fd, off_t offset, size_t len, buffer_release_callback release, void* arg);
+
+/**
+ * 向链式缓冲区追加外部数据data的len字节而不拷贝，仅适用于chain模式
+ * data须保持不变直到release(arg)被调用，即这些字节被发送(含MSG_ZEROCOPY完成)或缓冲区被释放，len为0时立即调用
+ */
+size_t buffer_append_shared(struct buffer* buff, const void* data, size_t len, buffer_release_callback release, void* arg);
+
 /* 从non-blocking fd中读取数据到缓冲区 */
 ssize_t buffer_read_fd(struct buffer* buff, int fd);
 
-/* 从缓冲区中读一个字符 */
-char buffer_read_char(struct buffer* buff);
+/**
+ * 将缓冲区可读数据尽可能多地写入non-blocking fd，返回写入字节数，已写入字节从缓冲区移除
+ * 内存数据以writev()批量写出，文件区域以sendfile()写出，直到缓冲区为空或fd不可写
+ * 文件在入队后被截断时，区域剩余部分视为已写出，同样移除并计入返回值
+ */
+ssize_t buffer_write_fd(struct buffer* buff, int fd);
+
+/* 将src中的全部可读数据移动到dst尾部，二者均为chain模式时只移动数据块，不拷贝数据 */
+size_t buffer_move(struct buffer* dst, struct buffer* src);
+
+/**
+ * 读取fd错误队列中的MSG_ZEROCOPY完成通知，释放内核不再引用的数据块
+ * 返回本次完成的zerocopy发送次数
+ */
+int buffer_zerocopy_complete(struct buffer* buff, int fd);
+
+/* 是否有数据块仍在等待zerocopy完成通知 */
+int buffer_zerocopy_pending(struct buffer* buff);
+
+/* 从缓冲区中读一个字符，以unsigned char转为int返回；缓冲区为空或首段为文件区域时返回-1 */
+int buffer_read_char(struct buffer* buff);
 
-/* 在缓冲区中查询CRLF位置 */
+/* 在缓冲区中查询CRLF位置，仅适用于flat模式 */
 char* buffer_find_CRLF(struct buffer* buff);
 
+/**
+ * 以下查找均仅适用于flat模式，使用scan.h中按cpu特性选择的SIMD实现
+ * 从可读数据第*scanned字节处开始查找，找到时返回匹配位置相对readIdx的偏移；
+ * 未找到返回-1，并将*scanned推进到下次需要重新检查的位置，数据追加后再次调用不会重复扫描已检查的字节
+ * 从缓冲区读出数据后，调用者需相应减小或清零*scanned
+ * 公开API，供buffer之上按分隔符分帧的协议使用；内置HTTP解析器需逐字节校验，不调用它们，用法和性能见test/bench_scan.c
+ */
+ssize_t buffer_find_byte(struct buffer* buff, char c, size_t* scanned);
+
+/* 查找CRLF，见buffer_find_byte() */
+ssize_t buffer_find_CRLF_from(struct buffer* buff, size_t* scanned);
+
+/* 查找CRLFCRLF，即HTTP头部结束位置，见buffer_find_byte() */
+ssize_t buffer_find_CRLFCRLF(struct buffer* buff, size_t* scanned);
+
 /* show content in buffer */
 void buffer_show_content(struct buffer* buff);
 
-/* 释放堆空间 */
+/* 释放堆空间，调用前须等待zerocopy发送全部完成(buffer_zerocopy_pending()为0)，内核可能仍在读取的数据块不会被释放 */
 void buffer_cleanup(struct buffer* buff);
 
 #endif
@@ -0,0 +1,109 @@
+#include "buffer_pool.h"
+#include "buffer.h"
+
+/* chain mode blocks, then initial flat storage and its first two doublings */
+static const size_t BUFFER_POOL_CLASS_SIZES[BUFFER_POOL_NCLASS] = {
+    BUFFER_BLOCK_SIZE,
+    INIT_BUFFER_SIZE + CHEAP_PREPEND_SIZE,
+    (INIT_BUFFER_SIZE << 1) + CHEAP_PREPEND_SIZE,
+    (INIT_BUFFER_SIZE << 2) + CHEAP_PREPEND_SIZE,
+};
+
+struct buffer_pool* buffer_pool_new(size_t highWater)
+{
+    struct buffer_pool* pool = calloc(1, sizeof(struct buffer_pool));
+    if (pool == NULL) return NULL;
+
+    pool->owner_tid = pthread_self();
+    for (int i = 0; i < BUFFER_POOL_NCLASS; i++)
+        pool->classes[i].size = BUFFER_POOL_CLASS_SIZES[i];
+    pool->highWater = highWater;
+    return pool;
+}
+
+static int buffer_pool_usable(struct buffer_pool* pool)
+{
+    return pool != NULL && pthread_equal(pthread_self(), pool->owner_tid);
+}
+
+void* buffer_pool_alloc(struct buffer_pool* pool, size_t size, size_t* realSize)
+{
+    struct buffer_pool_class* class = NULL;
+    for (int i = 0; i < BUFFER_POOL_NCLASS; i++) {
+        if (size <= BUFFER_POOL_CLASS_SIZES[i]) {
+            size = BUFFER_POOL_CLASS_SIZES[i];
+            if (buffer_pool_usable(pool)) class = &pool->classes[i];
+            break;
+        }
+    }
+    *realSize = size;
+
+    if (class != NULL) {
+        if (class->freelist != NULL) {
+            void* p = class->freelist;
+            class->freelist = *(void**)p;
+            class->nfree--;
+            pool->idleBytes -= class->size;
+            pool->hits++;
+            return p;
+        }
+        pool->misses++;
+    }
+    return malloc(size);
+}
+
+void buffer_pool_free(struct buffer_pool* pool, void* p, size_t size)
+{
+    if (p == NULL) return;
+    if (buffer_pool_usable(pool) && pool->idleBytes + size <= pool->highWater) {
+        for (int i = 0; i < BUFFER_POOL_NCLASS; i++) {
+            struct buffer_pool_class* class = &pool->classes[i];
+            if (class->size != size) continue;
+            *(void**)p = class->freelist;
+            class->freelist = p;
+            class->nfree++;
+            pool->idleBytes += size;
+            return;
+        }
+    }
+    if (buffer_pool_usable(pool)) pool->released++;
+    free(p);
+}
+
+void buffer_pool_set_high_water(struct buffer_pool* pool, size_t highWater)
+{
+    pool->highWater = highWater;
+    /* release larger classes first, they are the least likely to be reused */
+    for (int i = BUFFER_POOL_NCLASS - 1; i >= 0 && pool->idleBytes > highWater; i--) {
+        struct buffer_pool_class* class = &pool->classes[i];
+        while (class->freelist != NULL && pool->idleBytes > highWater) {
+            void* p = class->freelist;
+            class->freelist = *(void**)p;
+            class->nfree--;
+            pool->idleBytes -= class->size;
+            pool->released++;
+            free(p);
+        }
+    }
+}
+
+void buffer_pool_show_stats(struct buffer_pool* pool, const char* name)
+{
+    if (pool == NULL) return;
+    LOG(LT_INFO, "%s buffer pool: hits = %lu, misses = %lu, released = %lu, idle = %zu bytes",
+        name, pool->hits, pool->misses, pool->released, pool->idleBytes);
+}
+
+void buffer_pool_cleanup(struct buffer_pool* pool)
+{
+    if (pool == NULL) return;
+    for (int i = 0; i < BUFFER_POOL_NCLASS; i++) {
+        void* p = pool->classes[i].freelist;
+        while (p != NULL) {
+            void* next = *(void**)p;
+            free(p);
+            p = next;
+        }
+    }
+    free(pool);
+}
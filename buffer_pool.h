@@ -0,0 +1,55 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+#include <pthread.h>
+#include <stdlib.h>
+
+#define BUFFER_POOL_NCLASS 4
+#define BUFFER_POOL_HIGH_WATER (16 << 20) // 16mb, idle storage above it goes back to allocator
+
+/* free chunks of one size class, linked through their first bytes */
+struct buffer_pool_class {
+    size_t size;
+    void* freelist;
+    size_t nfree;
+};
+
+/**
+ * buffer storage pool owned by one event_loop, non-thread-safe
+ * - storage requested by its owner thread is taken from the smallest size class that fits, misses fall back to malloc;
+ * - storage requested or released by other threads bypasses the pool, so cross-thread use is safe but never warm;
+ * - released storage is cached as long as idle bytes stay below highWater, otherwise it is freed.
+ */
+struct buffer_pool {
+    pthread_t owner_tid;
+    struct buffer_pool_class classes[BUFFER_POOL_NCLASS];
+    size_t idleBytes;
+    size_t highWater;
+
+    /* statistics, only updated by owner thread */
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long released;
+};
+
+/* create a pool owned by current thread, caching at most highWater idle bytes */
+struct buffer_pool* buffer_pool_new(size_t highWater);
+
+/**
+ * allocate storage of at least size bytes
+ * realSize returns the usable size, which is the size class when size fits in one
+ */
+void* buffer_pool_alloc(struct buffer_pool* pool, size_t size, size_t* realSize);
+
+/* release storage allocated by buffer_pool_alloc, size must be the realSize returned on allocation */
+void buffer_pool_free(struct buffer_pool* pool, void* p, size_t size);
+
+/* change idle high-water mark, idle storage above it is freed immediately */
+void buffer_pool_set_high_water(struct buffer_pool* pool, size_t highWater);
+
+/* log hit/miss counters and idle bytes */
+void buffer_pool_show_stats(struct buffer_pool* pool, const char* name);
+
+/* free all idle storage and the pool itself */
+void buffer_pool_cleanup(struct buffer_pool* pool);
+
+#endif
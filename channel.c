@@ -1,34 +1,77 @@
 #include "channel.h"
 
-struct channel* channel_new(int fd, int events, event_read_callback eventReadCallBack, event_write_callback eventWriteCallBack, void* data) 
+static int channel_handle_timeout(void* data);
+
+void channel_init(struct channel* chan, int fd, int events, event_read_callback eventReadCallBack, event_write_callback eventWriteCallBack, void* data)
 {
-    struct channel* chan = malloc(sizeof(struct channel));
-    if (chan == NULL) return NULL;
     chan->fd = fd;
     chan->events = events;
     chan->eventReadCallBack = eventReadCallBack;
     chan->eventWriteCallBack = eventWriteCallBack;
     chan->data = data;
+    chan->eventTimeoutCallBack = NULL;
+    chan->timeout = 0;
+    timer_init(&chan->timer, channel_handle_timeout, chan);
+}
+
+struct channel* channel_new(int fd, int events, event_read_callback eventReadCallBack, event_write_callback eventWriteCallBack, void* data) 
+{
+    struct channel* chan = malloc(sizeof(struct channel));
+    if (chan == NULL) return NULL;
+    channel_init(chan, fd, events, eventReadCallBack, eventWriteCallBack, data);
     return chan;
 }
 
+int channel_is_edge_triggered(struct channel* chan)
+{
+    return chan->events & EVENT_EDGE_TRIGGERED;
+}
+
 int channel_write_event_is_enabled(struct channel* chan)
 {
     return chan->events & EVENT_WRITE;
 }
 
-int channel_write_event_enable(struct channel* chan)
+int channel_write_event_enable(struct event_loop* eventLoop, struct channel* chan)
 {
-    struct event_loop* eventLoop = (struct event_loop*)chan->data;
+    /* edge-triggered channel keeps EVENT_WRITE registered, every writable edge is reported without EPOLL_CTL_MOD */
+    if (channel_is_edge_triggered(chan)) return 0;
     chan->events = chan->events | EVENT_WRITE;
     event_loop_update_channel_event(eventLoop, chan->fd, chan);
     return 0;
 }
 
-int channel_write_event_disable(struct channel* chan)
+int channel_write_event_disable(struct event_loop* eventLoop, struct channel* chan)
 {
-    struct event_loop* eventLoop = (struct event_loop*)chan->data;
+    if (channel_is_edge_triggered(chan)) return 0;
     chan->events = chan->events & ~EVENT_WRITE;
     event_loop_update_channel_event(eventLoop, chan->fd, chan);
     return 0;
 }
+
+int channel_timeout_enable(struct event_loop* eventLoop, struct channel* chan, uint64_t timeout, event_timeout_callback eventTimeoutCallBack)
+{
+    chan->events = chan->events | EVENT_TIMEOUT;
+    chan->eventTimeoutCallBack = eventTimeoutCallBack;
+    chan->timeout = timeout;
+    /* not registered yet, timer is started by event_loop_handle_pending_add() */
+    if (!in_owner_thread(eventLoop)) return 0;
+    return event_loop_add_timer(eventLoop, &chan->timer, timeout, 0);
+}
+
+int channel_timeout_disable(struct event_loop* eventLoop, struct channel* chan)
+{
+    chan->events = chan->events & ~EVENT_TIMEOUT;
+    if (!in_owner_thread(eventLoop)) return 0;
+    return event_loop_cancel_timer(eventLoop, &chan->timer);
+}
+
+/* timer callback, EVENT_TIMEOUT is one-shot */
+static int channel_handle_timeout(void* data)
+{
+    struct channel* chan = data;
+    chan->events = chan->events & ~EVENT_TIMEOUT;
+    if (chan->eventTimeoutCallBack != NULL)
+        return chan->eventTimeoutCallBack(chan->data);
+    return 0;
+}
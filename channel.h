@@ -1,12 +1,15 @@
 #ifndef CHANNEL_H
 #define CHANNEL_H
 #include <stdlib.h>
+#include "timer_wheel.h"
 
 /* 信道等待发生的事件类型 */
 #define EVENT_TIMEOUT 0x01
 #define EVENT_READ 0x02
 #define EVENT_WRITE 0x04 
 #define EVENT_SIGNAL 0x08
+/* 信道标志：边沿触发，回调需读写直到EAGAIN；写事件始终注册，开启/关闭写事件不再修改dispatcher */
+#define EVENT_EDGE_TRIGGERED 0x10
 
 // NOTE: forward-declaration, avoid circular including
 struct event_loop;
@@ -14,6 +17,7 @@ struct event_loop;
 /* 定义函数指针别名主要是为了方便传参 */
 typedef int (*event_read_callback)(void* data);
 typedef int (*event_write_callback)(void* data);
+typedef int (*event_timeout_callback)(void* data);
 
 struct channel {
     int fd;                                // 该信道所属描述符
@@ -21,20 +25,42 @@ struct channel {
     event_read_callback eventReadCallBack;  // 该信道的读事件回调函数
     event_write_callback eventWriteCallBack; // 该信道的写事件回调函数
     void* data;                            // NOTE: 回调数据，event_loop/tcp_server/tcp_connection 
+    event_timeout_callback eventTimeoutCallBack; // 该信道的超时事件回调函数
+    uint64_t timeout;                      // 超时事件的等待毫秒数
+    struct timer timer;                    // 超时定时器，挂在所属event_loop的时间轮上
 };
 
 extern int event_loop_update_channel_event(struct event_loop* eventLoop, int fd, struct channel* chan);
+extern int event_loop_add_timer(struct event_loop* eventLoop, struct timer* timer, uint64_t delay, uint64_t interval);
+extern int event_loop_cancel_timer(struct event_loop* eventLoop, struct timer* timer);
+extern int in_owner_thread(struct event_loop* eventLoop);
+
+/* 初始化调用者提供内存中的信道，例如嵌入在tcp_connection所在内存块中的信道 */
+void channel_init(struct channel* chan, int fd, int events, event_read_callback eventReadCallBack, event_write_callback eventWriteCallBack, void* data);
 
 /* 创建一个新信道 */
 struct channel* channel_new(int fd, int events, event_read_callback eventReadCallBack, event_write_callback eventWriteCallBack, void* data);
 
+/* 判断一个信道是否为边沿触发 */
+int channel_is_edge_triggered(struct channel* chan);
+
 /* 判断一个信道的写事件监听是否开启 */
 int channel_write_event_is_enabled(struct channel* chan);
 
-/* 开启一个信道的写事件 */
-int channel_write_event_enable(struct channel* chan);
+/* 开启一个信道的写事件，eventLoop为该信道注册所在的event_loop */
+int channel_write_event_enable(struct event_loop* eventLoop, struct channel* chan);
+
+/* 关闭一个信道的写事件，eventLoop为该信道注册所在的event_loop */
+int channel_write_event_disable(struct event_loop* eventLoop, struct channel* chan);
+
+/**
+ * 开启信道的超时事件，timeout毫秒后以chan->data调用eventTimeoutCallBack，单次触发
+ * 再次调用会重置超时时间，不涉及任何系统调用
+ * 信道注册前可由任意线程调用，定时器在注册时由eventLoop所属线程启动；注册后仅由所属线程调用
+ */
+int channel_timeout_enable(struct event_loop* eventLoop, struct channel* chan, uint64_t timeout, event_timeout_callback eventTimeoutCallBack);
 
-/* 关闭一个信道的写事件 */
-int channel_write_event_disable(struct channel* chan);
+/* 关闭信道的超时事件 */
+int channel_timeout_disable(struct event_loop* eventLoop, struct channel* chan);
 
 #endif
@@ -1,55 +1,49 @@
 #include "channel_map.h"
+#include <sys/resource.h>
 
-struct channel_map* chanmap_new(int msize) 
+struct channel_map* chanmap_new() 
 {
-    int initsz = CHANNELMAP_INITSIZE;
-    void** entries;
-
     struct channel_map* chanMap = malloc(sizeof(struct channel_map));
-    if (chanMap == NULL) goto failed;
-
-    entries = calloc(msize, initsz);
-    if (entries == NULL) goto failed;
-
-    chanMap->nentry = initsz;
-    chanMap->entries = entries;
-
+    if (chanMap == NULL) return NULL;
+
+    /* hard limit, so that raising soft limit later needs no directory growth */
+    rlim_t limit = CHANNELMAP_MAXSIZE;
+    struct rlimit rlim;
+    if (getrlimit(RLIMIT_NOFILE, &rlim) == 0 && rlim.rlim_max != RLIM_INFINITY && rlim.rlim_max < limit)
+        limit = rlim.rlim_max;
+
+    chanMap->nentry = (int)limit;
+    chanMap->npage = (chanMap->nentry + CHANNELMAP_PAGE_SIZE - 1) >> CHANNELMAP_PAGE_BITS;
+    chanMap->pages = calloc(chanMap->npage, sizeof(void**));
+    if (chanMap->pages == NULL) {
+        free(chanMap);
+        return NULL;
+    }
     return chanMap;
-
-failed:
-    if (entries != NULL) free(entries);
-    if (chanMap != NULL) free(chanMap);
-    return NULL;
 }
 
-int chanmap_expand(struct channel_map* chanmap, int slot, int msize)
+int chanmap_set(struct channel_map* chanmap, int fd, void* chan)
 {
-    if (slot < chanmap->nentry) return 0;
-
-    int nsize = chanmap->nentry;
-    void** nentries = NULL;
-
-    if (nsize >= CHANNELMAP_MAXSIZE / 2) nsize = CHANNELMAP_MAXSIZE;
-    else while (nsize <= slot) nsize <<= 1; // 向上取2的倍数
-
-    nentries = realloc(chanmap->entries, nsize * msize);
-    if (nentries == NULL) return -1;
-    memset(&nentries[chanmap->nentry], 0, (nsize - chanmap->nentry) * msize);
-
-    chanmap->entries = nentries;
-    chanmap->nentry = nsize;
+    if (fd < 0 || fd >= chanmap->nentry) return -1;
+    void*** slot = &chanmap->pages[fd >> CHANNELMAP_PAGE_BITS];
+    if (*slot == NULL) {
+        if (chan == NULL) return 0;
+        *slot = calloc(CHANNELMAP_PAGE_SIZE, sizeof(void*));
+        if (*slot == NULL) return -1;
+    }
+    (*slot)[fd & CHANNELMAP_PAGE_MASK] = chan;
     return 0;
 }
 
-
 void chanmap_cleanup(struct channel_map* chanmap)
 {
     if (chanmap != NULL) {
-        if (chanmap->entries != NULL) {
-            for (int i = 0; i < chanmap->nentry; i++) {
-                if (chanmap->entries[i] != NULL) free(chanmap->entries[i]);
+        if (chanmap->pages != NULL) {
+            for (int i = 0; i < chanmap->npage; i++) {
+                void** page = chanmap->pages[i];
+                if (page != NULL) free(page);
             }
-            free(chanmap->entries);
+            free(chanmap->pages);
         }
         free(chanmap);
     }
@@ -3,27 +3,42 @@
 #include <stdlib.h>
 #include <string.h>
 
-#define CHANNELMAP_INITSIZE 32
-#define CHANNELMAP_MAXSIZE 1024
+#define CHANNELMAP_PAGE_BITS 12                          // 每页4096项，32kb
+#define CHANNELMAP_PAGE_SIZE (1 << CHANNELMAP_PAGE_BITS)
+#define CHANNELMAP_PAGE_MASK (CHANNELMAP_PAGE_SIZE - 1)
+#define CHANNELMAP_MAXSIZE (1 << 24)                     // RLIMIT_NOFILE无限制时的上限，目录至多4096项
 /**
  * 套接字描述符与对应channel的映射表，可快速获得套接字fd绑定的channel，从而调用相应回调函数
- * usage: struct channel* chan = channel_map[fd];
+ * 两级页表：目录按RLIMIT_NOFILE硬限制一次分配，页在首次写入时分配，之后不再移动，
+ * 插入为O(1)，扩容无需拷贝已有表项，空闲fd区间不占内存
+ * usage: struct channel* chan = chanmap_get(channelMap, fd);
  */
 struct channel_map {
-    /* channel指针数组, 初始化为CHANNELMAP_INITSIZE，之后可自动扩增 */
-    void** entries;
+    /* 页目录，pages[fd >> CHANNELMAP_PAGE_BITS][fd & CHANNELMAP_PAGE_MASK] */
+    void*** pages;
 
-    /* 数组大小 */
+    /* 目录项数 */
+    int npage;
+
+    /* 可映射的fd上限 */
     int nentry;
 };
 
-/* 初始化映射表，初始大小为CHANNELMAP_INITSIZE */
+/* 初始化映射表，容量为进程RLIMIT_NOFILE硬限制 */
 struct channel_map* chanmap_new();
 
-/* 实现映射表扩容，最大为CHANNELMAP_MAXSIZE */
-int chanmap_expand(struct channel_map* chanmap, int slot, int msize);
+/* 获取fd对应的channel，未映射或越界时返回NULL */
+static inline void* chanmap_get(struct channel_map* chanmap, int fd)
+{
+    if (fd < 0 || fd >= chanmap->nentry) return NULL;
+    void** page = chanmap->pages[fd >> CHANNELMAP_PAGE_BITS];
+    return page != NULL ? page[fd & CHANNELMAP_PAGE_MASK] : NULL;
+}
+
+/* 设置fd对应的channel，chan为NULL时清除映射，所在页按需分配，越界或分配失败返回-1 */
+int chanmap_set(struct channel_map* chanmap, int fd, void* chan);
 
-/* 释放映射表及保存channel堆内存 */
+/* 释放映射表，channel由其创建者释放，例如连接的channel嵌入在tcp_connection所在内存块中 */
 void chanmap_cleanup(struct channel_map* chanmap);
 
 #endif
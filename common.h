@@ -31,6 +31,7 @@
 #define UDP_SERVER 1
 
 #define SERVER_NAME_MAXLEN 32
+#define SERVER_ACCEPT_BUDGET 64   // max connections accepted per wakeup of an edge-triggered listening socket
 #define SERVER_PORT 8080
 #define LISTENQ 1024
 #define UNIXSTR_PATH "/var/lib/unixstream.sock"
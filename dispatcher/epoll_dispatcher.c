@@ -59,9 +59,11 @@ int epoll_add(struct event_loop* eventLoop, struct channel* chan)
     int fd = chan->fd;
     uint32_t events = 0;
     if (chan->events & EVENT_READ)
-        events |= EPOLLIN;      // TODO: default level-triggered, supported edge-triggered
+        events |= EPOLLIN;      // default level-triggered
     if (chan->events & EVENT_WRITE)
         events |= EPOLLOUT;
+    if (chan->events & EVENT_EDGE_TRIGGERED)
+        events |= EPOLLET;
 
     ev.data.fd = fd;
     ev.events = events;
@@ -91,11 +93,13 @@ int epoll_update(struct event_loop* eventLoop, struct channel* chan)
     struct epoll_event ev;
 
     int fd = chan->fd;
-    uint8_t events = 0;
+    uint32_t events = 0;
     if (chan->events & EVENT_READ)
         events |= EPOLLIN;
     if (chan->events & EVENT_WRITE)
         events |= EPOLLOUT;
+    if (chan->events & EVENT_EDGE_TRIGGERED)
+        events |= EPOLLET;
     ev.data.fd = fd;
     ev.events = events;
 
@@ -110,9 +114,12 @@ int epoll_update(struct event_loop* eventLoop, struct channel* chan)
 int epoll_dispatch(struct event_loop* eventLoop, struct timeval* timeout)
 {
     struct epoll_dispatcher_data* epollDispatcherData = eventLoop->event_dispatcher_data;
-    int timewait = timeout->tv_sec * 1000;
+    int timewait = timeout->tv_sec * 1000 + (timeout->tv_usec + 999) / 1000;
     int nready = 0;
-    if ((nready = epoll_wait(epollDispatcherData->efd, epollDispatcherData->readylist, epollDispatcherData->nfds, timewait)) < 0) {
+    nready = epoll_wait(epollDispatcherData->efd, epollDispatcherData->readylist, epollDispatcherData->nfds, timewait);
+    /* the only clock read of this round, taken before any callback runs */
+    loop_clock_update(&eventLoop->clock);
+    if (nready < 0) {
         LOG(LT_WARN, "%s", strerror(errno));
         return -1;
     }
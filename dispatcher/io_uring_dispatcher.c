@@ -0,0 +1,436 @@
+#include "event_loop.h"
+#include "event_dispatcher.h"
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#define URING_ENTRIES 1024          // submission queue size, completion queue is URING_CQ_FACTOR times larger
+#define URING_CQ_FACTOR 4
+#define URING_INIT_GENS 1024        // initial size of per-fd generation table
+
+/* user_data of requests which are not poll requests of a channel */
+#define URING_UDATA_TIMEOUT ((uint64_t)-1)
+#define URING_UDATA_REMOVE ((uint64_t)-2)
+#define URING_UDATA_PROBE ((uint64_t)-3)
+
+/**
+ * io_uring as readiness dispatcher
+ * - every channel is watched by one multishot poll request, kernel keeps reporting readiness without re-arming;
+ * - multishot poll only reports wakeups, which is edge-triggered, level-triggered channels ask for IORING_POLL_ADD_LEVEL,
+ *   or, where kernel rejects it, use a oneshot poll re-armed after every completion, which checks readiness again;
+ * - both flags are probed at init, a kernel without multishot poll (before 5.13) gets no io_uring dispatcher,
+ *   so that loop falls back to epoll;
+ * - add/del/update only queue sqes, all of them are submitted together with waiting in one io_uring_enter() per dispatch;
+ * - user_data of a poll request = (generation << 32) | fd, generation of fd increases whenever its poll is removed,
+ *   so that completions of removed polls are recognized and ignored.
+ */
+struct io_uring_dispatcher_data {
+    int ringFd;
+    unsigned features;
+
+    /* submission queue */
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned* sqMask;
+    unsigned* sqArray;
+    unsigned sqEntries;
+    struct io_uring_sqe* sqes;
+    unsigned nsubmit;       // sqes queued since last io_uring_enter()
+
+    /* completion queue */
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned* cqMask;
+    struct io_uring_cqe* cqes;
+
+    void* sqRing;
+    size_t sqRingSize;
+    void* cqRing;
+    size_t cqRingSize;
+    size_t sqesSize;
+
+    uint32_t* gens;
+    int ngen;
+
+    int levelPoll;                      // kernel accepts IORING_POLL_ADD_LEVEL
+    int timeoutArmed;                   // TIMEOUT requests in flight, kernel without IORING_FEAT_EXT_ARG only
+    struct __kernel_timespec armed;     // duration of the last TIMEOUT request armed
+    struct __kernel_timespec timeout;
+};
+
+static void* io_uring_init(struct event_loop* eventLoop);
+static int io_uring_add(struct event_loop* eventLoop, struct channel* chan);
+static int io_uring_del(struct event_loop* eventLoop, struct channel* chan);
+static int io_uring_update(struct event_loop* eventLoop, struct channel* chan);
+static int io_uring_dispatch(struct event_loop* eventLoop, struct timeval* timeout);
+static void io_uring_clear(struct event_loop* eventLoop);
+
+const struct event_dispatcher io_uring_dispatcher = {
+    "io_uring",
+    io_uring_init,
+    io_uring_add,
+    io_uring_del,
+    io_uring_update,
+    io_uring_dispatch,
+    io_uring_clear,
+};
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params* params)
+{
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_io_uring_enter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags, void* arg, size_t argsz)
+{
+    return syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argsz);
+}
+
+static int io_uring_probe_poll(struct io_uring_dispatcher_data* data, unsigned flags);
+
+static void io_uring_unmap(struct io_uring_dispatcher_data* data)
+{
+    if (data->sqes != NULL && data->sqes != MAP_FAILED) munmap(data->sqes, data->sqesSize);
+    if (data->cqRing != NULL && data->cqRing != MAP_FAILED && data->cqRing != data->sqRing) munmap(data->cqRing, data->cqRingSize);
+    if (data->sqRing != NULL && data->sqRing != MAP_FAILED) munmap(data->sqRing, data->sqRingSize);
+}
+
+void* io_uring_init(struct event_loop* eventLoop)
+{
+    struct io_uring_params params;
+    struct io_uring_dispatcher_data* data = calloc(1, sizeof(struct io_uring_dispatcher_data));
+    if (data == NULL) return NULL;
+    data->ringFd = -1;
+
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = URING_ENTRIES * URING_CQ_FACTOR;
+    data->ringFd = sys_io_uring_setup(URING_ENTRIES, &params);
+    if (data->ringFd < 0) {
+        LOG(LT_WARN, "failed to setup io_uring, %s", strerror(errno));
+        goto failed;
+    }
+    data->features = params.features;
+
+    data->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    data->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (data->features & IORING_FEAT_SINGLE_MMAP) {
+        if (data->cqRingSize > data->sqRingSize) data->sqRingSize = data->cqRingSize;
+        data->cqRingSize = data->sqRingSize;
+    }
+    data->sqRing = mmap(NULL, data->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, data->ringFd, IORING_OFF_SQ_RING);
+    if (data->sqRing == MAP_FAILED) goto failed;
+    if (data->features & IORING_FEAT_SINGLE_MMAP) {
+        data->cqRing = data->sqRing;
+    } else {
+        data->cqRing = mmap(NULL, data->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, data->ringFd, IORING_OFF_CQ_RING);
+        if (data->cqRing == MAP_FAILED) goto failed;
+    }
+    data->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    data->sqes = mmap(NULL, data->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, data->ringFd, IORING_OFF_SQES);
+    if (data->sqes == MAP_FAILED) goto failed;
+
+    data->sqHead = (unsigned*)((char*)data->sqRing + params.sq_off.head);
+    data->sqTail = (unsigned*)((char*)data->sqRing + params.sq_off.tail);
+    data->sqMask = (unsigned*)((char*)data->sqRing + params.sq_off.ring_mask);
+    data->sqArray = (unsigned*)((char*)data->sqRing + params.sq_off.array);
+    data->sqEntries = params.sq_entries;
+    data->cqHead = (unsigned*)((char*)data->cqRing + params.cq_off.head);
+    data->cqTail = (unsigned*)((char*)data->cqRing + params.cq_off.tail);
+    data->cqMask = (unsigned*)((char*)data->cqRing + params.cq_off.ring_mask);
+    data->cqes = (struct io_uring_cqe*)((char*)data->cqRing + params.cq_off.cqes);
+
+    data->gens = calloc(URING_INIT_GENS, sizeof(uint32_t));
+    if (data->gens == NULL) goto failed;
+    data->ngen = URING_INIT_GENS;
+
+    int multishot = io_uring_probe_poll(data, IORING_POLL_ADD_MULTI);
+    if (multishot <= 0) {
+        if (multishot == 0) LOG(LT_WARN, "io_uring multishot poll unsupported by kernel");
+        goto failed;
+    }
+    data->levelPoll = io_uring_probe_poll(data, IORING_POLL_ADD_MULTI | IORING_POLL_ADD_LEVEL);
+    if (data->levelPoll < 0) goto failed;
+    if (!data->levelPoll)
+        LOG(LT_INFO, "io_uring level-triggered poll unsupported by kernel, level-triggered channels use oneshot polls");
+    return data;
+
+failed:
+    io_uring_unmap(data);
+    if (data->ringFd >= 0) close(data->ringFd);
+    free(data);
+    return NULL;
+}
+
+/* submit every queued sqe without waiting */
+static int io_uring_flush(struct io_uring_dispatcher_data* data)
+{
+    while (data->nsubmit > 0) {
+        int n = sys_io_uring_enter(data->ringFd, data->nsubmit, 0, 0, NULL, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            LOG(LT_WARN, "%s", strerror(errno));
+            return -1;
+        }
+        data->nsubmit -= n;
+    }
+    return 0;
+}
+
+/* get a free sqe, queued sqes are flushed when submission queue is full */
+static struct io_uring_sqe* io_uring_get_sqe(struct io_uring_dispatcher_data* data)
+{
+    unsigned tail = *data->sqTail;
+    if (tail - __atomic_load_n(data->sqHead, __ATOMIC_ACQUIRE) >= data->sqEntries) {
+        if (io_uring_flush(data) < 0) return NULL;
+    }
+    unsigned idx = tail & *data->sqMask;
+    struct io_uring_sqe* sqe = &data->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    data->sqArray[idx] = idx;
+    return sqe;
+}
+
+/* publish sqe filled after io_uring_get_sqe(), it's submitted with next io_uring_enter() */
+static void io_uring_queue_sqe(struct io_uring_dispatcher_data* data)
+{
+    __atomic_store_n(data->sqTail, *data->sqTail + 1, __ATOMIC_RELEASE);
+    data->nsubmit++;
+}
+
+static uint64_t io_uring_poll_udata(struct io_uring_dispatcher_data* data, int fd)
+{
+    return ((uint64_t)data->gens[fd] << 32) | (uint32_t)fd;
+}
+
+static int io_uring_ensure_gen(struct io_uring_dispatcher_data* data, int fd)
+{
+    if (fd < data->ngen) return 0;
+    int n = data->ngen;
+    while (n <= fd) n <<= 1;
+    uint32_t* gens = realloc(data->gens, n * sizeof(uint32_t));
+    if (gens == NULL) return -1;
+    memset(&gens[data->ngen], 0, (n - data->ngen) * sizeof(uint32_t));
+    data->gens = gens;
+    data->ngen = n;
+    return 0;
+}
+
+static int io_uring_poll_add(struct io_uring_dispatcher_data* data, struct channel* chan)
+{
+    struct io_uring_sqe* sqe = io_uring_get_sqe(data);
+    if (sqe == NULL) return -1;
+    uint32_t events = 0;
+    if (chan->events & EVENT_READ)
+        events |= POLLIN;
+    if (chan->events & EVENT_WRITE)
+        events |= POLLOUT;
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = chan->fd;
+    sqe->poll32_events = events;
+    if (chan->events & EVENT_EDGE_TRIGGERED)
+        sqe->len = IORING_POLL_ADD_MULTI;
+    else if (data->levelPoll)
+        sqe->len = IORING_POLL_ADD_MULTI | IORING_POLL_ADD_LEVEL;
+    else
+        sqe->len = 0; // oneshot, re-armed by dispatch after its completion
+
+    sqe->user_data = io_uring_poll_udata(data, chan->fd);
+    io_uring_queue_sqe(data);
+    return 0;
+}
+
+/* remove current poll of fd, bump generation so its late completions are ignored */
+static int io_uring_poll_remove(struct io_uring_dispatcher_data* data, int fd)
+{
+    struct io_uring_sqe* sqe = io_uring_get_sqe(data);
+    if (sqe == NULL) return -1;
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = io_uring_poll_udata(data, fd);
+    sqe->user_data = URING_UDATA_REMOVE;
+    io_uring_queue_sqe(data);
+    data->gens[fd] = (data->gens[fd] + 1) & 0x7fffffff; // never collides with reserved user_data
+    return 0;
+}
+
+/**
+ * arm a multishot poll with flags on a readable eventfd and wait for its first completion, a kernel not supporting flags fails it.
+ * return 1 if it's supported, 0 if not, -1 on error. the poll is removed afterwards, its remaining completions are ignored by dispatch.
+ */
+static int io_uring_probe_poll(struct io_uring_dispatcher_data* data, unsigned flags)
+{
+    int ret = -1;
+    int efd = eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (efd < 0) return -1;
+
+    struct io_uring_sqe* sqe = io_uring_get_sqe(data);
+    if (sqe == NULL) goto done;
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = efd;
+    sqe->poll32_events = POLLIN;
+    sqe->len = flags;
+    sqe->user_data = URING_UDATA_PROBE;
+    io_uring_queue_sqe(data);
+    if (sys_io_uring_enter(data->ringFd, data->nsubmit, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0) {
+        LOG(LT_WARN, "failed to probe io_uring poll, %s", strerror(errno));
+        goto done;
+    }
+    data->nsubmit = 0;
+
+    unsigned head = *data->cqHead;
+    if (head == __atomic_load_n(data->cqTail, __ATOMIC_ACQUIRE)) goto done;
+    struct io_uring_cqe cqe = data->cqes[head & *data->cqMask];
+    __atomic_store_n(data->cqHead, head + 1, __ATOMIC_RELEASE);
+    if (cqe.res < 0 || !(cqe.flags & IORING_CQE_F_MORE)) {
+        ret = 0;
+        goto done;
+    }
+
+    sqe = io_uring_get_sqe(data);
+    if (sqe == NULL) goto done;
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = URING_UDATA_PROBE;
+    sqe->user_data = URING_UDATA_REMOVE;
+    io_uring_queue_sqe(data);
+    ret = io_uring_flush(data) < 0 ? -1 : 1;
+
+done:
+    close(efd);
+    return ret;
+}
+
+int io_uring_add(struct event_loop* eventLoop, struct channel* chan)
+{
+    struct io_uring_dispatcher_data* data = eventLoop->event_dispatcher_data;
+    if (io_uring_ensure_gen(data, chan->fd) < 0) return -1;
+    return io_uring_poll_add(data, chan);
+}
+
+int io_uring_del(struct event_loop* eventLoop, struct channel* chan)
+{
+    struct io_uring_dispatcher_data* data = eventLoop->event_dispatcher_data;
+    if (chan->fd >= data->ngen) return -1;
+    return io_uring_poll_remove(data, chan->fd);
+}
+
+int io_uring_update(struct event_loop* eventLoop, struct channel* chan)
+{
+    struct io_uring_dispatcher_data* data = eventLoop->event_dispatcher_data;
+    if (chan->fd >= data->ngen) return -1;
+    if (io_uring_poll_remove(data, chan->fd) < 0) return -1;
+    return io_uring_poll_add(data, chan);
+}
+
+/* submit queued sqes and wait for at least one completion or timeout */
+static int io_uring_submit_and_wait(struct io_uring_dispatcher_data* data, struct timeval* timeout)
+{
+    unsigned flags = IORING_ENTER_GETEVENTS;
+    void* arg = NULL;
+    size_t argsz = 0;
+    struct io_uring_getevents_arg getArg;
+
+    data->timeout.tv_sec = timeout->tv_sec;
+    data->timeout.tv_nsec = timeout->tv_usec * 1000;
+    if (data->features & IORING_FEAT_EXT_ARG) {
+        memset(&getArg, 0, sizeof(getArg));
+        getArg.ts = (uint64_t)(uintptr_t)&data->timeout;
+        flags |= IORING_ENTER_EXT_ARG;
+        arg = &getArg;
+        argsz = sizeof(getArg);
+    } else if (!data->timeoutArmed || data->timeout.tv_sec < data->armed.tv_sec ||
+               (data->timeout.tv_sec == data->armed.tv_sec && data->timeout.tv_nsec < data->armed.tv_nsec)) {
+        /* a timeout armed in an earlier round fires no later than this one only if it's not longer, otherwise replace it */
+        struct io_uring_sqe* sqe;
+        if (data->timeoutArmed) {
+            if ((sqe = io_uring_get_sqe(data)) == NULL) return -1;
+            sqe->opcode = IORING_OP_TIMEOUT_REMOVE;
+            sqe->fd = -1;
+            sqe->addr = URING_UDATA_TIMEOUT;
+            sqe->user_data = URING_UDATA_REMOVE;
+            io_uring_queue_sqe(data);
+        }
+        if ((sqe = io_uring_get_sqe(data)) == NULL) return -1;
+        sqe->opcode = IORING_OP_TIMEOUT;
+        sqe->fd = -1;
+        sqe->addr = (uint64_t)(uintptr_t)&data->timeout;
+        sqe->len = 1;
+        sqe->user_data = URING_UDATA_TIMEOUT;
+        io_uring_queue_sqe(data);
+        data->timeoutArmed++;
+        data->armed = data->timeout;
+    }
+
+    /* completions already waiting, don't block */
+    unsigned minComplete = 1;
+    if (*data->cqHead != __atomic_load_n(data->cqTail, __ATOMIC_ACQUIRE)) minComplete = 0;
+
+    int n = sys_io_uring_enter(data->ringFd, data->nsubmit, minComplete, flags, arg, argsz);
+    if (n < 0) {
+        if (errno != ETIME && errno != EINTR)
+            LOG(LT_WARN, "%s", strerror(errno));
+        return (errno == ETIME || errno == EINTR) ? 0 : -1;
+    }
+    data->nsubmit -= n;
+    return 0;
+}
+
+int io_uring_dispatch(struct event_loop* eventLoop, struct timeval* timeout)
+{
+    struct io_uring_dispatcher_data* data = eventLoop->event_dispatcher_data;
+    int ret = io_uring_submit_and_wait(data, timeout);
+    /* the only clock read of this round, taken before any callback runs */
+    loop_clock_update(&eventLoop->clock);
+    if (ret < 0) return -1;
+
+    unsigned head = *data->cqHead;
+    unsigned tail = __atomic_load_n(data->cqTail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+        /* copy cqe out and release its slot before running callbacks */
+        struct io_uring_cqe cqe = data->cqes[head & *data->cqMask];
+        __atomic_store_n(data->cqHead, ++head, __ATOMIC_RELEASE);
+
+        if (cqe.user_data == URING_UDATA_TIMEOUT) {
+            data->timeoutArmed--;
+            continue;
+        }
+        if (cqe.user_data == URING_UDATA_REMOVE || cqe.user_data == URING_UDATA_PROBE) continue;
+
+        int fd = (int)(cqe.user_data & 0xffffffff);
+        uint32_t gen = (uint32_t)(cqe.user_data >> 32);
+        /* completion of a removed poll */
+        if (fd >= data->ngen || gen != data->gens[fd]) continue;
+
+        int rearm = 1;
+        if (cqe.res < 0 && cqe.res != -ECANCELED) {
+            /* poll can't be armed on this fd, re-arming would spin */
+            LOG(LT_WARN, "io_uring poll on fd %d failed, %s", fd, strerror(-cqe.res));
+            rearm = 0;
+        }
+        if (cqe.res > 0) {
+            if (cqe.res & (POLLIN | POLLERR | POLLHUP))
+                channel_event_activate(eventLoop, fd, EVENT_READ);
+            if (cqe.res & POLLOUT)
+                channel_event_activate(eventLoop, fd, EVENT_WRITE);
+        }
+
+        /* oneshot poll completed or multishot poll terminated, re-arm if channel is still watched by the same poll */
+        if (rearm && !(cqe.flags & IORING_CQE_F_MORE) && gen == data->gens[fd]) {
+            struct channel* chan = chanmap_get(eventLoop->channelMap, fd);
+            if (chan != NULL) io_uring_poll_add(data, chan);
+        }
+    }
+    return 0;
+}
+
+void io_uring_clear(struct event_loop* eventLoop)
+{
+    struct io_uring_dispatcher_data* data = eventLoop->event_dispatcher_data;
+    if (data == NULL) return;
+    io_uring_unmap(data);
+    if (data->ringFd >= 0) close(data->ringFd);
+    if (data->gens != NULL) free(data->gens);
+    free(data);
+    eventLoop->event_dispatcher_data = NULL;
+}
@@ -122,10 +122,13 @@ int poll_dispatch(struct event_loop* eventLoop, struct timeval* timeout)
 {
     struct poll_dispatcher_data* pollDispatcherData = eventLoop->event_dispatcher_data;
     int nready = 0;
-    int timewait = timeout->tv_sec * 1000;
+    int timewait = timeout->tv_sec * 1000 + (timeout->tv_usec + 999) / 1000;
 
     /* NOTE: where reactor thread will be actually blocked */
-    if ((nready = poll(pollDispatcherData->fdarry, INIT_POLL_SIZE, timewait)) < 0) {    
+    nready = poll(pollDispatcherData->fdarry, INIT_POLL_SIZE, timewait);
+    /* the only clock read of this round, taken before any callback runs */
+    loop_clock_update(&eventLoop->clock);
+    if (nready < 0) {
         LOG(LT_WARN, "%s", strerror(errno));    // error occured (EAGAIN, EINIR, EINVAL), just return for next round
         return 0;
     }
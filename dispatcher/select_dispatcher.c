@@ -102,7 +102,10 @@ int select_dispatch(struct event_loop* eventLoop, struct timeval* timeout)
     int maxfd = selectDispatcherData->maxfd;
     fd_set ready_rset = selectDispatcherData->rset;
     fd_set ready_wset = selectDispatcherData->wset;
-    if ((nready = select(maxfd + 1, &ready_rset, &ready_wset, NULL, timeout)) < 0) {
+    nready = select(maxfd + 1, &ready_rset, &ready_wset, NULL, timeout);
+    /* the only clock read of this round, taken before any callback runs */
+    loop_clock_update(&eventLoop->clock);
+    if (nready < 0) {
         LOG(LT_WARN, "%s", strerror(errno));
         return 0;
     }
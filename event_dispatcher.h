@@ -24,7 +24,7 @@ struct event_dispatcher {
     /* 通知dispatcher更新channel对应的事件 */
     int (*update)(struct event_loop* eventLoop, struct channel* channel);
 
-    /* 实现事件分发，然后调用event_loop的event_activate方法执行信道相应事件的回调函数 */
+    /* 实现事件分发，等待返回后立即刷新loop时钟(loop_clock_update)，然后调用event_loop的event_activate方法执行信道相应事件的回调函数 */
     int (*dispatch)(struct event_loop* eventLoop, struct timeval* timeout);
 
     /* 释放动态内存 */
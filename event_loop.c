@@ -1,6 +1,9 @@
 #include "event_loop.h"
+#include "tcp_connection.h"
+#include <sched.h>
+#include <sys/eventfd.h>
 
-static int event_loop_channel_buffer_nolock(struct event_loop* eventLoop, int fd, struct channel* chan, int type);
+static void event_loop_apply_channel_event(struct event_loop* eventLoop, struct channel* chan, int type);
 static void event_loop_wakeup(struct event_loop* eventLoop);
 static int handle_wakeup(void* data);
 
@@ -12,7 +15,9 @@ struct event_loop* event_loop_new(char* thread_name)
     eventLoop->status = EVENT_LOOP_OVER;
 
     /* select one supported I/O multiplexing as implementation of event dispatcher */
-#ifdef EPOLL_ENABLED
+#ifdef IO_URING_ENABLED
+    eventLoop->eventDispatcher = &io_uring_dispatcher;
+#elif defined EPOLL_ENABLED
     eventLoop->eventDispatcher = &epoll_dispatcher;
 #elif defined POLL_ENABLED
     eventLoop->eventDispatcher = &poll_dispatcher;
@@ -24,27 +29,56 @@ struct event_loop* event_loop_new(char* thread_name)
     goto failed;
 #endif
     eventLoop->event_dispatcher_data = eventLoop->eventDispatcher->init(eventLoop); 
+#if defined IO_URING_ENABLED && defined EPOLL_ENABLED
+    /* io_uring may be unavailable at runtime (old kernel, seccomp), fall back to epoll */
+    if (eventLoop->event_dispatcher_data == NULL) {
+        LOG(LT_WARN, "%s dispatcher unavailable, falling back to epoll", eventLoop->eventDispatcher->name);
+        eventLoop->eventDispatcher = &epoll_dispatcher;
+        eventLoop->event_dispatcher_data = eventLoop->eventDispatcher->init(eventLoop);
+    }
+#endif
     if (eventLoop->event_dispatcher_data == NULL) goto failed;
     LOG(LT_INFO, "using %s as event dispatcher", eventLoop->eventDispatcher->name);
 
-    eventLoop->channelMap = chanmap_new(sizeof(struct channel));
+    eventLoop->channelMap = chanmap_new();
     if (eventLoop->channelMap == NULL) goto failed;
 
-    eventLoop->is_handling_pending = 0;
-    eventLoop->pending_head = NULL;
-    eventLoop->pending_tail = NULL;
+    eventLoop->deferred = NULL;
+    eventLoop->ndeferred = 0;
+    eventLoop->deferredCap = 0;
+
+    eventLoop->load = NULL;
+
+    loop_clock_init(&eventLoop->clock);
+    eventLoop->timerWheel = timer_wheel_new(eventLoop->clock.monotonicMs);
+    if (eventLoop->timerWheel == NULL) goto failed;
+
+    eventLoop->bufferPool = buffer_pool_new(BUFFER_POOL_HIGH_WATER);
+    if (eventLoop->bufferPool == NULL) goto failed;
+
+    eventLoop->connSlab = slab_new(sizeof(struct tcp_connection_block), SLAB_OBJECTS_PER_CHUNK);
+    if (eventLoop->connSlab == NULL) goto failed;
+
+    eventLoop->pendingQueue = mpsc_queue_new(MPSC_QUEUE_CAPACITY);
+    if (eventLoop->pendingQueue == NULL) goto failed;
+
+    eventLoop->taskQueue = mpsc_queue_new(MPSC_QUEUE_CAPACITY);
+    if (eventLoop->taskQueue == NULL) goto failed;
+    eventLoop->localTasks = NULL;
+    eventLoop->nlocalTask = 0;
+    eventLoop->localTaskCap = 0;
 
     eventLoop->owner_tid = pthread_self();
-    pthread_mutex_init(&eventLoop->mutex, NULL);
-    pthread_cond_init(&eventLoop->cond, NULL);
-    if (socketpair(PF_UNIX, SOCK_STREAM, 0, eventLoop->socketPair) < 0) {
-        LOG(LT_ERROR, "failed to create socketpair!");
+    atomic_init(&eventLoop->wakeupPending, 0);
+    eventLoop->wakeupFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (eventLoop->wakeupFd < 0) {
+        LOG(LT_ERROR, "failed to create eventfd!");
         goto failed;
     }
 
-    struct channel* chan = channel_new(eventLoop->socketPair[1], EVENT_READ, handle_wakeup, NULL, eventLoop);
+    struct channel* chan = channel_new(eventLoop->wakeupFd, EVENT_READ, handle_wakeup, NULL, eventLoop);
     if (chan == NULL) goto failed;
-    event_loop_add_channel_event(eventLoop, eventLoop->socketPair[1], chan);
+    event_loop_add_channel_event(eventLoop, eventLoop->wakeupFd, chan);
 
     if (thread_name != NULL) {
         eventLoop->thread_name = thread_name;
@@ -59,38 +93,84 @@ failed:
     return NULL;
 }
 
-static int event_loop_do_channel_event(struct event_loop* eventLoop, int fd, struct channel* chan, int type)
+/* queue an entry for owner thread and wake it up so that it's handled immediately */
+static void event_loop_queue_pending(struct event_loop* eventLoop, struct mpsc_queue* queue, int type, void* data, void* arg)
 {
-    /* must lock eventLoop, because main-reactor thread and the sub-reacotor thread it belongs to may access it at same time */
-    pthread_mutex_lock(&eventLoop->mutex);
-    event_loop_channel_buffer_nolock(eventLoop, fd, chan, type);
-    pthread_mutex_unlock(&eventLoop->mutex);
+    while (mpsc_queue_push(queue, type, data, arg) < 0) {
+        /* queue full, owner thread is behind, let it drain */
+        event_loop_wakeup(eventLoop);
+        sched_yield();
+    }
+    event_loop_wakeup(eventLoop);
+}
 
-    /* serial lock-free */
+static int event_loop_do_channel_event(struct event_loop* eventLoop, int fd, struct channel* chan, int type)
+{
+    /* serial lock-free, apply operations queued by other threads first to keep their order */
     if (in_owner_thread(eventLoop)) {
         event_loop_handle_pending_channel(eventLoop);
-    } else {
-        /* eventLoop doesn't belong to cur thread, wake up corresponding thread so as to update registered events immediately */
-        event_loop_wakeup(eventLoop);   
+        event_loop_apply_channel_event(eventLoop, chan, type);
+        return 0;
     }
+
+    /* eventLoop doesn't belong to cur thread */
+    event_loop_queue_pending(eventLoop, eventLoop->pendingQueue, type, chan, NULL);
     return 0;
 }
 
-static int event_loop_channel_buffer_nolock(struct event_loop* eventLoop, int fd, struct channel* chan, int type)
+int event_loop_run_in_loop(struct event_loop* eventLoop, event_loop_task fn, void* arg)
 {
-    struct channel_element* chanElement = malloc(sizeof(struct channel_element));
-    chanElement->type = type;
-    chanElement->channel = chan;
-    chanElement->next = NULL;
-    if (eventLoop->pending_head == NULL) {
-        eventLoop->pending_head = eventLoop->pending_tail = chanElement;
-    } else {
-        eventLoop->pending_tail->next = chanElement;
-        eventLoop->pending_tail = chanElement;
+    if (in_owner_thread(eventLoop)) {
+        fn(arg);
+        return 0;
+    }
+    return event_loop_queue_in_loop(eventLoop, fn, arg);
+}
+
+int event_loop_queue_in_loop(struct event_loop* eventLoop, event_loop_task fn, void* arg)
+{
+    if (!in_owner_thread(eventLoop)) {
+        /* function pointer travels in the data slot of the cell */
+        event_loop_queue_pending(eventLoop, eventLoop->taskQueue, 0, (void*)fn, arg);
+        return 0;
     }
+    /* owner thread can't wait for its own queue to drain, local tasks go to a growable array instead */
+    if (eventLoop->nlocalTask == eventLoop->localTaskCap) {
+        int ncap = eventLoop->localTaskCap > 0 ? eventLoop->localTaskCap << 1 : 64;
+        struct loop_task* tmp = realloc(eventLoop->localTasks, ncap * sizeof(struct loop_task));
+        if (tmp == NULL) return -1;
+        eventLoop->localTasks = tmp;
+        eventLoop->localTaskCap = ncap;
+    }
+    eventLoop->localTasks[eventLoop->nlocalTask].fn = fn;
+    eventLoop->localTasks[eventLoop->nlocalTask].arg = arg;
+    eventLoop->nlocalTask++;
     return 0;
 }
 
+/**
+ * run tasks queued before this call, tasks queued by them wait for next round
+ * called after dispatch and pending channel operations, never from inside a channel callback
+ */
+static void event_loop_run_tasks(struct event_loop* eventLoop)
+{
+    int type;
+    void* fn;
+    void* arg;
+    size_t budget = mpsc_queue_capacity(eventLoop->taskQueue);
+    while (budget-- > 0 && mpsc_queue_pop(eventLoop->taskQueue, &type, &fn, &arg) == 0)
+        ((event_loop_task)fn)(arg);
+
+    int n = eventLoop->nlocalTask;
+    if (n == 0) return;
+    for (int i = 0; i < n; i++) {
+        struct loop_task task = eventLoop->localTasks[i];
+        task.fn(task.arg);
+    }
+    eventLoop->nlocalTask -= n;
+    memmove(eventLoop->localTasks, &eventLoop->localTasks[n], eventLoop->nlocalTask * sizeof(struct loop_task));
+}
+
 int event_loop_add_channel_event(struct event_loop* eventLoop, int fd, struct channel* chan)
 {
     return event_loop_do_channel_event(eventLoop, fd, chan, CHANNEL_OPT_ADD);
@@ -106,31 +186,27 @@ int event_loop_update_channel_event(struct event_loop* eventLoop, int fd, struct
     return event_loop_do_channel_event(eventLoop, fd, chan, CHANNEL_OPT_UPDATE);
 }
 
+static void event_loop_apply_channel_event(struct event_loop* eventLoop, struct channel* chan, int type)
+{
+    int fd = chan->fd;
+    if (type == CHANNEL_OPT_ADD) {
+        event_loop_handle_pending_add(eventLoop, fd, chan);
+    } else if (type == CHANNEL_OPT_DEL) {
+        event_loop_handle_pending_del(eventLoop, fd, chan);
+    } else if (type == CHANNEL_OPT_UPDATE) {
+        event_loop_handle_pending_update(eventLoop, fd, chan);
+    }
+}
+
 // 由I/O reactor线程完成每次事件循环后调用，修改已注册套接字监听事件，之后进入新一轮循环
 // 每次调用，处理完当前所有正在排队的channel操作事件，例如在事件分发器中注册新的套接字监听事件
 int event_loop_handle_pending_channel(struct event_loop* eventLoop)
 {
-    pthread_mutex_lock(&eventLoop->mutex);
-    eventLoop->is_handling_pending = 1;
-    struct channel_element* chanElement = eventLoop->pending_head, *prev = NULL;
-    while (chanElement != NULL) {
-        struct channel* chan = chanElement->channel;
-        int fd = chan->fd;
-        if (chanElement->type == CHANNEL_OPT_ADD) {
-            event_loop_handle_pending_add(eventLoop, fd, chan);
-        } else if (chanElement->type == CHANNEL_OPT_DEL) {
-            event_loop_handle_pending_del(eventLoop, fd, chan);
-        } else if (chanElement->type == CHANNEL_OPT_UPDATE) {
-            event_loop_handle_pending_update(eventLoop, fd, chan);
-        }
-        prev = chanElement;
-        chanElement = chanElement->next;
-        free(prev); // 释放动态内存
-    }
-
-    eventLoop->pending_head = eventLoop->pending_tail = NULL;
-    eventLoop->is_handling_pending = 0;
-    pthread_mutex_unlock(&eventLoop->mutex);
+    int type;
+    void* chan;
+    void* arg;
+    while (mpsc_queue_pop(eventLoop->pendingQueue, &type, &chan, &arg) == 0)
+        event_loop_apply_channel_event(eventLoop, chan, type);
     return 0;
 }
 
@@ -138,15 +214,17 @@ int event_loop_handle_pending_add(struct event_loop* eventLoop, int fd, struct c
 {
     struct channel_map* chanMap = eventLoop->channelMap;
     if (fd < 0) return 0;
-    if (fd >= chanMap->nentry) {
-        // TODO: 对channelMap进行扩容
-        return 0;
-    }
 
     // 第一次创建某个fd的channel时，将其插入channelmap，否则忽略，即便channel事件可能不同
-    if (chanMap->entries[fd] == NULL) {
-        chanMap->entries[fd] = chan;
+    if (chanmap_get(chanMap, fd) == NULL) {
+        if (chanmap_set(chanMap, fd, chan) < 0) {
+            LOG(LT_WARN, "%s failed to map fd %d, beyond RLIMIT_NOFILE or out of memory", eventLoop->thread_name, fd);
+            return -1;
+        }
         eventLoop->eventDispatcher->add(eventLoop, chan);
+        /* timeout enabled before registration, possibly by another thread */
+        if ((chan->events & EVENT_TIMEOUT) && !timer_is_armed(&chan->timer))
+            event_loop_add_timer(eventLoop, &chan->timer, chan->timeout, 0);
         return 1;
     }
     return 0;
@@ -157,22 +235,22 @@ int event_loop_handle_pending_del(struct event_loop* eventLoop, int fd, struct c
 {
     struct channel_map* chanMap = eventLoop->channelMap;
     if (fd < 0) return 0;
-    if (fd >= chanMap->nentry) return -1;
 
-    struct channel* chan = chanMap->entries[fd];
+    struct channel* chan = chanmap_get(chanMap, fd);
     if (chan == NULL) return 0;
+    /* channel is about to be freed by its owner, its timer must not fire afterwards */
+    timer_wheel_cancel(eventLoop->timerWheel, &chan->timer);
     int ret = 0;
     if (eventLoop->eventDispatcher->del(eventLoop, chan) == -1) ret = -1;
     else ret = 1;
-    chanMap->entries[fd] = NULL;
+    chanmap_set(chanMap, fd, NULL);
     return ret;
 }
 
 int event_loop_handle_pending_update(struct event_loop* eventLoop, int fd, struct channel* chan)
 {
-    struct channel_map* chanMap = eventLoop->channelMap;
-    if (fd < 0 || fd >= chanMap->nentry) return 0;
-    if (chanMap->entries[fd] == NULL) return -1;
+    if (fd < 0) return 0;
+    if (chanmap_get(eventLoop->channelMap, fd) == NULL) return -1;
     eventLoop->eventDispatcher->update(eventLoop, chan);
     return 0;
 }
@@ -182,11 +260,15 @@ int event_loop_handle_pending_update(struct event_loop* eventLoop, int fd, struc
 int channel_event_activate(struct event_loop* eventLoop, int fd, int event)
 {
     struct channel_map* chanMap = eventLoop->channelMap;
-    if (fd < 0 || fd >= chanMap->nentry) return 0;
-    struct channel* chan = chanMap->entries[fd];
+    struct channel* chan = chanmap_get(chanMap, fd);
+    /* channel may have been removed by a callback executed earlier in the same dispatching round */
+    if (chan == NULL) return 0;
     if (event & EVENT_READ)
         if (chan->eventReadCallBack != NULL) chan->eventReadCallBack(chan->data); 
 
+    /* read callback may have closed the connection and freed chan */
+    if ((event & EVENT_WRITE) && (event & EVENT_READ))
+        if ((chan = chanmap_get(chanMap, fd)) == NULL) return 0;
     if (event & EVENT_WRITE)
         if (chan->eventWriteCallBack != NULL) chan->eventWriteCallBack(chan->data);
     return 0;
@@ -196,25 +278,35 @@ int channel_event_activate(struct event_loop* eventLoop, int fd, int event)
 void event_loop_cleanup(struct event_loop* eventLoop)
 {
     if (eventLoop == NULL) return;
-    assert(pthread_mutex_trylock(&eventLoop->mutex) == 0);   // make sure no thread hold this mutex
     eventLoop->eventDispatcher->clear(eventLoop);
+    /* channel map doesn't own channels, wakeup channel is the only one created by event_loop */
+    struct channel* wakeupChan = chanmap_get(eventLoop->channelMap, eventLoop->wakeupFd);
+    if (wakeupChan != NULL) free(wakeupChan);
     chanmap_cleanup(eventLoop->channelMap);
-    assert(eventLoop->is_handling_pending == 0);
-    pthread_mutex_destroy(&eventLoop->mutex);
-    pthread_cond_destroy(&eventLoop->cond);
-    close(eventLoop->socketPair[0]);
-    close(eventLoop->socketPair[1]);
+    if (eventLoop->deferred != NULL) free(eventLoop->deferred);
+    if (eventLoop->localTasks != NULL) free(eventLoop->localTasks);
+    timer_wheel_cleanup(eventLoop->timerWheel);
+    buffer_pool_show_stats(eventLoop->bufferPool, eventLoop->thread_name);
+    buffer_pool_cleanup(eventLoop->bufferPool);
+    slab_show_stats(eventLoop->connSlab, eventLoop->thread_name);
+    slab_cleanup(eventLoop->connSlab);
+    mpsc_queue_cleanup(eventLoop->pendingQueue);
+    mpsc_queue_cleanup(eventLoop->taskQueue);
+    close(eventLoop->wakeupFd);
     if (eventLoop->thread_name != NULL) free(eventLoop->thread_name);
 }
 
 /**
  * when new channel is ready to be registered, reactor thread may block on dispather->dispatch(). 
- * in this case, main reactor thread write one byte to socketPair[0] to trigger EVENT_READ on registered socketPair[1] so that sub-reactor thread will wake up immediately instead of waking up after timeout.
+ * in this case, main reactor thread adds 1 to eventfd to trigger EVENT_READ on it so that sub-reactor thread will wake up immediately instead of waking up after timeout.
+ * only the first caller after last handle_wakeup() writes, others see wakeupPending and know the loop is going to drain their operations.
  */
 static void event_loop_wakeup(struct event_loop* eventLoop)
 {
-    char c = 'a';
-    ssize_t n = write(eventLoop->socketPair[0], &c, 1);
+    if (atomic_exchange_explicit(&eventLoop->wakeupPending, 1, memory_order_acq_rel) != 0)
+        return;
+    uint64_t one = 1;
+    ssize_t n = write(eventLoop->wakeupFd, &one, sizeof(one));
     if (n < 0)
         LOG(LT_WARN, "failed to wake up sub-reacotr thread %s", eventLoop->thread_name);
 }
@@ -222,29 +314,92 @@ static void event_loop_wakeup(struct event_loop* eventLoop)
 static int handle_wakeup(void* data)
 {
     struct event_loop* eventLoop = data;
-    char c;
-    ssize_t n = read(eventLoop->socketPair[1], &c, 1);
-    if (n < 0) {
-        LOG(LT_WARN, "sub-reactor thread %s failed to wake up by reading socketpair", eventLoop->thread_name);
+    /**
+     * read before clearing flag: while flag is set no producer writes, so the read can't swallow a write meant for later.
+     * a wakeup requested after the clear writes again and is seen by next dispatch,
+     * operations enqueued before it are drained after the callbacks of this round.
+     */
+    uint64_t count;
+    ssize_t n = read(eventLoop->wakeupFd, &count, sizeof(count));
+    atomic_store_explicit(&eventLoop->wakeupPending, 0, memory_order_release);
+    if (n < 0 && errno != EAGAIN) {
+        LOG(LT_WARN, "sub-reactor thread %s failed to wake up by reading eventfd", eventLoop->thread_name);
         return -1;
     }
     LOG(LT_DEBUG, "thread %s wakes up", eventLoop->thread_name);
     return 0;
 }
 
+int event_loop_activate_later(struct event_loop* eventLoop, struct channel* chan, int events)
+{
+    assertInOwnerThread(eventLoop);
+    if (eventLoop->ndeferred == eventLoop->deferredCap) {
+        int ncap = eventLoop->deferredCap > 0 ? eventLoop->deferredCap << 1 : 64;
+        struct deferred_activation* tmp = realloc(eventLoop->deferred, ncap * sizeof(struct deferred_activation));
+        if (tmp == NULL) return -1;
+        eventLoop->deferred = tmp;
+        eventLoop->deferredCap = ncap;
+    }
+    eventLoop->deferred[eventLoop->ndeferred].fd = chan->fd;
+    eventLoop->deferred[eventLoop->ndeferred].events = events;
+    eventLoop->ndeferred++;
+    return 0;
+}
+
+int event_loop_add_timer(struct event_loop* eventLoop, struct timer* timer, uint64_t delay, uint64_t interval)
+{
+    assertInOwnerThread(eventLoop);
+    timer->interval = interval;
+    /* relative to the clock cached in this round, so that re-arming timers per event costs no clock read */
+    timer_wheel_add(eventLoop->timerWheel, timer, event_loop_now_ms(eventLoop) + delay);
+    return 0;
+}
+
+int event_loop_cancel_timer(struct event_loop* eventLoop, struct timer* timer)
+{
+    assertInOwnerThread(eventLoop);
+    timer_wheel_cancel(eventLoop->timerWheel, timer);
+    return 0;
+}
+
+/* activate events deferred in last round, events deferred again by callbacks wait for next round */
+static void event_loop_run_deferred(struct event_loop* eventLoop)
+{
+    int n = eventLoop->ndeferred;
+    if (n == 0) return;
+    for (int i = 0; i < n; i++) {
+        struct deferred_activation act = eventLoop->deferred[i];
+        channel_event_activate(eventLoop, act.fd, act.events);
+    }
+    eventLoop->ndeferred -= n;
+    memmove(eventLoop->deferred, &eventLoop->deferred[n], eventLoop->ndeferred * sizeof(struct deferred_activation));
+}
+
 /* infinite loop for event dispatcher */
 int event_loop_run(struct event_loop* eventLoop)
 {
     struct timeval timeout;
-    timeout.tv_sec = DISPATCH_TIMEOUT_SEC;
 
     eventLoop->status = EVENT_LOOP_RUNNING;
+    /* log records of this thread take their time from the loop clock */
+    loop_clock_self = &eventLoop->clock;
+    loop_clock_update(&eventLoop->clock);
 
     LOG(LT_INFO, "%s start event looping ...", eventLoop->thread_name);
     while (eventLoop->status != EVENT_LOOP_OVER) {
         LOG(LT_DEBUG, "%s begin event dispatching ...", eventLoop->thread_name);
+        /* wait until next timer is due, only poll for new events if some channel is waiting for its deferred activation */
+        int64_t wait = timer_wheel_next_timeout(eventLoop->timerWheel, event_loop_now_ms(eventLoop), DISPATCH_TIMEOUT_SEC * 1000);
+        if (wait < 0) wait = DISPATCH_TIMEOUT_SEC * 1000;
+        if (eventLoop->ndeferred > 0 || eventLoop->nlocalTask > 0) wait = 0;
+        timeout.tv_sec = wait / 1000;
+        timeout.tv_usec = (wait % 1000) * 1000;
+        /* dispatcher refreshes the loop clock as soon as its wait returns */
         eventLoop->eventDispatcher->dispatch(eventLoop, &timeout);
         event_loop_handle_pending_channel(eventLoop);
+        event_loop_run_tasks(eventLoop);
+        event_loop_run_deferred(eventLoop);
+        timer_wheel_expire(eventLoop->timerWheel, event_loop_now_ms(eventLoop));
     }
     return 0;
 }
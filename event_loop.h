@@ -4,6 +4,11 @@
 #include "channel_map.h"
 #include "common.h"
 #include "event_dispatcher.h"
+#include "timer_wheel.h"
+#include "mpsc_queue.h"
+#include "slab.h"
+#include "loop_clock.h"
+#include <stdatomic.h>
 
 #define DEFAULT_MAIN_REACTOR_NAME "main-reactor"
 
@@ -19,20 +24,30 @@
 extern const struct event_dispatcher select_dispatcher;
 extern const struct event_dispatcher poll_dispatcher;
 extern const struct event_dispatcher epoll_dispatcher;
+extern const struct event_dispatcher io_uring_dispatcher;
 
-/* channel链表 */
-// TODO: 待处理pending list可以改成链表实现的队列
-// TODO: 每次向pending list中添加新的channel opt都需要malloc，处理玩之后又需要释放，比较占用时间，考虑使用一个队列维护事先分配好的可供使用的channel_element
-struct channel_element {
-    int type;
-    struct channel* channel;
-    struct channel_element* next;
+typedef void (*event_loop_task)(void* arg);
+
+/* function queued to run in owner thread */
+struct loop_task {
+    event_loop_task fn;
+    void* arg;
+};
+
+/* channel events activated again in next loop round without waiting for dispatcher */
+struct deferred_activation {
+    int fd;
+    int events;
 };
 
-struct channelopt_pending_list {
-    int optcnt;
-    struct channel_element* head;
-    struct channel_element* tail;
+/**
+ * load counters of the reactor thread running an event_loop, read by main-reactor when selecting a sub-reactor
+ * updated with relaxed atomics, counters of different threads sit on separate cache lines
+ */
+struct event_loop_load {
+    _Alignas(CACHE_LINE_SIZE) atomic_long activeConns;  // connections currently handled
+    atomic_long queuedBytes;                            // bytes waiting in output buffers of those connections
+    atomic_ulong connHandled;                           // connections handled since start
 };
 
 /* reactor模型 */
@@ -42,20 +57,44 @@ struct event_loop {
     /* 事件分发器，由具体的select/poll/epoll I/O复用实现 */
     const struct event_dispatcher* eventDispatcher;
     void* event_dispatcher_data; 
-    /* 文件描述符和channel的映射，用于通过fd快速获得channel，进而快速找到相应事件的回调函数 struct channel* chan = channelMap[fd] */
+    /* 文件描述符和channel的映射，用于通过fd快速获得channel，进而快速找到相应事件的回调函数 struct channel* chan = chanmap_get(channelMap, fd) */
     struct channel_map* channelMap; 
 
-    /* 等待在事件分发器(select/poll/epoll)中修改的channel链表 串行无锁 */
-    int is_handling_pending;
-    struct channel_element* pending_head;
-    struct channel_element* pending_tail;
+    /* 其他线程提交的、等待在事件分发器(select/poll/epoll)中执行的channel操作，无锁多生产者单消费者队列，由owner线程消费 */
+    struct mpsc_queue* pendingQueue;
 
     pthread_t owner_tid;
-    pthread_mutex_t mutex;
-    pthread_cond_t cond;
 
-    /* 一对无名的相互连接的套接字，可用于全双共通信 */
-    int socketPair[2]; 
+    /* 其他线程提交的任务，与pendingQueue分开，使channel操作的同步处理不会在回调中途执行任意任务 */
+    struct mpsc_queue* taskQueue;
+    /* owner线程自身排队的任务，仅由owner线程访问 */
+    struct loop_task* localTasks;
+    int nlocalTask;
+    int localTaskCap;
+
+    /* 下一轮循环中直接激活的channel事件，例如被I/O预算打断的边沿触发channel，仅由owner线程访问 */
+    struct deferred_activation* deferred;
+    int ndeferred;
+    int deferredCap;
+
+    /* 所属reactor线程的负载计数，main-reactor独占时为NULL */
+    struct event_loop_load* load;
+
+    /* 时钟快照，每轮dispatch返回后刷新一次，仅由owner线程访问 */
+    struct loop_clock clock;
+
+    /* 定时器时间轮，驱动dispatcher超时时间，仅由owner线程访问 */
+    struct timer_wheel* timerWheel;
+
+    /* storage of connection buffers handled by this loop, only used by owner thread */
+    struct buffer_pool* bufferPool;
+
+    /* connection objects handled by this loop, each one a cache-line-aligned tcp_connection_block, only used by owner thread */
+    struct slab* connSlab;
+
+    /* 跨线程唤醒用的eventfd，wakeupPending置位期间其他线程不再重复写入，两次dispatch之间至多一次write和一次read */
+    int wakeupFd;
+    atomic_int wakeupPending;
     char* thread_name;
 };
 
@@ -83,6 +122,63 @@ void event_loop_cleanup(struct event_loop* eventLoop);
 /* event_dispather检测到fd上的I/O事件后，调用该方法通知event_loop执行对应事件的相关callback方法，EVENT_READ | EVENT_WRITE等 */
 int channel_event_activate(struct event_loop* eventLoop, int fd, int revent);
 
+/**
+ * activate events of chan again in next loop round, dispatcher doesn't wait while there are deferred activations
+ * edge-triggered channel calls it when it stops reading before EAGAIN, since no new edge will be reported
+ * only called by owner thread
+ */
+int event_loop_activate_later(struct event_loop* eventLoop, struct channel* chan, int events);
+
+/**
+ * arm timer to fire delay ms later, then every interval ms if interval > 0
+ * an armed timer is rescheduled, timer must stay valid until it's cancelled or has fired for the last time
+ * O(1) without allocation, only called by owner thread
+ */
+int event_loop_add_timer(struct event_loop* eventLoop, struct timer* timer, uint64_t delay, uint64_t interval);
+
+/* disarm timer, no-op if it's not armed, only called by owner thread */
+int event_loop_cancel_timer(struct event_loop* eventLoop, struct timer* timer);
+
+/**
+ * run fn(arg) in owner thread: at once when called by owner thread, otherwise queued as event_loop_queue_in_loop() does
+ * e.g. sending on a connection owned by another reactor
+ */
+int event_loop_run_in_loop(struct event_loop* eventLoop, event_loop_task fn, void* arg);
+
+/**
+ * queue fn(arg) to run in owner thread after next dispatch returns, even when called by owner thread, any thread
+ * tasks run in submission order per thread, in batches of at most MPSC_QUEUE_CAPACITY per round,
+ * a batch costs other threads a single wakeup, and queueing never allocates
+ */
+int event_loop_queue_in_loop(struct event_loop* eventLoop, event_loop_task fn, void* arg);
+
+/**
+ * cached clock of the loop, taken when the wait of this round returned, before any callback ran,
+ * only called by owner thread
+ * lags behind by the time callbacks of this round took so far, use timer_now_ms() where that matters
+ */
+static inline uint64_t event_loop_now_ms(struct event_loop* eventLoop)
+{
+    return eventLoop->clock.monotonicMs;
+}
+
+static inline const struct timespec* event_loop_wall_time(struct event_loop* eventLoop)
+{
+    return &eventLoop->clock.realtime;
+}
+
+/* current second as HTTP-date, e.g. "Sun, 06 Nov 1994 08:49:37 GMT", for Date header */
+static inline const char* event_loop_http_date(struct event_loop* eventLoop)
+{
+    return eventLoop->clock.httpDate;
+}
+
+/* current second in local time, e.g. "2026-10-17 07:21:49" */
+static inline const char* event_loop_log_time(struct event_loop* eventLoop)
+{
+    return eventLoop->clock.logTime;
+}
+
 /* 每个reactor线程持有一个独立的event_loop，断言当前线程处理的是自身的event_loop */
 void assertInOwnerThread(struct event_loop* eventLoop);
 
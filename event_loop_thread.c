@@ -5,12 +5,17 @@ static void* event_loop_thread_routine(void* arg)
 {
     struct event_loop_thread* eventLoopThread = (struct event_loop_thread*)arg;
 
+    /* thread already runs on its cpu, allocate its loop, buffers and connections from the local node */
+    if (eventLoopThread->cpu != AFFINITY_CPU_UNBOUND && affinity_bind_memory_local() == 0)
+        LOG(LT_INFO, "%s pinned to cpu %d, numa node %d", eventLoopThread->threadName, eventLoopThread->cpu, affinity_cpu_node(eventLoopThread->cpu));
+
     pthread_mutex_lock(&eventLoopThread->mutex);
     struct event_loop* eventLoop = event_loop_new(eventLoopThread->threadName);
     if (eventLoop == NULL) {
         LOG(LT_WARN, "failed to initialize %s!", eventLoopThread->threadName);
         return NULL;
     }
+    eventLoop->load = &eventLoopThread->load;
     eventLoopThread->eventLoop = eventLoop;
     pthread_mutex_unlock(&eventLoopThread->mutex);
     pthread_cond_signal(&eventLoopThread->cond);
@@ -32,14 +37,36 @@ void event_loop_thread_init(struct event_loop_thread* eventLoopThread, int id)
     char* name = malloc(32);
     sprintf(name, "%s%d", SUB_REACTOR_PREFIX, id);
     eventLoopThread->threadName = name;
-    eventLoopThread->connHandled = 0;
+    eventLoopThread->cpu = AFFINITY_CPU_UNBOUND;
+    eventLoopThread->rtPriority = 0;
+    atomic_init(&eventLoopThread->load.activeConns, 0);
+    atomic_init(&eventLoopThread->load.queuedBytes, 0);
+    atomic_init(&eventLoopThread->load.connHandled, 0);
 }
 
 void event_loop_thread_run(struct event_loop_thread* eventLoopThread)
 {
     if (eventLoopThread == NULL) return;
 
-    pthread_create(&eventLoopThread->tid, NULL, &event_loop_thread_routine, eventLoopThread);
+    /* pin and prioritize before the thread starts, so that nothing it allocates lands on another node */
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    if (eventLoopThread->cpu != AFFINITY_CPU_UNBOUND)
+        affinity_attr_set_cpu(&attr, eventLoopThread->cpu);
+    if (eventLoopThread->rtPriority > 0)
+        affinity_attr_set_realtime(&attr, eventLoopThread->rtPriority);
+    int ret = pthread_create(&eventLoopThread->tid, &attr, &event_loop_thread_routine, eventLoopThread);
+    if (ret == EPERM && eventLoopThread->rtPriority > 0) {
+        /* no CAP_SYS_NICE, run with normal priority */
+        LOG(LT_WARN, "%s not permitted to run with SCHED_FIFO", eventLoopThread->threadName);
+        pthread_attr_setinheritsched(&attr, PTHREAD_INHERIT_SCHED);
+        ret = pthread_create(&eventLoopThread->tid, &attr, &event_loop_thread_routine, eventLoopThread);
+    }
+    pthread_attr_destroy(&attr);
+    if (ret != 0) {
+        LOG(LT_ERROR, "failed to create %s, %s", eventLoopThread->threadName, strerror(ret));
+        return;
+    }
 
     pthread_mutex_lock(&eventLoopThread->mutex);
     while (eventLoopThread->eventLoop == NULL) { 
@@ -7,6 +7,7 @@
 #include <string.h>
 #include "log.h"
 #include "event_loop.h"
+#include "affinity.h"
 
 #define SUB_REACTOR_PREFIX "sub-reactor-"
 
@@ -20,7 +21,12 @@ struct event_loop_thread {
     pthread_cond_t cond;
     pthread_mutex_t mutex;
     char* threadName;
-    unsigned long connHandled;
+    /* 绑定的cpu，AFFINITY_CPU_UNBOUND表示不绑定；绑定时内存从该cpu所在numa节点分配 */
+    int cpu;
+    /* SCHED_FIFO优先级，0表示普通调度 */
+    int rtPriority;
+    /* 负载计数，由该线程的event_loop更新，供thread_pool选择sub-reactor */
+    struct event_loop_load load;
 };
 
 /**
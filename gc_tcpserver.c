@@ -1,4 +1,5 @@
 #include "server.h"
+#include <sys/sysinfo.h>
 
 int onClientConnected(struct tcp_connection* tcpConn)
 {
@@ -17,6 +18,7 @@ int onClientMsgRecieved(struct tcp_connection* tcpConn)
     }
     /* buffer_show_content(output); */
     tcp_connection_send_buffer(tcpConn, output);
+    buffer_cleanup(output);
     return 0;
 }
 
@@ -36,7 +38,7 @@ int onClientDisconnected(struct tcp_connection* tcpConn)
 int main(int argc, char** argv)
 {
     if (argc < 3) {
-        printf("usage: ./gc_tcpserver <PORT> <nthread>\n");
+        printf("usage: ./gc_tcpserver <PORT> <nthread> [et] [reuseport] [ipv6] [p2c] [pin]\n");
         return -1;
     }
     if (atoi(argv[2]) > 10) {
@@ -45,6 +47,22 @@ int main(int argc, char** argv)
     }
     struct server* tcpServer = server_new("main-reactor", TCP_SERVER, atoi(argv[1]), atoi(argv[2]),
             onClientConnected, onClientMsgRecieved, onClientMsgSent, onClientDisconnected, NULL);
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "et") == 0)
+            server_enable_edge_triggered(tcpServer);
+        else if (strcmp(argv[i], "reuseport") == 0)
+            server_enable_reuseport(tcpServer, 0);
+        else if (strcmp(argv[i], "ipv6") == 0)
+            server_enable_ipv6(tcpServer, 1);
+        else if (strcmp(argv[i], "p2c") == 0)
+            server_set_select_policy(tcpServer, THREAD_POOL_POWER_OF_TWO, NULL);
+        else if (strcmp(argv[i], "pin") == 0) {
+            /* main-reactor and sub-reactors on consecutive cpus */
+            int cpus[11];
+            for (int j = 0; j <= atoi(argv[2]); j++) cpus[j] = j % get_nprocs();
+            server_set_affinity(tcpServer, cpus, atoi(argv[2]) + 1);
+        }
+    }
     LOG(LT_INFO, "server initialized successfully, main thread: %s", tcpServer->eventLoop->thread_name);
     server_run(tcpServer);
     LOG(LT_INFO, "server exit successfully");
@@ -0,0 +1,87 @@
+#include "http/http_server.h"
+#include "http/static_file.h"
+
+static const char HELLO[] = "hello, world\n";
+
+#define STREAM_LINES 1000000    // lines of GET /stream, about 16MB
+#define STREAM_PIECE 16384      // bytes written per producer call
+
+/* GET /stream numbers lines one piece at a time, only what peer is about to read is ever buffered */
+int onStreamProduce(struct http_connection* httpConn, void* arg)
+{
+    int* next = arg;
+    char piece[STREAM_PIECE];
+    size_t len = 0;
+    while (*next < STREAM_LINES && len + 16 <= sizeof(piece))
+        len += snprintf(piece + len, sizeof(piece) - len, "line %d\n", (*next)++);
+    http_connection_write_chunk(httpConn, piece, len);
+    return *next < STREAM_LINES ? HTTP_STREAM_MORE : HTTP_STREAM_DONE;
+}
+
+/**
+ * POST /echo answers the request body, GET /stream a generated body, others are served from static directory if any,
+ * else GET / answers a fixed greeting, which may be cached for a second by Accept-Encoding
+ */
+int onHttpRequest(struct http_connection* httpConn, const struct http_request* request, struct http_response* response)
+{
+    struct buffer* input = http_connection_input(httpConn);
+    struct static_dir* dir = httpConn->httpServer->data;
+    int stream = http_slice_equal(input, request->path, "/stream", 7);
+    if (dir != NULL && !stream && !http_slice_equal(input, request->path, "/echo", 5))
+        return static_dir_serve(dir, httpConn, request, response);
+
+    response->contentType = "text/plain";
+    if (stream) {
+        int* next = calloc(1, sizeof(int));
+        if (next == NULL) return -1;
+        http_response_set_stream(response, onStreamProduce, free, next);
+    } else if (http_slice_equal(input, request->path, "/", 1)) {
+        int vary = HTTP_HDR_ACCEPT_ENCODING;
+        http_response_set_body(response, HELLO, sizeof(HELLO) - 1);
+        http_response_set_cacheable(response, 1000, &vary, 1);
+    } else if (http_slice_equal(input, request->path, "/echo", 5)) {
+        http_response_set_body(response, http_connection_slice(httpConn, request->body), request->body.len);
+    } else {
+        response->status = 404;
+        http_response_set_body(response, "not found\n", 10);
+    }
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        printf("usage: ./gc_httpserver <PORT> <nthread> [et] [static <dir>] [cache] [keepalive timeout ms] [max requests] [max idle]\n");
+        return -1;
+    }
+    if (atoi(argv[2]) > 10) {
+        printf("too many threads!\n");
+        return -1;
+    }
+    int argi = 3, edgeTriggered = 0;
+    struct static_dir* dir = NULL;
+    if (argi < argc && strcmp(argv[argi], "et") == 0) {
+        edgeTriggered = 1;
+        argi++;
+    }
+    if (argi + 1 < argc && strcmp(argv[argi], "static") == 0) {
+        if ((dir = static_dir_new(argv[argi + 1])) == NULL) return -1;
+        argi += 2;
+    }
+    struct http_server* httpServer = http_server_new("main-reactor", atoi(argv[1]), atoi(argv[2]), onHttpRequest, dir);
+    if (httpServer == NULL) return -1;
+    if (argi < argc && strcmp(argv[argi], "cache") == 0) {
+        http_server_enable_cache(httpServer, 0);
+        argi++;
+    }
+    if (edgeTriggered)
+        server_enable_edge_triggered(httpServer->server);
+    http_server_set_keepalive(httpServer,
+            argi < argc ? strtoull(argv[argi], NULL, 10) : 0,
+            argi + 1 < argc ? atoi(argv[argi + 1]) : 0,
+            argi + 2 < argc ? atoi(argv[argi + 2]) : 0);
+    LOG(LT_INFO, "http server initialized successfully, main thread: %s", httpServer->server->eventLoop->thread_name);
+    http_server_run(httpServer);
+    LOG(LT_INFO, "http server exit successfully");
+    return 0;
+}
@@ -0,0 +1,194 @@
+#include "http/http_cache.h"
+
+static void http_cache_uncache(struct http_cache_shard* shard, struct http_cache_entry* entry);
+static int http_cache_match(struct http_cache_entry* entry, struct buffer* buff, const struct http_request* request);
+
+struct http_cache_shard* http_cache_shard_new(size_t maxBytes)
+{
+    struct http_cache_shard* shard = calloc(1, sizeof(struct http_cache_shard));
+    if (shard == NULL) {
+        LOG(LT_ERROR, "failed to allocate http cache shard");
+        return NULL;
+    }
+    shard->maxBytes = maxBytes > 0 ? maxBytes : HTTP_CACHE_BYTES;
+    return shard;
+}
+
+/* FNV-1a */
+static uint32_t http_cache_hash(const char* data, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+struct http_cache_entry* http_cache_lookup(struct http_cache_shard* shard, struct buffer* buff,
+        const struct http_request* request, uint64_t now)
+{
+    const char* uri = http_slice_ptr(buff, request->uri);
+    uint32_t hash = http_cache_hash(uri, request->uri.len);
+    struct http_cache_entry* entry = shard->buckets[hash & (HTTP_CACHE_BUCKETS - 1)];
+    struct http_cache_entry* next;
+
+    for (; entry != NULL; entry = next) {
+        next = entry->hnext;
+        if (entry->hash != hash || entry->uriLen != request->uri.len || memcmp(entry->uri, uri, entry->uriLen) != 0)
+            continue;
+        if (entry->expire <= now) {
+            http_cache_uncache(shard, entry);
+            continue;
+        }
+        if (http_cache_match(entry, buff, request))
+            break;
+    }
+    if (entry == NULL) {
+        shard->misses++;
+        return NULL;
+    }
+
+    shard->hits++;
+    if (entry != shard->head) {
+        /* move to front of lru list */
+        entry->prev->next = entry->next;
+        if (entry->next != NULL) entry->next->prev = entry->prev;
+        else shard->tail = entry->prev;
+        entry->prev = NULL;
+        entry->next = shard->head;
+        shard->head->prev = entry;
+        shard->head = entry;
+    }
+    return entry;
+}
+
+/* whether request carries the vary header values entry was stored for */
+static int http_cache_match(struct http_cache_entry* entry, struct buffer* buff, const struct http_request* request)
+{
+    for (int i = 0; i < entry->nvary; i++) {
+        const struct http_header* header = http_request_header(request, entry->varyIds[i]);
+        if (header == NULL) {
+            if (entry->varyLen[i] >= 0) return 0;
+            continue;
+        }
+        if (entry->varyLen[i] != (int32_t)header->value.len ||
+            memcmp(entry->varyValue[i], http_slice_ptr(buff, header->value), header->value.len) != 0)
+            return 0;
+    }
+    return 1;
+}
+
+struct http_cache_entry* http_cache_store(struct http_cache_shard* shard, struct buffer* buff, const struct http_request* request,
+        const int* varyIds, int nvary, uint64_t ttl, uint64_t now,
+        const char* head, size_t headLen, const void* body, size_t bodyLen)
+{
+    const struct http_header* varyHeaders[HTTP_CACHE_MAX_VARY];
+    size_t bytes = sizeof(struct http_cache_entry) + request->uri.len + headLen + bodyLen;
+
+    if (nvary > HTTP_CACHE_MAX_VARY) return NULL;
+    for (int i = 0; i < nvary; i++) {
+        varyHeaders[i] = http_request_header(request, varyIds[i]);
+        if (varyHeaders[i] != NULL) bytes += varyHeaders[i]->value.len;
+    }
+    if (bytes > shard->maxBytes / HTTP_CACHE_ENTRY_FRACTION) return NULL;
+
+    struct http_cache_entry* entry = malloc(bytes);
+    if (entry == NULL) return NULL;
+    char* p = entry->storage;
+    entry->refCount = 1;
+    entry->cached = 1;
+    entry->expire = now + ttl;
+    entry->bytes = bytes;
+    entry->uri = p;
+    entry->uriLen = request->uri.len;
+    memcpy(p, http_slice_ptr(buff, request->uri), entry->uriLen);
+    p += entry->uriLen;
+    entry->hash = http_cache_hash(entry->uri, entry->uriLen);
+    entry->nvary = nvary;
+    for (int i = 0; i < nvary; i++) {
+        entry->varyIds[i] = varyIds[i];
+        entry->varyValue[i] = p;
+        if (varyHeaders[i] == NULL) {
+            entry->varyLen[i] = -1;
+            continue;
+        }
+        entry->varyLen[i] = varyHeaders[i]->value.len;
+        memcpy(p, http_slice_ptr(buff, varyHeaders[i]->value), entry->varyLen[i]);
+        p += entry->varyLen[i];
+    }
+    entry->data = p;
+    entry->headEnd = headLen;
+    entry->size = headLen + bodyLen;
+    memcpy(p, head, headLen);
+    if (bodyLen > 0) memcpy(p + headLen, body, bodyLen);
+
+    /* the variant is stored again once it expired or its handler ran anyway, replace the old copy */
+    for (struct http_cache_entry* old = shard->buckets[entry->hash & (HTTP_CACHE_BUCKETS - 1)], *next; old != NULL; old = next) {
+        next = old->hnext;
+        if (old->hash == entry->hash && old->uriLen == entry->uriLen && memcmp(old->uri, entry->uri, entry->uriLen) == 0 &&
+            http_cache_match(old, buff, request))
+            http_cache_uncache(shard, old);
+    }
+    while (shard->bytes + bytes > shard->maxBytes && shard->tail != NULL) {
+        shard->evictions++;
+        http_cache_uncache(shard, shard->tail);
+    }
+
+    struct http_cache_entry** bucket = &shard->buckets[entry->hash & (HTTP_CACHE_BUCKETS - 1)];
+    entry->hnext = *bucket;
+    *bucket = entry;
+    entry->prev = NULL;
+    entry->next = shard->head;
+    if (shard->head != NULL) shard->head->prev = entry;
+    else shard->tail = entry;
+    shard->head = entry;
+    shard->bytes += bytes;
+    shard->nentry++;
+    shard->stores++;
+    return entry;
+}
+
+/* unlink entry and drop the reference of shard */
+static void http_cache_uncache(struct http_cache_shard* shard, struct http_cache_entry* entry)
+{
+    struct http_cache_entry** pp = &shard->buckets[entry->hash & (HTTP_CACHE_BUCKETS - 1)];
+    while (*pp != entry) pp = &(*pp)->hnext;
+    *pp = entry->hnext;
+
+    if (entry->prev != NULL) entry->prev->next = entry->next;
+    else shard->head = entry->next;
+    if (entry->next != NULL) entry->next->prev = entry->prev;
+    else shard->tail = entry->prev;
+
+    shard->bytes -= entry->bytes;
+    shard->nentry--;
+    entry->cached = 0;
+    http_cache_release(entry);
+}
+
+void http_cache_hold(struct http_cache_entry* entry)
+{
+    entry->refCount++;
+}
+
+void http_cache_release(void* arg)
+{
+    struct http_cache_entry* entry = arg;
+    if (--entry->refCount > 0) return;
+    free(entry);
+}
+
+void http_cache_show_stats(struct http_cache_shard* shard)
+{
+    LOG(LT_INFO, "http cache: %d entries, %zu/%zu bytes, %lu hits, %lu misses, %lu stores, %lu evictions",
+            shard->nentry, shard->bytes, shard->maxBytes, shard->hits, shard->misses, shard->stores, shard->evictions);
+}
+
+void http_cache_shard_cleanup(struct http_cache_shard* shard)
+{
+    if (shard == NULL) return;
+    while (shard->head != NULL)
+        http_cache_uncache(shard, shard->head);
+    free(shard);
+}
@@ -0,0 +1,84 @@
+#ifndef HTTP_CACHE_H
+#define HTTP_CACHE_H
+#include "http/http_parser.h"
+
+#define HTTP_CACHE_BYTES (64 << 20)     // default capacity of one shard
+#define HTTP_CACHE_BUCKETS 4096
+#define HTTP_CACHE_MAX_VARY 4           // request headers a cached response may vary on
+#define HTTP_CACHE_ENTRY_FRACTION 8     // responses larger than 1/8 of shard capacity are not cached
+
+/**
+ * fully serialized GET response, shared by every connection answered from it
+ * data holds status line and headers that don't depend on the request, then body at data + headEnd,
+ * so that a hit writes both in place around the few bytes that do (Date, Connection).
+ * shard holds one reference while entry is cached, every response queued from it one per queued part,
+ * memory is freed when the last one is dropped, so eviction never cuts a response being sent.
+ */
+struct http_cache_entry {
+    struct http_cache_entry* hnext;     // hash chain
+    struct http_cache_entry* prev;      // lru list, most recently used first
+    struct http_cache_entry* next;
+    int refCount;
+    int cached;
+    uint32_t hash;                      // of uri, variants of a uri share a chain
+    uint64_t expire;                    // ms of loop clock
+    size_t bytes;                       // charged to shard
+    char* uri;
+    uint32_t uriLen;
+    int nvary;
+    int varyIds[HTTP_CACHE_MAX_VARY];   // HTTP_HDR_* the response varies on
+    int32_t varyLen[HTTP_CACHE_MAX_VARY]; // length of request header value it was stored for, -1 if absent
+    char* varyValue[HTTP_CACHE_MAX_VARY];
+    char* data;
+    size_t headEnd;
+    size_t size;
+    char storage[];                     // uri, vary values and data
+};
+
+/**
+ * LRU response cache of one reactor, bounded by bytes, entries expire after their TTL
+ * every reactor owns its shard and is the only thread touching it, so neither lookups nor refcounts take a lock
+ */
+struct http_cache_shard {
+    size_t maxBytes;
+    size_t bytes;
+    int nentry;
+    struct http_cache_entry* head;
+    struct http_cache_entry* tail;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long stores;
+    unsigned long evictions;
+    struct http_cache_entry* buckets[HTTP_CACHE_BUCKETS];
+};
+
+/* create an empty shard holding at most maxBytes */
+struct http_cache_shard* http_cache_shard_new(size_t maxBytes);
+
+/**
+ * entry for GET request read from buff, whose stored vary header values equal those of request, NULL on miss
+ * expired entries are dropped on the way, entry stays valid until control returns to the loop
+ */
+struct http_cache_entry* http_cache_lookup(struct http_cache_shard* shard, struct buffer* buff,
+        const struct http_request* request, uint64_t now);
+
+/**
+ * cache head (headLen bytes) and body as response to request for ttl ms, varying on nvary header ids,
+ * replacing an entry of the same variant, least recently used entries are evicted to make room
+ * return the new entry, NULL if response is too large
+ */
+struct http_cache_entry* http_cache_store(struct http_cache_shard* shard, struct buffer* buff, const struct http_request* request,
+        const int* varyIds, int nvary, uint64_t ttl, uint64_t now,
+        const char* head, size_t headLen, const void* body, size_t bodyLen);
+
+/* take a reference, dropped by http_cache_release(), e.g. as buffer_release_callback of a queued part */
+void http_cache_hold(struct http_cache_entry* entry);
+void http_cache_release(void* entry);
+
+/* print hit and memory counters */
+void http_cache_show_stats(struct http_cache_shard* shard);
+
+/* drop every entry, memory of those still queued is freed once they are sent */
+void http_cache_shard_cleanup(struct http_cache_shard* shard);
+
+#endif
@@ -0,0 +1,381 @@
+#include "http/http_parser.h"
+#include <stddef.h>
+#include <strings.h>
+
+/* parser states */
+#define S_START 0
+#define S_METHOD 1
+#define S_URI_START 2
+#define S_URI 3
+#define S_VERSION 4
+#define S_REQUEST_LINE_LF 5
+#define S_HEADER_START 6
+#define S_HEADER_NAME 7
+#define S_VALUE_START 8
+#define S_VALUE 9
+#define S_HEADER_LF 10
+#define S_HEADERS_END_LF 11
+#define S_BODY 12
+#define S_DONE 13
+
+/* perfect hash of well-known header names: length, first and last character in lower case, collision-free for HTTP_HDR_* */
+#define HTTP_HDR_HASH_SIZE 64
+#define HTTP_HDR_HASH(len, first, last) (((len) + (first) + 4 * (last)) & (HTTP_HDR_HASH_SIZE - 1))
+
+static const char* HTTP_HEADER_NAMES[HTTP_HDR_COUNT] = {
+    [HTTP_HDR_UNKNOWN] = "",
+    [HTTP_HDR_HOST] = "Host",
+    [HTTP_HDR_CONNECTION] = "Connection",
+    [HTTP_HDR_CONTENT_LENGTH] = "Content-Length",
+    [HTTP_HDR_CONTENT_TYPE] = "Content-Type",
+    [HTTP_HDR_TRANSFER_ENCODING] = "Transfer-Encoding",
+    [HTTP_HDR_USER_AGENT] = "User-Agent",
+    [HTTP_HDR_ACCEPT] = "Accept",
+    [HTTP_HDR_ACCEPT_ENCODING] = "Accept-Encoding",
+    [HTTP_HDR_ACCEPT_LANGUAGE] = "Accept-Language",
+    [HTTP_HDR_IF_NONE_MATCH] = "If-None-Match",
+    [HTTP_HDR_IF_MODIFIED_SINCE] = "If-Modified-Since",
+    [HTTP_HDR_IF_RANGE] = "If-Range",
+    [HTTP_HDR_RANGE] = "Range",
+    [HTTP_HDR_EXPECT] = "Expect",
+    [HTTP_HDR_COOKIE] = "Cookie",
+    [HTTP_HDR_AUTHORIZATION] = "Authorization",
+    [HTTP_HDR_REFERER] = "Referer",
+    [HTTP_HDR_CACHE_CONTROL] = "Cache-Control",
+    [HTTP_HDR_UPGRADE] = "Upgrade",
+    [HTTP_HDR_ORIGIN] = "Origin",
+    [HTTP_HDR_KEEP_ALIVE] = "Keep-Alive",
+    [HTTP_HDR_TE] = "TE",
+};
+
+static const int8_t HTTP_HEADER_HASH_TABLE[HTTP_HDR_HASH_SIZE] = {
+    [HTTP_HDR_HASH(4, 'h', 't')] = HTTP_HDR_HOST,
+    [HTTP_HDR_HASH(10, 'c', 'n')] = HTTP_HDR_CONNECTION,
+    [HTTP_HDR_HASH(14, 'c', 'h')] = HTTP_HDR_CONTENT_LENGTH,
+    [HTTP_HDR_HASH(12, 'c', 'e')] = HTTP_HDR_CONTENT_TYPE,
+    [HTTP_HDR_HASH(17, 't', 'g')] = HTTP_HDR_TRANSFER_ENCODING,
+    [HTTP_HDR_HASH(10, 'u', 't')] = HTTP_HDR_USER_AGENT,
+    [HTTP_HDR_HASH(6, 'a', 't')] = HTTP_HDR_ACCEPT,
+    [HTTP_HDR_HASH(15, 'a', 'g')] = HTTP_HDR_ACCEPT_ENCODING,
+    [HTTP_HDR_HASH(15, 'a', 'e')] = HTTP_HDR_ACCEPT_LANGUAGE,
+    [HTTP_HDR_HASH(13, 'i', 'h')] = HTTP_HDR_IF_NONE_MATCH,
+    [HTTP_HDR_HASH(17, 'i', 'e')] = HTTP_HDR_IF_MODIFIED_SINCE,
+    [HTTP_HDR_HASH(8, 'i', 'e')] = HTTP_HDR_IF_RANGE,
+    [HTTP_HDR_HASH(5, 'r', 'e')] = HTTP_HDR_RANGE,
+    [HTTP_HDR_HASH(6, 'e', 't')] = HTTP_HDR_EXPECT,
+    [HTTP_HDR_HASH(6, 'c', 'e')] = HTTP_HDR_COOKIE,
+    [HTTP_HDR_HASH(13, 'a', 'n')] = HTTP_HDR_AUTHORIZATION,
+    [HTTP_HDR_HASH(7, 'r', 'r')] = HTTP_HDR_REFERER,
+    [HTTP_HDR_HASH(13, 'c', 'l')] = HTTP_HDR_CACHE_CONTROL,
+    [HTTP_HDR_HASH(7, 'u', 'e')] = HTTP_HDR_UPGRADE,
+    [HTTP_HDR_HASH(6, 'o', 'n')] = HTTP_HDR_ORIGIN,
+    [HTTP_HDR_HASH(10, 'k', 'e')] = HTTP_HDR_KEEP_ALIVE,
+    [HTTP_HDR_HASH(2, 't', 'e')] = HTTP_HDR_TE,
+};
+
+static const char* HTTP_METHOD_NAMES[] = {
+    "", "GET", "HEAD", "POST", "PUT", "DELETE", "OPTIONS", "PATCH", "CONNECT", "TRACE"
+};
+
+/* tchar of RFC 7230 */
+static const char HTTP_TOKEN_CHARS[256] = {
+    ['!'] = 1, ['#'] = 1, ['$'] = 1, ['%'] = 1, ['&'] = 1, ['\''] = 1, ['*'] = 1, ['+'] = 1, ['-'] = 1, ['.'] = 1,
+    ['^'] = 1, ['_'] = 1, ['`'] = 1, ['|'] = 1, ['~'] = 1,
+    ['0'] = 1, ['1'] = 1, ['2'] = 1, ['3'] = 1, ['4'] = 1, ['5'] = 1, ['6'] = 1, ['7'] = 1, ['8'] = 1, ['9'] = 1,
+    ['A'] = 1, ['B'] = 1, ['C'] = 1, ['D'] = 1, ['E'] = 1, ['F'] = 1, ['G'] = 1, ['H'] = 1, ['I'] = 1, ['J'] = 1,
+    ['K'] = 1, ['L'] = 1, ['M'] = 1, ['N'] = 1, ['O'] = 1, ['P'] = 1, ['Q'] = 1, ['R'] = 1, ['S'] = 1, ['T'] = 1,
+    ['U'] = 1, ['V'] = 1, ['W'] = 1, ['X'] = 1, ['Y'] = 1, ['Z'] = 1,
+    ['a'] = 1, ['b'] = 1, ['c'] = 1, ['d'] = 1, ['e'] = 1, ['f'] = 1, ['g'] = 1, ['h'] = 1, ['i'] = 1, ['j'] = 1,
+    ['k'] = 1, ['l'] = 1, ['m'] = 1, ['n'] = 1, ['o'] = 1, ['p'] = 1, ['q'] = 1, ['r'] = 1, ['s'] = 1, ['t'] = 1,
+    ['u'] = 1, ['v'] = 1, ['w'] = 1, ['x'] = 1, ['y'] = 1, ['z'] = 1,
+};
+
+static inline int http_lower(unsigned char c)
+{
+    return (c >= 'A' && c <= 'Z') ? c | 0x20 : c;
+}
+
+static inline struct http_slice http_slice_make(size_t from, size_t to)
+{
+    struct http_slice slice = {(uint32_t)from, (uint32_t)(to - from)};
+    return slice;
+}
+
+void http_parser_init(struct http_parser* parser)
+{
+    parser->state = S_START;
+    parser->pos = 0;
+    parser->mark = 0;
+    parser->valueEnd = 0;
+    parser->name = http_slice_make(0, 0);
+    parser->error = 0;
+    struct http_request* request = &parser->request;
+    memset(request, 0, offsetof(struct http_request, headers));
+    request->nheader = 0;
+    memset(request->known, -1, sizeof(request->known));
+    request->contentLength = 0;
+    request->keepAlive = 0;
+    request->headerSize = 0;
+    request->body = http_slice_make(0, 0);
+}
+
+int http_header_lookup(const char* name, size_t len)
+{
+    if (len == 0) return HTTP_HDR_UNKNOWN;
+    int id = HTTP_HEADER_HASH_TABLE[HTTP_HDR_HASH(len, http_lower(name[0]), http_lower(name[len - 1]))];
+    /* a hit only tells which well-known name it could be */
+    if (id != HTTP_HDR_UNKNOWN && strlen(HTTP_HEADER_NAMES[id]) == len && strncasecmp(HTTP_HEADER_NAMES[id], name, len) == 0)
+        return id;
+    return HTTP_HDR_UNKNOWN;
+}
+
+static int http_method_lookup(const char* name, size_t len)
+{
+    for (int i = HTTP_METHOD_GET; i <= HTTP_METHOD_TRACE; i++) {
+        if (strlen(HTTP_METHOD_NAMES[i]) == len && memcmp(HTTP_METHOD_NAMES[i], name, len) == 0)
+            return i;
+    }
+    return HTTP_METHOD_UNKNOWN;
+}
+
+const char* http_method_name(int method)
+{
+    if (method < HTTP_METHOD_UNKNOWN || method > HTTP_METHOD_TRACE) return "";
+    return HTTP_METHOD_NAMES[method];
+}
+
+const char* http_header_name(int id)
+{
+    if (id < 0 || id >= HTTP_HDR_COUNT) return "";
+    return HTTP_HEADER_NAMES[id];
+}
+
+int http_slice_equal(struct buffer* buff, struct http_slice slice, const char* str, size_t len)
+{
+    return slice.len == len && strncasecmp(http_slice_ptr(buff, slice), str, len) == 0;
+}
+
+const struct http_header* http_request_header(const struct http_request* request, int id)
+{
+    if (id <= HTTP_HDR_UNKNOWN || id >= HTTP_HDR_COUNT || request->known[id] < 0) return NULL;
+    return &request->headers[(int)request->known[id]];
+}
+
+/* whether comma-separated list in value holds token, ignoring case */
+static int http_list_has_token(const char* value, size_t len, const char* token)
+{
+    size_t tlen = strlen(token);
+    size_t i = 0;
+    while (i < len) {
+        while (i < len && (value[i] == ' ' || value[i] == '\t' || value[i] == ',')) i++;
+        size_t start = i;
+        while (i < len && value[i] != ',') i++;
+        size_t end = i;
+        while (end > start && (value[end - 1] == ' ' || value[end - 1] == '\t')) end--;
+        if (end - start == tlen && strncasecmp(value + start, token, tlen) == 0) return 1;
+    }
+    return 0;
+}
+
+/* record a header, return -1 with parser->error set if request is to be rejected */
+static int http_parser_add_header(struct http_parser* parser, const char* data, struct http_slice name, struct http_slice value)
+{
+    struct http_request* request = &parser->request;
+    if (request->nheader == HTTP_MAX_HEADERS) {
+        parser->error = 431;
+        return -1;
+    }
+    int id = http_header_lookup(data + name.off, name.len);
+    struct http_header* header = &request->headers[request->nheader];
+    header->id = id;
+    header->name = name;
+    header->value = value;
+
+    if (id == HTTP_HDR_CONTENT_LENGTH) {
+        uint64_t length = 0;
+        if (value.len == 0) goto bad_request;
+        for (uint32_t i = 0; i < value.len; i++) {
+            char c = data[value.off + i];
+            if (c < '0' || c > '9') goto bad_request;
+            length = length * 10 + (c - '0');
+            if (length > HTTP_MAX_BODY_SIZE) {
+                parser->error = 413;
+                return -1;
+            }
+        }
+        /* repeated Content-Length must agree, otherwise framing is ambiguous */
+        if (request->known[id] >= 0 && length != request->contentLength) goto bad_request;
+        request->contentLength = length;
+    }
+    if (request->known[id] < 0) request->known[id] = request->nheader;
+    request->nheader++;
+    return 0;
+
+bad_request:
+    parser->error = 400;
+    return -1;
+}
+
+/* request line and headers are complete, settle framing and persistence */
+static int http_parser_headers_done(struct http_parser* parser, const char* data)
+{
+    struct http_request* request = &parser->request;
+    if (request->known[HTTP_HDR_TRANSFER_ENCODING] >= 0) {
+        parser->error = 501;
+        return -1;
+    }
+    request->keepAlive = request->versionMinor >= 1;
+    const struct http_header* connection = http_request_header(request, HTTP_HDR_CONNECTION);
+    if (connection != NULL) {
+        const char* value = data + connection->value.off;
+        if (http_list_has_token(value, connection->value.len, "close"))
+            request->keepAlive = 0;
+        else if (http_list_has_token(value, connection->value.len, "keep-alive"))
+            request->keepAlive = 1;
+    }
+    return 0;
+}
+
+int http_parser_execute(struct http_parser* parser, struct buffer* buff)
+{
+    assert(buff->mode == BUFFER_MODE_FLAT);
+    struct http_request* request = &parser->request;
+    if (parser->state == S_DONE) return HTTP_PARSE_DONE;
+    if (buff->data == NULL) return HTTP_PARSE_AGAIN;
+
+    const char* data = buff->data + buff->readIdx;
+    size_t n = buffer_readable_size(buff);
+    size_t i = parser->pos;
+
+    for (; i < n && parser->state != S_BODY; i++) {
+        unsigned char c = data[i];
+        switch (parser->state) {
+            case S_START:
+                /* empty lines before request line are ignored, RFC 7230 3.5 */
+                if (c == '\r' || c == '\n') break;
+                parser->mark = i;
+                parser->state = S_METHOD;
+                /* fall through */
+            case S_METHOD:
+                if (c == ' ') {
+                    request->methodName = http_slice_make(parser->mark, i);
+                    request->method = http_method_lookup(data + parser->mark, i - parser->mark);
+                    parser->state = S_URI_START;
+                } else if (!HTTP_TOKEN_CHARS[c]) {
+                    goto bad_request;
+                }
+                break;
+            case S_URI_START:
+                if (c == ' ' || c < 0x21 || c == 0x7f) goto bad_request;
+                parser->mark = i;
+                parser->state = S_URI;
+                break;
+            case S_URI:
+                if (c == ' ') {
+                    request->uri = http_slice_make(parser->mark, i);
+                    const char* q = memchr(data + parser->mark, '?', i - parser->mark);
+                    if (q != NULL) {
+                        request->path = http_slice_make(parser->mark, q - data);
+                        request->query = http_slice_make(q - data + 1, i);
+                    } else {
+                        request->path = request->uri;
+                        request->query = http_slice_make(i, i);
+                    }
+                    parser->mark = i + 1;
+                    parser->state = S_VERSION;
+                } else if (c < 0x21 || c == 0x7f) {
+                    goto bad_request;
+                }
+                break;
+            case S_VERSION:
+                if (c == '\r' || c == '\n') {
+                    const char* version = data + parser->mark;
+                    if (i - parser->mark != 8 || memcmp(version, "HTTP/", 5) != 0 || version[6] != '.'
+                        || version[5] < '0' || version[5] > '9' || version[7] < '0' || version[7] > '9')
+                        goto bad_request;
+                    if (version[5] != '1') {
+                        parser->error = 505;
+                        goto failed;
+                    }
+                    request->versionMinor = version[7] - '0';
+                    parser->state = c == '\r' ? S_REQUEST_LINE_LF : S_HEADER_START;
+                }
+                break;
+            case S_REQUEST_LINE_LF:
+            case S_HEADER_LF:
+                if (c != '\n') goto bad_request;
+                parser->state = S_HEADER_START;
+                break;
+            case S_HEADER_START:
+                if (c == '\r') {
+                    parser->state = S_HEADERS_END_LF;
+                    break;
+                }
+                if (c == '\n') goto headers_done;
+                /* obsolete line folding is not accepted */
+                if (!HTTP_TOKEN_CHARS[c]) goto bad_request;
+                parser->mark = i;
+                parser->state = S_HEADER_NAME;
+                break;
+            case S_HEADER_NAME:
+                if (c == ':') {
+                    parser->name = http_slice_make(parser->mark, i);
+                    parser->state = S_VALUE_START;
+                } else if (!HTTP_TOKEN_CHARS[c]) {
+                    goto bad_request;
+                }
+                break;
+            case S_VALUE_START:
+                if (c == ' ' || c == '\t') break;
+                parser->mark = i;
+                parser->valueEnd = i;
+                parser->state = S_VALUE;
+                /* fall through */
+            case S_VALUE:
+                if (c == '\r' || c == '\n') {
+                    if (http_parser_add_header(parser, data, parser->name, http_slice_make(parser->mark, parser->valueEnd)) < 0)
+                        goto failed;
+                    parser->state = c == '\r' ? S_HEADER_LF : S_HEADER_START;
+                } else if (c != ' ' && c != '\t') {
+                    if ((c < 0x20 && c != '\t') || c == 0x7f) goto bad_request;
+                    parser->valueEnd = i + 1;
+                }
+                break;
+            case S_HEADERS_END_LF:
+                if (c != '\n') goto bad_request;
+            headers_done:
+                request->headerSize = i + 1;
+                if (http_parser_headers_done(parser, data) < 0) goto failed;
+                parser->state = S_BODY;
+                break;
+        }
+    }
+    parser->pos = i;
+
+    if (parser->state != S_BODY) {
+        /* request line and headers must fit in HTTP_MAX_HEADER_SIZE */
+        if (n >= HTTP_MAX_HEADER_SIZE) {
+            parser->error = parser->state <= S_URI ? 414 : 431;
+            goto failed;
+        }
+        return HTTP_PARSE_AGAIN;
+    }
+    if (n - request->headerSize < request->contentLength) return HTTP_PARSE_AGAIN;
+    request->body = http_slice_make(request->headerSize, request->headerSize + request->contentLength);
+    parser->state = S_DONE;
+    return HTTP_PARSE_DONE;
+
+bad_request:
+    parser->error = 400;
+failed:
+    parser->pos = i;
+    return HTTP_PARSE_ERROR;
+}
+
+void http_parser_consume(struct http_parser* parser, struct buffer* buff)
+{
+    struct http_request* request = &parser->request;
+    if (parser->state == S_DONE)
+        buffer_drain(buff, request->headerSize + request->contentLength);
+    http_parser_init(parser);
+}
@@ -0,0 +1,134 @@
+#ifndef HTTP_PARSER_H
+#define HTTP_PARSER_H
+#include "buffer.h"
+#include <stdint.h>
+
+#define HTTP_MAX_HEADERS 32
+#define HTTP_MAX_HEADER_SIZE (8 << 10)   // request line and headers, larger requests are rejected with 431
+#define HTTP_MAX_BODY_SIZE (16 << 20)    // Content-Length above it is rejected with 413
+
+/* parse result */
+#define HTTP_PARSE_AGAIN 0  // request incomplete, parse again after more bytes are read
+#define HTTP_PARSE_DONE 1   // request line, headers and body are all in buffer
+#define HTTP_PARSE_ERROR -1 // malformed request, parser->error holds the status code to answer with
+
+/* methods */
+#define HTTP_METHOD_UNKNOWN 0
+#define HTTP_METHOD_GET 1
+#define HTTP_METHOD_HEAD 2
+#define HTTP_METHOD_POST 3
+#define HTTP_METHOD_PUT 4
+#define HTTP_METHOD_DELETE 5
+#define HTTP_METHOD_OPTIONS 6
+#define HTTP_METHOD_PATCH 7
+#define HTTP_METHOD_CONNECT 8
+#define HTTP_METHOD_TRACE 9
+
+/* well-known headers, interned by http_header_lookup(), HTTP_HDR_UNKNOWN for others */
+#define HTTP_HDR_UNKNOWN 0
+#define HTTP_HDR_HOST 1
+#define HTTP_HDR_CONNECTION 2
+#define HTTP_HDR_CONTENT_LENGTH 3
+#define HTTP_HDR_CONTENT_TYPE 4
+#define HTTP_HDR_TRANSFER_ENCODING 5
+#define HTTP_HDR_USER_AGENT 6
+#define HTTP_HDR_ACCEPT 7
+#define HTTP_HDR_ACCEPT_ENCODING 8
+#define HTTP_HDR_ACCEPT_LANGUAGE 9
+#define HTTP_HDR_IF_NONE_MATCH 10
+#define HTTP_HDR_IF_MODIFIED_SINCE 11
+#define HTTP_HDR_IF_RANGE 12
+#define HTTP_HDR_RANGE 13
+#define HTTP_HDR_EXPECT 14
+#define HTTP_HDR_COOKIE 15
+#define HTTP_HDR_AUTHORIZATION 16
+#define HTTP_HDR_REFERER 17
+#define HTTP_HDR_CACHE_CONTROL 18
+#define HTTP_HDR_UPGRADE 19
+#define HTTP_HDR_ORIGIN 20
+#define HTTP_HDR_KEEP_ALIVE 21
+#define HTTP_HDR_TE 22
+#define HTTP_HDR_COUNT 23
+
+/**
+ * bytes [off, off + len) of a request, off counts from the first byte of the request in its buffer
+ * slices stay valid while the request is in buffer: growing a flat buffer moves bytes but keeps their distance to readIdx
+ */
+struct http_slice {
+    uint32_t off;
+    uint32_t len;
+};
+
+struct http_header {
+    int id;                     // HTTP_HDR_*
+    struct http_slice name;
+    struct http_slice value;    // surrounding whitespace excluded
+};
+
+/* request parsed in place, no byte of it is copied */
+struct http_request {
+    int method;                 // HTTP_METHOD_*
+    int versionMinor;           // HTTP/1.x
+    struct http_slice methodName;
+    struct http_slice uri;      // request-target as sent
+    struct http_slice path;     // uri up to '?'
+    struct http_slice query;    // after '?', empty if none
+    struct http_header headers[HTTP_MAX_HEADERS];
+    int nheader;
+    int8_t known[HTTP_HDR_COUNT]; // index of first header with that id, -1 if absent
+    uint64_t contentLength;
+    int keepAlive;              // from version and Connection header
+    size_t headerSize;          // bytes of request line and headers, body starts here
+    struct http_slice body;
+};
+
+/**
+ * resumable HTTP/1.1 request parser on a flat buffer, one per connection
+ * - bytes are scanned once: pos remembers how far the current request has been parsed, a partial read resumes there;
+ * - request line, headers and body are slices into the buffer instead of copies;
+ * - well-known header names are interned through a perfect hash, so handlers look them up by id;
+ * - once a request is handled, http_parser_consume() drains it and the next pipelined request is parsed from the same buffer.
+ * request bodies with Transfer-Encoding are not supported and answered with 501.
+ */
+struct http_parser {
+    int state;
+    size_t pos;     // bytes of current request scanned
+    size_t mark;    // start of the token being scanned
+    size_t valueEnd;// end of header value without trailing whitespace
+    struct http_slice name; // name of the header whose value is being scanned
+    int error;      // HTTP status code when HTTP_PARSE_ERROR is returned
+    struct http_request request;
+};
+
+/* reset parser for a new request */
+void http_parser_init(struct http_parser* parser);
+
+/**
+ * parse readable bytes of buff from where last call stopped, buff must be in flat mode
+ * return HTTP_PARSE_DONE, HTTP_PARSE_AGAIN or HTTP_PARSE_ERROR
+ */
+int http_parser_execute(struct http_parser* parser, struct buffer* buff);
+
+/* drain the completed request from buff and reset parser for the next one */
+void http_parser_consume(struct http_parser* parser, struct buffer* buff);
+
+/* address of slice in buff, valid until buff is appended to or drained */
+static inline const char* http_slice_ptr(struct buffer* buff, struct http_slice slice)
+{
+    return buff->data + buff->readIdx + slice.off;
+}
+
+/* whether slice equals the len bytes of str, ignoring case */
+int http_slice_equal(struct buffer* buff, struct http_slice slice, const char* str, size_t len);
+
+/* header id of name, HTTP_HDR_UNKNOWN if it's not a well-known one, case-insensitive */
+int http_header_lookup(const char* name, size_t len);
+
+/* first header of request with id, NULL if absent */
+const struct http_header* http_request_header(const struct http_request* request, int id);
+
+/* method name of HTTP_METHOD_*, canonical header name of HTTP_HDR_* */
+const char* http_method_name(int method);
+const char* http_header_name(int id);
+
+#endif
@@ -0,0 +1,618 @@
+#include "http/http_server.h"
+
+/* idle keep-alive connections of the reactor running in this thread */
+static __thread int http_idle_conns = 0;
+
+/* response cache shard of the reactor running in this thread */
+static __thread struct http_cache_shard* http_cache_self = NULL;
+
+/* status line and headers of a response, assembled on stack and handed to connection in as few pieces as possible */
+struct http_output {
+    struct tcp_connection* tcpConn; // NULL to assemble in data only, overflow is set when it doesn't fit
+    int overflow;
+    size_t len;
+    char data[HTTP_RESPONSE_HEAD_SIZE];
+};
+
+static int http_on_connected(struct tcp_connection* tcpConn);
+static int http_on_message(struct tcp_connection* tcpConn);
+static int http_on_written(struct tcp_connection* tcpConn);
+static int http_on_closed(struct tcp_connection* tcpConn);
+static void http_connection_process(struct http_connection* httpConn);
+static void http_connection_handle(struct http_connection* httpConn);
+static void http_connection_finish(struct http_connection* httpConn);
+static void http_connection_set_idle(struct http_connection* httpConn, int idle);
+static void http_connection_produce(struct http_connection* httpConn);
+static void http_connection_pump(struct http_connection* httpConn);
+static void http_connection_stream_wait(struct http_connection* httpConn);
+static void http_connection_end_stream(struct http_connection* httpConn);
+static void http_connection_respond(struct http_connection* httpConn, const struct http_response* response, int withBody);
+static void http_connection_respond_cached(struct http_connection* httpConn, struct http_cache_entry* entry, int keepAlive, int withBody);
+static struct http_cache_entry* http_connection_cache(struct http_connection* httpConn, const struct http_response* response);
+static void http_response_init(struct http_response* response, int status, int keepAlive);
+static void http_response_release(struct http_response* response);
+
+struct http_server* http_server_new(const char* name, int port, int threadNum, http_request_handler handler, void* data)
+{
+    assert(handler != NULL);
+    struct http_server* httpServer = malloc(sizeof(struct http_server));
+    if (httpServer == NULL) goto failed;
+    httpServer->handler = handler;
+    httpServer->keepAliveTimeout = HTTP_KEEPALIVE_TIMEOUT;
+    httpServer->keepAliveRequests = HTTP_KEEPALIVE_REQUESTS;
+    httpServer->maxIdle = HTTP_KEEPALIVE_MAX_IDLE;
+    httpServer->cacheBytes = 0;
+    httpServer->data = data;
+
+    httpServer->server = server_new(name, TCP_SERVER, port, threadNum,
+            http_on_connected, http_on_message, http_on_written, http_on_closed, httpServer);
+    if (httpServer->server == NULL) goto failed;
+    server_set_idle_timeout(httpServer->server, httpServer->keepAliveTimeout);
+    return httpServer;
+
+failed:
+    LOG(LT_ERROR, "failed to create http server");
+    if (httpServer != NULL) free(httpServer);
+    return NULL;
+}
+
+void http_server_set_keepalive(struct http_server* httpServer, uint64_t timeout, int maxRequests, int maxIdle)
+{
+    if (timeout > 0) {
+        httpServer->keepAliveTimeout = timeout;
+        server_set_idle_timeout(httpServer->server, timeout);
+    }
+    if (maxRequests > 0) httpServer->keepAliveRequests = maxRequests;
+    if (maxIdle > 0) httpServer->maxIdle = maxIdle;
+}
+
+void http_server_enable_cache(struct http_server* httpServer, size_t maxBytes)
+{
+    httpServer->cacheBytes = maxBytes > 0 ? maxBytes : HTTP_CACHE_BYTES;
+}
+
+void http_server_run(struct http_server* httpServer)
+{
+    server_run(httpServer->server);
+}
+
+/* runs before connection is registered in its reactor, possibly in main-reactor thread */
+static int http_on_connected(struct tcp_connection* tcpConn)
+{
+    struct http_connection* httpConn = malloc(sizeof(struct http_connection));
+    if (httpConn == NULL) {
+        LOG(LT_WARN, "failed to allocate http connection(fd = %d)", tcpConn->channel->fd);
+        return -1;
+    }
+    httpConn->tcpConn = tcpConn;
+    httpConn->httpServer = tcpConn->data;
+    httpConn->nrequest = 0;
+    httpConn->idle = 0;
+    httpConn->stalled = 0;
+    httpConn->closing = 0;
+    httpConn->shutdown = 0;
+    httpConn->stream.producer = NULL;
+    http_parser_init(&httpConn->parser);
+    tcpConn->request = httpConn;
+    return 0;
+}
+
+static int http_on_message(struct tcp_connection* tcpConn)
+{
+    struct http_connection* httpConn = tcpConn->request;
+    if (httpConn == NULL) {
+        handle_tcp_connection_closed(tcpConn);
+        return -1;
+    }
+    http_connection_set_idle(httpConn, 0);
+    http_connection_process(httpConn);
+    return 0;
+}
+
+static int http_on_written(struct tcp_connection* tcpConn)
+{
+    struct http_connection* httpConn = tcpConn->request;
+    if (httpConn == NULL) return 0;
+
+    /* peer is still taking bytes, a long response must not be cut by idle timeout */
+    if (tcpConn->idleTimeout > 0)
+        tcp_connection_set_idle_timeout(tcpConn, tcpConn->idleTimeout);
+
+    /* output drained below low water, or socket took everything: time for next chunks, requests behind wait for the end */
+    if (httpConn->stream.producer != NULL) {
+        http_connection_pump(httpConn);
+        if (httpConn->stream.producer != NULL) return 0;
+        /* stream is over and nothing is pipelined behind it, connection waits for next request as after any response */
+        if (!httpConn->closing && buffer_readable_size(tcpConn->inBuffer) == 0)
+            http_connection_set_idle(httpConn, 1);
+    }
+
+    if (httpConn->closing) {
+        http_connection_finish(httpConn);
+    } else if (httpConn->stalled && buffer_readable_size(tcpConn->outBuffer) < HTTP_OUTPUT_HIGH_WATER) {
+        httpConn->stalled = 0;
+        http_connection_process(httpConn);
+    }
+    return 0;
+}
+
+static int http_on_closed(struct tcp_connection* tcpConn)
+{
+    struct http_connection* httpConn = tcpConn->request;
+    if (httpConn == NULL) return 0;
+    http_connection_set_idle(httpConn, 0);
+    if (httpConn->stream.producer != NULL)
+        http_connection_end_stream(httpConn);
+    free(httpConn);
+    tcpConn->request = NULL;
+    return 0;
+}
+
+/**
+ * answer every complete request in inBuffer, stop at a partial one, which is resumed on next read
+ * connection is corked meanwhile, so that all responses of this round leave together
+ */
+static void http_connection_process(struct http_connection* httpConn)
+{
+    struct tcp_connection* tcpConn = httpConn->tcpConn;
+    struct buffer* inBuffer = tcpConn->inBuffer;
+    struct http_parser* parser = &httpConn->parser;
+
+    if (httpConn->closing) {
+        buffer_drain(inBuffer, buffer_readable_size(inBuffer));
+        return;
+    }
+    /* pipelined requests are answered after the stream, see http_on_written() */
+    if (httpConn->stream.producer != NULL) return;
+
+    tcp_connection_cork(tcpConn);
+    while (buffer_readable_size(inBuffer) > 0) {
+        /* peer pipelines faster than it reads responses, resume once output drained */
+        if (buffer_readable_size(tcpConn->outBuffer) >= HTTP_OUTPUT_HIGH_WATER) {
+            httpConn->stalled = 1;
+            break;
+        }
+        int ret = http_parser_execute(parser, inBuffer);
+        if (ret == HTTP_PARSE_AGAIN) break;
+        if (ret == HTTP_PARSE_ERROR) {
+            struct http_response response;
+            LOG(LT_DEBUG, "bad request on connection(fd = %d), answering %d", tcpConn->channel->fd, parser->error);
+            http_response_init(&response, parser->error, 0);
+            http_connection_respond(httpConn, &response, 1);
+            httpConn->closing = 1;
+            break;
+        }
+        http_connection_handle(httpConn);
+        http_parser_consume(parser, inBuffer);
+        if (httpConn->closing) break;
+        if (httpConn->stream.producer != NULL) {
+            httpConn->stalled = 1;
+            break;
+        }
+    }
+    tcp_connection_uncork(tcpConn);
+    http_connection_stream_wait(httpConn);
+
+    if (httpConn->closing) {
+        buffer_drain(inBuffer, buffer_readable_size(inBuffer));
+        tcp_connection_set_idle_timeout(tcpConn, HTTP_LINGER_TIMEOUT);
+        http_connection_finish(httpConn);
+    } else if (buffer_readable_size(inBuffer) == 0 && httpConn->stream.producer == NULL) {
+        http_connection_set_idle(httpConn, 1);
+    }
+}
+
+/* run handler on the request just parsed and queue its response */
+static void http_connection_handle(struct http_connection* httpConn)
+{
+    struct http_server* httpServer = httpConn->httpServer;
+    struct buffer* inBuffer = httpConn->tcpConn->inBuffer;
+    const struct http_request* request = &httpConn->parser.request;
+    struct http_response response;
+
+    /* keep-alive limits: connection has answered enough, or it would go idle while reactor already holds enough idle ones */
+    httpConn->nrequest++;
+    int keepAlive = request->keepAlive && httpConn->nrequest < httpServer->keepAliveRequests;
+    int pipelined = buffer_readable_size(inBuffer) > request->headerSize + request->contentLength;
+    if (keepAlive && !pipelined && http_idle_conns >= httpServer->maxIdle)
+        keepAlive = 0;
+
+    /* HEAD is answered from the entry of GET, without its body */
+    int cacheable = httpServer->cacheBytes > 0 && (request->method == HTTP_METHOD_GET || request->method == HTTP_METHOD_HEAD);
+    if (cacheable) {
+        if (http_cache_self == NULL)
+            http_cache_self = http_cache_shard_new(httpServer->cacheBytes);
+        struct http_cache_entry* entry = http_cache_self == NULL ? NULL :
+            http_cache_lookup(http_cache_self, inBuffer, request, event_loop_now_ms(httpConn->tcpConn->eventLoop));
+        if (entry != NULL) {
+            http_connection_respond_cached(httpConn, entry, keepAlive, request->method == HTTP_METHOD_GET);
+            if (!keepAlive)
+                httpConn->closing = 1;
+            return;
+        }
+    }
+
+    http_response_init(&response, 200, keepAlive);
+    if (httpServer->handler(httpConn, request, &response) < 0) {
+        http_response_release(&response);
+        http_response_init(&response, 500, 0);
+    }
+    /* HTTP/1.0 peer doesn't know chunked encoding, its streamed body ends when connection is closed */
+    if (response.producer != NULL) {
+        response.chunked = request->versionMinor >= 1;
+        if (!response.chunked)
+            response.keepAlive = 0;
+    }
+
+    struct http_cache_entry* entry = NULL;
+    if (cacheable && request->method == HTTP_METHOD_GET && response.cacheTtl > 0 && response.fileFd < 0 &&
+        response.producer == NULL && http_cache_self != NULL)
+        entry = http_connection_cache(httpConn, &response);
+    if (entry != NULL)
+        http_connection_respond_cached(httpConn, entry, response.keepAlive, 1);
+    else
+        http_connection_respond(httpConn, &response, request->method != HTTP_METHOD_HEAD);
+    if (!response.keepAlive)
+        httpConn->closing = 1;
+}
+
+/* last response sent, close write end and let peer close, so that it reads every byte before the connection goes away */
+static void http_connection_finish(struct http_connection* httpConn)
+{
+    struct tcp_connection* tcpConn = httpConn->tcpConn;
+    if (httpConn->shutdown || httpConn->stream.producer != NULL || buffer_readable_size(tcpConn->outBuffer) > 0) return;
+    httpConn->shutdown = 1;
+    tcp_connection_shutdown(tcpConn);
+}
+
+static void http_connection_set_idle(struct http_connection* httpConn, int idle)
+{
+    if (httpConn->idle == idle) return;
+    httpConn->idle = idle;
+    http_idle_conns += idle ? 1 : -1;
+}
+
+/**
+ * call producer until output reaches HTTP_STREAM_LOW_WATER, the stream ends or producer pauses
+ * connection is corked, so chunks are only queued and leave together
+ */
+static void http_connection_produce(struct http_connection* httpConn)
+{
+    struct tcp_connection* tcpConn = httpConn->tcpConn;
+    struct http_stream* stream = &httpConn->stream;
+
+    while (stream->producer != NULL && !stream->paused && !tcpConn->closed &&
+           buffer_readable_size(tcpConn->outBuffer) < HTTP_STREAM_LOW_WATER) {
+        size_t queued = buffer_readable_size(tcpConn->outBuffer);
+        int ret = stream->producer(httpConn, stream->arg);
+        if (ret == HTTP_STREAM_DONE) {
+            if (stream->chunked)
+                tcp_connection_send(tcpConn, "0\r\n\r\n", 5);
+            http_connection_end_stream(httpConn);
+        } else if (ret < 0) {
+            /* body can't be completed, closing without last chunk tells peer it's truncated */
+            LOG(LT_DEBUG, "stream aborted on connection(fd = %d)", tcpConn->channel->fd);
+            http_connection_end_stream(httpConn);
+            httpConn->closing = 1;
+        } else if (!tcpConn->closed && buffer_readable_size(tcpConn->outBuffer) == queued) {
+            stream->paused = 1;
+        }
+    }
+}
+
+/* produce the next chunks of stream and write them at once */
+static void http_connection_pump(struct http_connection* httpConn)
+{
+    tcp_connection_cork(httpConn->tcpConn);
+    http_connection_produce(httpConn);
+    tcp_connection_uncork(httpConn->tcpConn);
+    http_connection_stream_wait(httpConn);
+}
+
+/**
+ * socket took every byte queued, so no write event is coming: go on producing in next loop round,
+ * after the other connections of reactor had their turn
+ */
+static void http_connection_stream_wait(struct http_connection* httpConn)
+{
+    struct tcp_connection* tcpConn = httpConn->tcpConn;
+    if (httpConn->stream.producer == NULL || httpConn->stream.paused || tcpConn->closed) return;
+    if (buffer_readable_size(tcpConn->outBuffer) == 0)
+        tcp_connection_want_writable(tcpConn);
+}
+
+static void http_connection_end_stream(struct http_connection* httpConn)
+{
+    struct http_stream* stream = &httpConn->stream;
+    stream->producer = NULL;
+    if (stream->release != NULL)
+        stream->release(stream->arg);
+}
+
+int http_connection_write_chunk(struct http_connection* httpConn, const void* data, size_t len)
+{
+    struct tcp_connection* tcpConn = httpConn->tcpConn;
+    char line[24];
+
+    if (tcpConn->closed) return -1;
+    /* an empty chunk would end the body */
+    if (len == 0) return 0;
+    if (httpConn->stream.chunked) {
+        int n = snprintf(line, sizeof(line), "%zx\r\n", len);
+        tcp_connection_send(tcpConn, line, n);
+    }
+    tcp_connection_send(tcpConn, (void*)data, len);
+    if (httpConn->stream.chunked)
+        tcp_connection_send(tcpConn, "\r\n", 2);
+    return 0;
+}
+
+void http_connection_resume_stream(struct tcp_connection* tcpConn)
+{
+    struct http_connection* httpConn = tcpConn->request;
+    if (tcpConn->closed || httpConn == NULL || httpConn->stream.producer == NULL || !httpConn->stream.paused) return;
+    httpConn->stream.paused = 0;
+    http_connection_pump(httpConn);
+    if (httpConn->stream.producer == NULL)
+        http_on_written(tcpConn);
+}
+
+static inline int http_status_has_body(int status)
+{
+    return status >= 200 && status != 204 && status != 304;
+}
+
+static void http_output_append(struct http_output* output, const void* data, size_t len)
+{
+    if (output->len + len > sizeof(output->data)) {
+        if (output->tcpConn == NULL) {
+            output->overflow = 1;
+            return;
+        }
+        tcp_connection_send(output->tcpConn, output->data, output->len);
+        output->len = 0;
+        /* too large to be assembled, queued as it is */
+        if (len > sizeof(output->data)) {
+            tcp_connection_send(output->tcpConn, (void*)data, len);
+            return;
+        }
+    }
+    memcpy(output->data + output->len, data, len);
+    output->len += len;
+}
+
+static void http_output_append_string(struct http_output* output, const char* str)
+{
+    http_output_append(output, str, strlen(str));
+}
+
+/* status line and headers that are the same whoever is answered, every line ends with CRLF */
+static void http_output_head(struct http_output* output, const struct http_response* response)
+{
+    char line[64];
+    int n;
+
+    n = snprintf(line, sizeof(line), "HTTP/1.1 %d ", response->status);
+    http_output_append(output, line, n);
+    http_output_append_string(output, http_status_reason(response->status));
+    http_output_append(output, "\r\nServer: gchttp\r\n", 18);
+    if (response->contentType != NULL) {
+        http_output_append(output, "Content-Type: ", 14);
+        http_output_append_string(output, response->contentType);
+        http_output_append(output, "\r\n", 2);
+    }
+    /* 1xx, 204 and 304 responses carry no body and no length, a streamed one has no length either */
+    if (http_status_has_body(response->status)) {
+        if (response->producer == NULL) {
+            n = snprintf(line, sizeof(line), "Content-Length: %zu\r\n", response->fileFd >= 0 ? response->fileLen : response->bodyLen);
+            http_output_append(output, line, n);
+        } else if (response->chunked) {
+            http_output_append(output, "Transfer-Encoding: chunked\r\n", 28);
+        }
+    }
+    for (int i = 0; i < response->nheader; i++) {
+        http_output_append_string(output, response->headers[i].name);
+        http_output_append(output, ": ", 2);
+        http_output_append_string(output, response->headers[i].value);
+        http_output_append(output, "\r\n", 2);
+    }
+}
+
+/* headers depending on when and on which connection response is sent, and the blank line ending them */
+static void http_output_head_end(struct http_output* output, struct event_loop* eventLoop, int keepAlive)
+{
+    http_output_append(output, "Date: ", 6);
+    http_output_append_string(output, event_loop_http_date(eventLoop));
+    if (keepAlive)
+        http_output_append(output, "\r\nConnection: keep-alive\r\n\r\n", 28);
+    else
+        http_output_append(output, "\r\nConnection: close\r\n\r\n", 23);
+}
+
+/* serialize response behind those queued before, connection is corked so nothing is written yet */
+static void http_connection_respond(struct http_connection* httpConn, const struct http_response* response, int withBody)
+{
+    struct tcp_connection* tcpConn = httpConn->tcpConn;
+    struct http_output output;
+
+    output.tcpConn = tcpConn;
+    output.overflow = 0;
+    output.len = 0;
+
+    http_output_head(&output, response);
+    http_output_head_end(&output, tcpConn->eventLoop, response->keepAlive);
+    if (withBody && response->fileFd < 0 && response->bodyLen > 0)
+        http_output_append(&output, response->body, response->bodyLen);
+    if (output.len > 0)
+        tcp_connection_send(tcpConn, output.data, output.len);
+
+    if (response->fileFd >= 0) {
+        if (withBody)
+            tcp_connection_sendfile_shared(tcpConn, response->fileFd, response->fileOffset, response->fileLen,
+                    response->fileRelease, response->fileArg);
+        else if (response->fileRelease != NULL)
+            response->fileRelease(response->fileArg);
+    }
+
+    /* first chunks are produced at once, so they leave with the head */
+    if (response->producer != NULL) {
+        struct http_stream* stream = &httpConn->stream;
+        stream->producer = response->producer;
+        stream->release = response->streamRelease;
+        stream->arg = response->streamArg;
+        stream->chunked = response->chunked;
+        stream->paused = 0;
+        if (withBody && http_status_has_body(response->status))
+            http_connection_produce(httpConn);
+        else
+            http_connection_end_stream(httpConn);
+    }
+}
+
+/* keep serialized response in cache shard of this reactor, NULL if it can't be cached */
+static struct http_cache_entry* http_connection_cache(struct http_connection* httpConn, const struct http_response* response)
+{
+    struct tcp_connection* tcpConn = httpConn->tcpConn;
+    struct http_output output;
+
+    output.tcpConn = NULL;
+    output.overflow = 0;
+    output.len = 0;
+    http_output_head(&output, response);
+    if (output.overflow) return NULL;
+    return http_cache_store(http_cache_self, tcpConn->inBuffer, &httpConn->parser.request,
+            response->varyIds, response->nvary, response->cacheTtl, event_loop_now_ms(tcpConn->eventLoop),
+            output.data, output.len, response->body, response->bodyLen);
+}
+
+/* queue cached head and body by reference, only Date and Connection lines between them are copied */
+static void http_connection_respond_cached(struct http_connection* httpConn, struct http_cache_entry* entry, int keepAlive, int withBody)
+{
+    struct tcp_connection* tcpConn = httpConn->tcpConn;
+    struct http_output output;
+
+    output.tcpConn = tcpConn;
+    output.overflow = 0;
+    output.len = 0;
+
+    http_cache_hold(entry);
+    tcp_connection_send_shared(tcpConn, entry->data, entry->headEnd, http_cache_release, entry);
+    http_output_head_end(&output, tcpConn->eventLoop, keepAlive);
+    tcp_connection_send(tcpConn, output.data, output.len);
+    if (withBody && entry->size > entry->headEnd) {
+        http_cache_hold(entry);
+        tcp_connection_send_shared(tcpConn, entry->data + entry->headEnd, entry->size - entry->headEnd, http_cache_release, entry);
+    }
+}
+
+static void http_response_init(struct http_response* response, int status, int keepAlive)
+{
+    response->status = status;
+    response->contentType = NULL;
+    response->nheader = 0;
+    response->body = NULL;
+    response->bodyLen = 0;
+    response->fileFd = -1;
+    response->fileRelease = NULL;
+    response->fileArg = NULL;
+    response->producer = NULL;
+    response->streamRelease = NULL;
+    response->streamArg = NULL;
+    response->chunked = 0;
+    response->cacheTtl = 0;
+    response->nvary = 0;
+    response->keepAlive = keepAlive;
+}
+
+/* give up file and stream of response, it's not going to be sent */
+static void http_response_release(struct http_response* response)
+{
+    if (response->fileRelease != NULL)
+        response->fileRelease(response->fileArg);
+    if (response->producer != NULL && response->streamRelease != NULL)
+        response->streamRelease(response->streamArg);
+    response->fileFd = -1;
+    response->fileRelease = NULL;
+    response->producer = NULL;
+    response->streamRelease = NULL;
+}
+
+int http_response_add_header(struct http_response* response, const char* name, const char* value)
+{
+    if (response->nheader >= HTTP_MAX_RESPONSE_HEADERS) return -1;
+    response->headers[response->nheader].name = name;
+    response->headers[response->nheader].value = value;
+    response->nheader++;
+    return 0;
+}
+
+void http_response_set_body(struct http_response* response, const void* body, size_t len)
+{
+    response->body = body;
+    response->bodyLen = len;
+}
+
+int http_response_set_cacheable(struct http_response* response, uint64_t ttl, const int* varyIds, int nvary)
+{
+    if (nvary > HTTP_CACHE_MAX_VARY) return -1;
+    for (int i = 0; i < nvary; i++) {
+        response->varyIds[i] = varyIds[i];
+        http_response_add_header(response, "Vary", http_header_name(varyIds[i]));
+    }
+    response->nvary = nvary;
+    response->cacheTtl = ttl;
+    return 0;
+}
+
+void http_response_set_file(struct http_response* response, int fd, off_t offset, size_t len,
+        buffer_release_callback release, void* arg)
+{
+    http_response_release(response);
+    response->fileFd = fd;
+    response->fileOffset = offset;
+    response->fileLen = len;
+    response->fileRelease = release;
+    response->fileArg = arg;
+    response->body = NULL;
+    response->bodyLen = 0;
+}
+
+void http_response_set_stream(struct http_response* response, http_stream_producer producer,
+        buffer_release_callback release, void* arg)
+{
+    http_response_release(response);
+    response->producer = producer;
+    response->streamRelease = release;
+    response->streamArg = arg;
+    response->body = NULL;
+    response->bodyLen = 0;
+}
+
+const char* http_status_reason(int status)
+{
+    switch (status) {
+        case 100: return "Continue";
+        case 200: return "OK";
+        case 201: return "Created";
+        case 204: return "No Content";
+        case 206: return "Partial Content";
+        case 301: return "Moved Permanently";
+        case 302: return "Found";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 408: return "Request Timeout";
+        case 412: return "Precondition Failed";
+        case 413: return "Payload Too Large";
+        case 414: return "URI Too Long";
+        case 416: return "Range Not Satisfiable";
+        case 431: return "Request Header Fields Too Large";
+        case 500: return "Internal Server Error";
+        case 501: return "Not Implemented";
+        case 503: return "Service Unavailable";
+        case 505: return "HTTP Version Not Supported";
+        default: return "Unknown";
+    }
+}
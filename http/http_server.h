@@ -0,0 +1,174 @@
+#ifndef HTTP_SERVER_H
+#define HTTP_SERVER_H
+#include "server.h"
+#include "http/http_parser.h"
+#include "http/http_cache.h"
+
+#define HTTP_KEEPALIVE_TIMEOUT 15000        // ms an idle keep-alive connection is kept open
+#define HTTP_KEEPALIVE_REQUESTS 1000        // requests answered on one connection before it's closed
+#define HTTP_KEEPALIVE_MAX_IDLE 10000       // idle keep-alive connections kept open per reactor
+#define HTTP_LINGER_TIMEOUT 5000            // ms a connection waits for peer to close after its last response
+#define HTTP_OUTPUT_HIGH_WATER (1 << 20)    // pipelined requests wait while more bytes than it are queued for peer
+#define HTTP_MAX_RESPONSE_HEADERS 16
+#define HTTP_RESPONSE_HEAD_SIZE 1024        // status line and headers are assembled on stack in pieces of this size
+#define HTTP_STREAM_LOW_WATER (64 << 10)    // producer of a streamed body is called while fewer bytes than it are queued
+#define HTTP_STREAM_MORE 1                  // producer returns it to be called again, HTTP_STREAM_DONE after last chunk
+#define HTTP_STREAM_DONE 0
+
+struct http_server;
+struct http_connection;
+
+struct http_response_header {
+    const char* name;
+    const char* value;
+};
+
+/**
+ * produce the next piece of a streamed body by http_connection_write_chunk(), return HTTP_STREAM_MORE,
+ * HTTP_STREAM_DONE once the body is complete, or -1 to abort, which closes connection without ending the body
+ * request is gone by then, everything producer needs lives in arg.
+ * returning HTTP_STREAM_MORE without writing anything pauses the stream until http_connection_resume_stream()
+ */
+typedef int (*http_stream_producer)(struct http_connection* httpConn, void* arg);
+
+/* response filled by handler, serialized into output buffer of connection as soon as handler returns */
+struct http_response {
+    int status;
+    const char* contentType;    // NULL for none
+    struct http_response_header headers[HTTP_MAX_RESPONSE_HEADERS];
+    int nheader;
+    const void* body;           // copied when serialized, so it may point into request or handler stack
+    size_t bodyLen;
+    int fileFd;                 // body sent from file region by sendfile() instead, -1 for none
+    off_t fileOffset;
+    size_t fileLen;
+    buffer_release_callback fileRelease; // called once fd is no longer needed, see tcp_connection_sendfile_shared()
+    void* fileArg;
+    http_stream_producer producer; // body produced piece by piece after head is sent, NULL for none
+    buffer_release_callback streamRelease; // called once stream ends or connection is closed
+    void* streamArg;
+    int chunked;                // set by server: stream is sent with chunked encoding, else delimited by close (HTTP/1.0)
+    uint64_t cacheTtl;          // ms answer to a GET may be served from cache, 0 for not cacheable
+    int varyIds[HTTP_CACHE_MAX_VARY]; // request headers the cached answer depends on, HTTP_HDR_*
+    int nvary;
+    int keepAlive;              // preset from request and keep-alive limits, handler clears it to close after response
+};
+
+/**
+ * called once per request in arrival order, request slices point into http_connection_input()
+ * return -1 to answer with 500 and close connection
+ */
+typedef int (*http_request_handler)(struct http_connection* httpConn, const struct http_request* request, struct http_response* response);
+
+/* streamed body being produced on a connection */
+struct http_stream {
+    http_stream_producer producer;  // NULL while no stream is active
+    buffer_release_callback release;
+    void* arg;
+    int chunked;
+    int paused;     // producer had nothing to write, waits for http_connection_resume_stream()
+};
+
+/* state of one HTTP/1.1 connection, kept in tcpConn->request */
+struct http_connection {
+    struct tcp_connection* tcpConn;
+    struct http_server* httpServer;
+    int nrequest;       // requests answered so far
+    int idle;           // no partial request buffered, counted in idle connections of reactor
+    int stalled;        // stopped handling pipelined requests above HTTP_OUTPUT_HIGH_WATER or behind a stream
+    int closing;        // last response queued, further input is discarded
+    int shutdown;       // write end closed after last response was sent
+    struct http_stream stream;
+    struct http_parser parser;
+};
+
+/**
+ * HTTP/1.1 server on top of a tcp server
+ * - persistent connections: every complete request already read is handled in one go, pipelined ones included;
+ * - responses are queued back-to-back into output buffer of connection, in request order,
+ *   and leave by a single writev() per read event instead of one write() each;
+ * - idle keep-alive connections are closed after keepAliveTimeout, at most keepAliveRequests are answered on one,
+ *   and once a reactor holds maxIdle idle ones, last response of a batch asks peer to close;
+ * - with cache enabled, GET answers marked cacheable are kept serialized in a shard per reactor,
+ *   GET and HEAD hits skip the handler and are written from the cached bytes;
+ * - streamed bodies are sent chunked, their producer runs only while output of connection is below HTTP_STREAM_LOW_WATER,
+ *   and again each time a write drains it, so a body of any size takes bounded memory.
+ */
+struct http_server {
+    struct server* server;
+    http_request_handler handler;
+    uint64_t keepAliveTimeout;
+    int keepAliveRequests;
+    int maxIdle;
+    size_t cacheBytes;  // capacity of response cache shard of each reactor, 0 if disabled
+    void* data;         // for handler use
+};
+
+/* create a http server listening on port with threadNum sub-reactors */
+struct http_server* http_server_new(const char* name, int port, int threadNum, http_request_handler handler, void* data);
+
+/**
+ * set keep-alive limits, 0 keeps the default of each, maxRequests 1 disables keep-alive
+ * must be called before http_server_run()
+ */
+void http_server_set_keepalive(struct http_server* httpServer, uint64_t timeout, int maxRequests, int maxIdle);
+
+/* cache GET answers marked by http_response_set_cacheable(), each reactor keeps up to maxBytes (0 for HTTP_CACHE_BYTES) */
+void http_server_enable_cache(struct http_server* httpServer, size_t maxBytes);
+
+/* start serving, see server_run() */
+void http_server_run(struct http_server* httpServer);
+
+/* address of request slice, valid until handler returns */
+static inline const char* http_connection_slice(struct http_connection* httpConn, struct http_slice slice)
+{
+    return http_slice_ptr(httpConn->tcpConn->inBuffer, slice);
+}
+
+/* buffer requests of connection are parsed from */
+static inline struct buffer* http_connection_input(struct http_connection* httpConn)
+{
+    return httpConn->tcpConn->inBuffer;
+}
+
+/* reason phrase of status code, "Unknown" for unlisted ones */
+const char* http_status_reason(int status);
+
+/* add a header to response, name and value must stay valid until handler returns, return -1 if full */
+int http_response_add_header(struct http_response* response, const char* name, const char* value);
+
+/* set response body, see struct http_response */
+void http_response_set_body(struct http_response* response, const void* body, size_t len);
+
+/**
+ * let response to a GET be answered from cache for ttl ms to requests with the same uri and the same values
+ * of nvary request headers, a Vary header is added for each, return -1 if there are more than HTTP_CACHE_MAX_VARY
+ * answers with a file body are not cached, static files have their own cache
+ */
+int http_response_set_cacheable(struct http_response* response, uint64_t ttl, const int* varyIds, int nvary);
+
+/**
+ * send [offset, offset + len) of fd as response body without copying it, replacing body set before
+ * release(arg) is called exactly once when fd is no longer needed, also if response ends up without body (HEAD)
+ */
+void http_response_set_file(struct http_response* response, int fd, off_t offset, size_t len,
+        buffer_release_callback release, void* arg);
+
+/**
+ * stream response body from producer, replacing body set before, see http_stream_producer
+ * release(arg) is called exactly once when stream ends, also if response ends up without body (HEAD) or connection is closed
+ * pipelined requests wait until the stream is complete, streamed answers are never cached
+ */
+void http_response_set_stream(struct http_response* response, http_stream_producer producer,
+        buffer_release_callback release, void* arg);
+
+/* queue len bytes as one chunk of the stream being produced, copied, return -1 if connection is closed */
+int http_connection_write_chunk(struct http_connection* httpConn, const void* data, size_t len);
+
+/**
+ * call producer of the paused stream of connection again, e.g. once data it waits for is available
+ * only called by thread owning tcpConn, no-op if it has been closed or has no paused stream
+ */
+void http_connection_resume_stream(struct tcp_connection* tcpConn);
+
+#endif
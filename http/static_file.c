@@ -0,0 +1,423 @@
+#define _GNU_SOURCE // strptime, timegm
+#include "http/static_file.h"
+#include <ctype.h>
+#include <fcntl.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#ifdef SYS_openat2
+#include <linux/openat2.h>
+#endif
+
+#define STATIC_FILE_WATCH_EVENTS (IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF)
+
+struct mime_type {
+    const char* ext;
+    const char* type;
+};
+
+static const struct mime_type MIME_TYPES[] = {
+    {"html", "text/html; charset=utf-8"},
+    {"htm", "text/html; charset=utf-8"},
+    {"css", "text/css; charset=utf-8"},
+    {"js", "application/javascript; charset=utf-8"},
+    {"mjs", "application/javascript; charset=utf-8"},
+    {"json", "application/json"},
+    {"txt", "text/plain; charset=utf-8"},
+    {"xml", "application/xml"},
+    {"svg", "image/svg+xml"},
+    {"png", "image/png"},
+    {"jpg", "image/jpeg"},
+    {"jpeg", "image/jpeg"},
+    {"gif", "image/gif"},
+    {"webp", "image/webp"},
+    {"ico", "image/x-icon"},
+    {"woff", "font/woff"},
+    {"woff2", "font/woff2"},
+    {"ttf", "font/ttf"},
+    {"wasm", "application/wasm"},
+    {"pdf", "application/pdf"},
+    {"mp4", "video/mp4"},
+    {"webm", "video/webm"},
+    {"mp3", "audio/mpeg"},
+};
+
+/* cache of the reactor running in this thread */
+static __thread struct static_file_cache* static_file_cache_self = NULL;
+/* set once openat2() turns out to be missing, this reactor then opens with plain openat() */
+static __thread int static_file_no_openat2 = 0;
+
+static struct static_file_cache* static_file_cache_get(struct event_loop* eventLoop);
+static int static_file_cache_on_event(struct static_file_cache* cache);
+static struct static_file* static_file_lookup(struct static_file_cache* cache, struct static_dir* dir, const char* path, size_t len, int* status);
+static struct static_file* static_file_open(struct static_file_cache* cache, struct static_dir* dir, const char* path, size_t len, uint32_t hash, int* status);
+static void static_file_uncache(struct static_file_cache* cache, struct static_file* file);
+static void static_file_release(void* arg);
+static int static_file_not_modified(struct buffer* input, const struct http_request* request, struct static_file* file);
+static size_t static_file_resolve(struct buffer* input, const struct http_request* request, char* path);
+static int static_file_openat(int rootFd, const char* path);
+
+struct static_dir* static_dir_new(const char* root)
+{
+    struct static_dir* dir = malloc(sizeof(struct static_dir));
+    if (dir == NULL) goto failed;
+    dir->rootFd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir->rootFd < 0) {
+        free(dir);
+        goto failed;
+    }
+    dir->root = strdup(root);
+    return dir;
+
+failed:
+    LOG(LT_ERROR, "failed to open static directory %s, %s", root, strerror(errno));
+    return NULL;
+}
+
+int static_dir_serve(struct static_dir* dir, struct http_connection* httpConn,
+        const struct http_request* request, struct http_response* response)
+{
+    struct buffer* input = http_connection_input(httpConn);
+    char path[STATIC_FILE_MAX_PATH];
+    int status = 404;
+
+    if (request->method != HTTP_METHOD_GET && request->method != HTTP_METHOD_HEAD) {
+        response->status = 405;
+        http_response_add_header(response, "Allow", "GET, HEAD");
+        return 0;
+    }
+
+    size_t len = static_file_resolve(input, request, path);
+    struct static_file_cache* cache = static_file_cache_get(httpConn->tcpConn->eventLoop);
+    struct static_file* file = len > 0 ? static_file_lookup(cache, dir, path, len, &status) : NULL;
+    if (file == NULL) {
+        if (status >= 500) return -1;
+        response->status = status;
+        return 0;
+    }
+
+    /* header values point into file, which outlives the response while response holds it */
+    http_response_add_header(response, "ETag", file->etag);
+    http_response_add_header(response, "Last-Modified", file->lastModified);
+    if (static_file_not_modified(input, request, file)) {
+        response->status = 304;
+        /* validators are serialized after handler returns, entry opened just for this request must outlive that */
+        event_loop_queue_in_loop(httpConn->tcpConn->eventLoop, static_file_release, file);
+        return 0;
+    }
+    response->contentType = file->mimeType;
+    http_response_set_file(response, file->fd, 0, file->size, static_file_release, file);
+    return 0;
+}
+
+/**
+ * decode request path into path relative to root, index file for a directory path
+ * empty and "." segments are skipped, return 0 for "..", NUL or a path longer than STATIC_FILE_MAX_PATH
+ */
+static size_t static_file_resolve(struct buffer* input, const struct http_request* request, char* path)
+{
+    const char* p = http_slice_ptr(input, request->path);
+    const char* end = p + request->path.len;
+    size_t len = 0, segment = 0;
+
+    while (p < end) {
+        char c = *p++;
+        if (c == '%') {
+            if (end - p < 2 || !isxdigit((unsigned char)p[0]) || !isxdigit((unsigned char)p[1])) return 0;
+            char hex[3] = {p[0], p[1], '\0'};
+            c = (char)strtol(hex, NULL, 16);
+            p += 2;
+            if (c == '\0') return 0;
+        }
+        if (c == '/') {
+            /* segment just finished: drop it if empty or ".", reject ".." */
+            if (segment == 1 && path[len - 1] == '.') len -= 1;
+            else if (segment == 2 && path[len - 1] == '.' && path[len - 2] == '.') return 0;
+            else if (segment > 0) path[len++] = '/';
+            segment = 0;
+            if (len >= STATIC_FILE_MAX_PATH) return 0;
+            continue;
+        }
+        if (len + 1 >= STATIC_FILE_MAX_PATH) return 0;
+        path[len++] = c;
+        segment++;
+    }
+    if (segment == 1 && path[len - 1] == '.') len -= 1;
+    else if (segment == 2 && path[len - 1] == '.' && path[len - 2] == '.') return 0;
+
+    /* directory, trailing '/' kept by the loop above */
+    if (len == 0 || path[len - 1] == '/') {
+        size_t indexLen = strlen(STATIC_FILE_INDEX);
+        if (len + indexLen >= STATIC_FILE_MAX_PATH) return 0;
+        memcpy(path + len, STATIC_FILE_INDEX, indexLen);
+        len += indexLen;
+    }
+    path[len] = '\0';
+    return len;
+}
+
+/* whether the copy held by client is current, judged from cached validators only */
+static int static_file_not_modified(struct buffer* input, const struct http_request* request, struct static_file* file)
+{
+    const struct http_header* header = http_request_header(request, HTTP_HDR_IF_NONE_MATCH);
+    if (header != NULL) {
+        /* comma separated entity tags or "*", compared weakly */
+        const char* p = http_slice_ptr(input, header->value);
+        const char* end = p + header->value.len;
+        size_t etagLen = strlen(file->etag);
+        while (p < end) {
+            while (p < end && (*p == ' ' || *p == '\t' || *p == ',')) p++;
+            const char* tag = p;
+            while (p < end && *p != ',') p++;
+            const char* tagEnd = p;
+            while (tagEnd > tag && (tagEnd[-1] == ' ' || tagEnd[-1] == '\t')) tagEnd--;
+            if (tagEnd - tag == 1 && *tag == '*') return 1;
+            if (tagEnd - tag > 2 && tag[0] == 'W' && tag[1] == '/') tag += 2;
+            if ((size_t)(tagEnd - tag) == etagLen && memcmp(tag, file->etag, etagLen) == 0) return 1;
+        }
+        /* If-Modified-Since is ignored when If-None-Match is present */
+        return 0;
+    }
+
+    header = http_request_header(request, HTTP_HDR_IF_MODIFIED_SINCE);
+    if (header == NULL) return 0;
+    const char* value = http_slice_ptr(input, header->value);
+    size_t len = header->value.len;
+    /* clients mostly echo Last-Modified back as it is */
+    if (len == strlen(file->lastModified) && memcmp(value, file->lastModified, len) == 0) return 1;
+
+    char date[sizeof(file->lastModified)];
+    if (len >= sizeof(date)) return 0;
+    memcpy(date, value, len);
+    date[len] = '\0';
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    if (strptime(date, "%a, %d %b %Y %H:%M:%S GMT", &tm) == NULL) return 0;
+    return file->mtime <= timegm(&tm);
+}
+
+/* FNV-1a */
+static uint32_t static_file_hash(const char* path, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)path[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/* referenced entry of path, opened and cached on a miss, NULL with status set if it can't be served */
+static struct static_file* static_file_lookup(struct static_file_cache* cache, struct static_dir* dir, const char* path, size_t len, int* status)
+{
+    uint32_t hash = static_file_hash(path, len);
+    struct static_file* file = cache->buckets[hash & (STATIC_FILE_CACHE_BUCKETS - 1)];
+    for (; file != NULL; file = file->hnext) {
+        if (file->hash == hash && file->dir == dir && file->pathLen == len && memcmp(file->path, path, len) == 0)
+            break;
+    }
+
+    if (file == NULL) {
+        file = static_file_open(cache, dir, path, len, hash, status);
+        if (file == NULL) return NULL;
+    } else if (file != cache->head) {
+        /* move to front of lru list */
+        file->prev->next = file->next;
+        if (file->next != NULL) file->next->prev = file->prev;
+        else cache->tail = file->prev;
+        file->prev = NULL;
+        file->next = cache->head;
+        cache->head->prev = file;
+        cache->head = file;
+    }
+    file->refCount++;
+    return file;
+}
+
+/**
+ * open path below rootFd, symlinks are followed only while they resolve beneath the root (EXDEV otherwise),
+ * /proc magic links never (ELOOP). kernels before 5.6 have no openat2(), there plain openat() is used and
+ * symlinks under the root are trusted wherever they point.
+ */
+static int static_file_openat(int rootFd, const char* path)
+{
+#ifdef SYS_openat2
+    if (!static_file_no_openat2) {
+        struct open_how how = {
+            .flags = O_RDONLY | O_CLOEXEC,
+            .resolve = RESOLVE_BENEATH | RESOLVE_NO_MAGICLINKS,
+        };
+        int fd = syscall(SYS_openat2, rootFd, path, &how, sizeof(how));
+        if (fd >= 0 || errno != ENOSYS) return fd;
+        static_file_no_openat2 = 1;
+        LOG(LT_WARN, "openat2() unsupported by kernel, symlinks under static root are followed anywhere");
+    }
+#endif
+    return openat(rootFd, path, O_RDONLY | O_CLOEXEC);
+}
+
+/* open path below dir, watch and cache it, least recently used entry is dropped when cache is full */
+static struct static_file* static_file_open(struct static_file_cache* cache, struct static_dir* dir, const char* path, size_t len, uint32_t hash, int* status)
+{
+    char fullPath[STATIC_FILE_MAX_PATH + 256];
+    struct stat st;
+    int wd = -1, fd = -1;
+
+    /* watch before opening, so that a change racing with the open still invalidates the entry */
+    if (cache->inotifyFd >= 0 && snprintf(fullPath, sizeof(fullPath), "%s/%s", dir->root, path) < (int)sizeof(fullPath))
+        wd = inotify_add_watch(cache->inotifyFd, fullPath, STATIC_FILE_WATCH_EVENTS);
+
+    fd = static_file_openat(dir->rootFd, path);
+    if (fd < 0) {
+        *status = errno == ENOENT || errno == ENOTDIR || errno == ENAMETOOLONG || errno == EXDEV || errno == ELOOP ? 404
+                  : errno == EACCES ? 403 : 500;
+        goto failed;
+    }
+    if (fstat(fd, &st) < 0) {
+        *status = 500;
+        goto failed;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        *status = 404;
+        goto failed;
+    }
+
+    struct static_file* file = malloc(sizeof(struct static_file) + len + 1);
+    if (file == NULL) {
+        *status = 500;
+        goto failed;
+    }
+    file->dir = dir;
+    file->refCount = 0;
+    file->fd = fd;
+    file->wd = wd;
+    file->size = st.st_size;
+    file->mtime = st.st_mtim.tv_sec;
+    file->hash = hash;
+    file->pathLen = len;
+    memcpy(file->path, path, len);
+    file->path[len] = '\0';
+    file->mimeType = static_file_mime_type(path, len);
+    snprintf(file->etag, sizeof(file->etag), "\"%lx-%zx\"", (unsigned long)file->mtime, file->size);
+    struct tm tm;
+    gmtime_r(&file->mtime, &tm);
+    strftime(file->lastModified, sizeof(file->lastModified), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+
+    /* without a watch nothing would tell the entry is stale, it's only kept by the response using it */
+    file->cached = wd >= 0;
+    file->hnext = file->prev = file->next = NULL;
+    if (!file->cached) return file;
+
+    if (cache->nentry >= STATIC_FILE_CACHE_ENTRIES)
+        static_file_uncache(cache, cache->tail);
+    struct static_file** bucket = &cache->buckets[hash & (STATIC_FILE_CACHE_BUCKETS - 1)];
+    file->hnext = *bucket;
+    *bucket = file;
+    file->next = cache->head;
+    if (cache->head != NULL) cache->head->prev = file;
+    else cache->tail = file;
+    cache->head = file;
+    cache->nentry++;
+    file->refCount++;
+    return file;
+
+failed:
+    if (fd >= 0) close(fd);
+    if (wd >= 0) inotify_rm_watch(cache->inotifyFd, wd);
+    return NULL;
+}
+
+/* drop entry from cache and its watch, fd stays open for responses still holding it */
+static void static_file_uncache(struct static_file_cache* cache, struct static_file* file)
+{
+    struct static_file** pp = &cache->buckets[file->hash & (STATIC_FILE_CACHE_BUCKETS - 1)];
+    while (*pp != file) pp = &(*pp)->hnext;
+    *pp = file->hnext;
+
+    if (file->prev != NULL) file->prev->next = file->next;
+    else cache->head = file->next;
+    if (file->next != NULL) file->next->prev = file->prev;
+    else cache->tail = file->prev;
+
+    /* entries of other paths to the same inode share the watch, they are dropped by the IN_IGNORED event it raises */
+    inotify_rm_watch(cache->inotifyFd, file->wd);
+    file->cached = 0;
+    cache->nentry--;
+    static_file_release(file);
+}
+
+/* buffer_release_callback of queued file regions */
+static void static_file_release(void* arg)
+{
+    struct static_file* file = arg;
+    if (--file->refCount > 0) return;
+    close(file->fd);
+    free(file);
+}
+
+static struct static_file_cache* static_file_cache_get(struct event_loop* eventLoop)
+{
+    if (static_file_cache_self != NULL) return static_file_cache_self;
+    assertInOwnerThread(eventLoop);
+
+    struct static_file_cache* cache = calloc(1, sizeof(struct static_file_cache));
+    assert(cache != NULL);
+    cache->eventLoop = eventLoop;
+    cache->inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (cache->inotifyFd < 0) {
+        LOG(LT_WARN, "inotify unavailable in %s, static files are not cached, %s", eventLoop->thread_name, strerror(errno));
+    } else {
+        cache->channel = channel_new(cache->inotifyFd, EVENT_READ, (event_read_callback)static_file_cache_on_event, NULL, cache);
+        event_loop_add_channel_event(eventLoop, cache->inotifyFd, cache->channel);
+    }
+    static_file_cache_self = cache;
+    return cache;
+}
+
+/* EVENT_READ callback of inotify fd, drop every entry whose file changed */
+static int static_file_cache_on_event(struct static_file_cache* cache)
+{
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    for (;;) {
+        ssize_t n = read(cache->inotifyFd, events, sizeof(events));
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            break;
+        }
+        for (char* p = events; p < events + n; p += sizeof(struct inotify_event) + ((struct inotify_event*)p)->len) {
+            struct inotify_event* event = (struct inotify_event*)p;
+            /* events were lost, nothing cached can be trusted; changes are rare, so entries are scanned instead of indexed by wd */
+            int all = event->mask & IN_Q_OVERFLOW;
+            for (struct static_file* file = cache->head, *next; file != NULL; file = next) {
+                next = file->next;
+                if (all || file->wd == event->wd) {
+                    LOG(LT_DEBUG, "static file %s changed, dropped from cache", file->path);
+                    static_file_uncache(cache, file);
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+const char* static_file_mime_type(const char* path, size_t len)
+{
+    const char* ext = NULL;
+    for (size_t i = len; i > 0; i--) {
+        if (path[i - 1] == '.') {
+            ext = path + i;
+            break;
+        }
+        if (path[i - 1] == '/') break;
+    }
+    if (ext != NULL) {
+        for (size_t i = 0; i < sizeof(MIME_TYPES) / sizeof(MIME_TYPES[0]); i++) {
+            if (strcasecmp(ext, MIME_TYPES[i].ext) == 0)
+                return MIME_TYPES[i].type;
+        }
+    }
+    return "application/octet-stream";
+}
@@ -0,0 +1,76 @@
+#ifndef STATIC_FILE_H
+#define STATIC_FILE_H
+#include "http/http_server.h"
+#include <time.h>
+
+#define STATIC_FILE_CACHE_ENTRIES 1024  // open files cached per reactor, least recently used one is closed beyond it
+#define STATIC_FILE_CACHE_BUCKETS 2048
+#define STATIC_FILE_MAX_PATH 1024
+#define STATIC_FILE_INDEX "index.html"  // served for paths ending in '/'
+
+struct static_dir;
+struct static_file_cache;
+
+/**
+ * an open file and everything a response needs from it, formatted once when the file is opened
+ * cache holds one reference while entry is cached, every response queued with its fd holds another,
+ * fd is closed when the last one is dropped, so invalidation never cuts a response being sent.
+ */
+struct static_file {
+    struct static_file* hnext;      // hash chain
+    struct static_file* prev;       // lru list, most recently used first
+    struct static_file* next;
+    struct static_dir* dir;
+    int refCount;
+    int cached;
+    int fd;
+    int wd;                         // inotify watch of file, -1 if none
+    size_t size;
+    time_t mtime;
+    const char* mimeType;
+    char etag[48];
+    char lastModified[32];
+    uint32_t hash;
+    size_t pathLen;
+    char path[];                    // relative to root of dir, key of cache
+};
+
+/**
+ * open files of one reactor, created on first request by the thread running it, so no lock is taken
+ * - lookups hash the request path, a hit costs no syscall: 304 is answered from cached ETag/Last-Modified,
+ *   200 queues the cached fd for sendfile();
+ * - every cached file has an inotify watch, events arrive on a channel of the loop and drop entries
+ *   of modified, replaced or removed files, which are opened again by next request;
+ * - without inotify, files are opened per request and closed once sent.
+ */
+struct static_file_cache {
+    struct event_loop* eventLoop;
+    int inotifyFd;
+    struct channel* channel;
+    int nentry;
+    struct static_file* head;
+    struct static_file* tail;
+    struct static_file* buckets[STATIC_FILE_CACHE_BUCKETS];
+};
+
+/* directory served by static_dir_serve() */
+struct static_dir {
+    char* root;
+    int rootFd;                     // files are opened relative to it
+};
+
+/* open root directory to be served, NULL if it can't be opened */
+struct static_dir* static_dir_new(const char* root);
+
+/**
+ * answer GET/HEAD request for a file below dir, 304 for a matching If-None-Match/If-Modified-Since,
+ * 404/403/405 otherwise, return -1 on internal failure so that handler answers 500
+ * only called by http handlers, i.e. by reactor threads
+ */
+int static_dir_serve(struct static_dir* dir, struct http_connection* httpConn,
+        const struct http_request* request, struct http_response* response);
+
+/* MIME type of path by extension, "application/octet-stream" for unknown ones */
+const char* static_file_mime_type(const char* path, size_t len);
+
+#endif
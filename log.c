@@ -1,7 +1,16 @@
 #include "log.h"
+#include "mpsc_queue.h" // CACHE_LINE_SIZE
+#include "loop_clock.h"
+#include <pthread.h>
+#include <stdlib.h>
+
+#define LOG_RING_MASK (LOG_RING_CAPACITY - 1)
+#define LOG_LINE_MAXLEN (LOG_MSG_MAXLEN + 256)
 
 FILE* log_file = NULL; // 注意在程序退出时fclose
 
+atomic_int log_level = LT_INFO;
+
 const char* LOG_LEVEL_STRS[5] = {
     "DEBUG",
     "INFO",
@@ -10,39 +19,259 @@ const char* LOG_LEVEL_STRS[5] = {
     "FATAL"
 };
 
+/* one message, file and func point to string literals so only the message itself is copied */
+struct log_record {
+    int level;
+    int line;
+    const char* file;
+    const char* func;
+    struct timespec ts;
+    char msg[LOG_MSG_MAXLEN];
+};
+
+/**
+ * single-producer single-consumer ring of one logging thread, drained by the writer thread
+ * producer owns tail and consumer owns head, each on its own cache line
+ */
+struct log_ring {
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t tail;
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t head;
+    atomic_ulong dropped;
+    unsigned long droppedReported; // only accessed by consumer
+    atomic_int closed;             // owner thread exited, ring is freed once drained
+    struct log_ring* next;
+    struct log_record records[LOG_RING_CAPACITY];
+};
+
+/* registered rings, the lock is only taken by a thread logging for the first time and by consumers, never per message */
+static pthread_mutex_t log_rings_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct log_ring* log_rings = NULL;
+static atomic_ulong log_total_dropped;
+
+/**
+ * writer thread blocks on log_writer_cond while every ring is empty, so an idle server costs no wakeup:
+ * it sets log_writer_sleeping and checks rings again under log_writer_lock before waiting,
+ * a producer checks the flag after publishing a record and the first one seeing it signals.
+ */
+static pthread_mutex_t log_writer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t log_writer_cond = PTHREAD_COND_INITIALIZER;
+static atomic_int log_writer_sleeping;
+
+static pthread_once_t log_once = PTHREAD_ONCE_INIT;
+static pthread_key_t log_ring_key;
+static int log_writer_running = 0;
+static __thread struct log_ring* log_ring_self = NULL;
+
+static void log_init();
+static void* log_writer_routine(void* arg);
+
+static void log_ring_release(void* data)
+{
+    struct log_ring* ring = data;
+    atomic_store_explicit(&ring->closed, 1, memory_order_release);
+}
+
+static struct log_ring* log_ring_current()
+{
+    if (log_ring_self != NULL) return log_ring_self;
+    pthread_once(&log_once, log_init);
+    if (!log_writer_running) return NULL;
+
+    struct log_ring* ring = aligned_alloc(CACHE_LINE_SIZE, sizeof(struct log_ring));
+    if (ring == NULL) return NULL;
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->dropped, 0);
+    ring->droppedReported = 0;
+    atomic_init(&ring->closed, 0);
+
+    pthread_mutex_lock(&log_rings_lock);
+    ring->next = log_rings;
+    log_rings = ring;
+    pthread_mutex_unlock(&log_rings_lock);
+    pthread_setspecific(log_ring_key, ring);
+    log_ring_self = ring;
+    return ring;
+}
+
+static void log_init()
+{
+    if (pthread_key_create(&log_ring_key, log_ring_release) != 0) return;
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, log_writer_routine, NULL) != 0) return;
+    pthread_detach(tid);
+    log_writer_running = 1;
+    atexit(log_flush);
+}
+
+/* write one line to console and log file, caller holds log_rings_lock */
+static void log_write(int level, const struct timespec* ts, const char* file, const char* func, int line, const char* msg)
+{
+    /* localtime is only called once per second by the single writer */
+    static time_t lastSec = -1;
+    static char t_str[40];
+    if (ts->tv_sec != lastSec) {
+        struct tm time_info;
+        lastSec = ts->tv_sec;
+        localtime_r(&lastSec, &time_info);
+        strftime(t_str, sizeof(t_str), "%Y-%m-%d %H:%M:%S", &time_info);
+    }
+
+    char buff[LOG_LINE_MAXLEN];
+    int n = snprintf(buff, sizeof(buff), "[%5s] %s in %s %s:%-4d %s\n", LOG_LEVEL_STRS[level], t_str, file, func, line, msg);
+    if (n < 0) return;
+    if (n >= sizeof(buff)) n = sizeof(buff) - 1;
+#ifdef ENABLE_CMDLOG
+    fwrite(buff, 1, n, stdout);
+#endif
+#ifdef ENABLE_FILELOG
+    if (log_file == NULL) log_file = fopen(LOG_FILE_NAME, "a+");
+    if (log_file != NULL) fwrite(buff, 1, n, log_file);
+#endif
+}
+
+/* write out every buffered record, report drops and free rings of exited threads, return records written */
+static size_t log_drain()
+{
+    size_t total = 0;
+    pthread_mutex_lock(&log_rings_lock);
+    struct log_ring** pring = &log_rings;
+    while (*pring != NULL) {
+        struct log_ring* ring = *pring;
+        int closed = atomic_load_explicit(&ring->closed, memory_order_acquire);
+        size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        for (; head != tail; head++, total++) {
+            struct log_record* rec = &ring->records[head & LOG_RING_MASK];
+            log_write(rec->level, &rec->ts, rec->file, rec->func, rec->line, rec->msg);
+        }
+        atomic_store_explicit(&ring->head, head, memory_order_release);
+
+        unsigned long dropped = atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+        if (dropped != ring->droppedReported) {
+            char msg[64];
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+            snprintf(msg, sizeof(msg), "%lu log messages dropped on full ring", dropped - ring->droppedReported);
+            log_write(LT_WARN, &ts, __FILE__, __func__, __LINE__, msg);
+            ring->droppedReported = dropped;
+            total++;
+        }
+
+        if (closed && head == atomic_load_explicit(&ring->tail, memory_order_acquire)) {
+            *pring = ring->next;
+            free(ring);
+        } else {
+            pring = &ring->next;
+        }
+    }
+    if (total > 0) {
+        fflush(stdout);
+        if (log_file != NULL) fflush(log_file);
+    }
+    pthread_mutex_unlock(&log_rings_lock);
+    return total;
+}
+
+/* whether any ring has a record or a drop to report */
+static int log_pending()
+{
+    int pending = 0;
+    pthread_mutex_lock(&log_rings_lock);
+    for (struct log_ring* ring = log_rings; ring != NULL && !pending; ring = ring->next) {
+        pending = atomic_load_explicit(&ring->head, memory_order_relaxed) != atomic_load_explicit(&ring->tail, memory_order_acquire)
+            || atomic_load_explicit(&ring->dropped, memory_order_relaxed) != ring->droppedReported;
+    }
+    pthread_mutex_unlock(&log_rings_lock);
+    return pending;
+}
+
+static void* log_writer_routine(void* arg)
+{
+    while (1) {
+        if (log_drain() > 0) continue;
+        pthread_mutex_lock(&log_writer_lock);
+        atomic_store_explicit(&log_writer_sleeping, 1, memory_order_seq_cst);
+        /* pairs with the fence in server_log(): either producer sees the flag or this check sees its record */
+        atomic_thread_fence(memory_order_seq_cst);
+        if (!log_pending())
+            pthread_cond_wait(&log_writer_cond, &log_writer_lock);
+        atomic_store_explicit(&log_writer_sleeping, 0, memory_order_relaxed);
+        pthread_mutex_unlock(&log_writer_lock);
+    }
+    return NULL;
+}
+
+/* wake writer thread if it's waiting for records, only the first producer after it fell asleep takes the lock */
+static void log_writer_wakeup()
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&log_writer_sleeping, memory_order_relaxed) == 0) return;
+    if (atomic_exchange_explicit(&log_writer_sleeping, 0, memory_order_relaxed) == 0) return;
+    pthread_mutex_lock(&log_writer_lock);
+    pthread_cond_signal(&log_writer_cond);
+    pthread_mutex_unlock(&log_writer_lock);
+}
+
 void server_log(int level, char* file, const char* func, int line, char* fmt, ...)
 {
     if (level < LT_DEBUG || level > LT_FATAL_ERROR)
         return;
-    // TODO: 只输出等级大于等于当前log_level的日志
-#ifndef DEBUG
-    if (level == LT_DEBUG) return;
-#endif
+    if (level < atomic_load_explicit(&log_level, memory_order_relaxed))
+        return;
 
-    time_t now_time;
-    struct tm* time_info = NULL;
-    char t_str[40];
-    char msg_buff[1024];
     va_list ap;
     va_start(ap, fmt);
+    struct log_ring* ring = log_ring_current();
+    if (ring == NULL) {
+        /* no writer thread, write synchronously */
+        char msg_buff[LOG_MSG_MAXLEN];
+        struct timespec ts;
+        vsnprintf(msg_buff, sizeof(msg_buff), fmt, ap);
+        clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+        pthread_mutex_lock(&log_rings_lock);
+        log_write(level, &ts, file, func, line, msg_buff);
+        fflush(stdout);
+        pthread_mutex_unlock(&log_rings_lock);
+        va_end(ap);
+        return;
+    }
 
-    now_time = time(NULL);
-    time_info = localtime(&now_time);
-    strftime(t_str, 40, "%Y-%m-%d %H:%M:%S", time_info);
-    vsprintf(msg_buff, fmt, ap);
-#ifdef ENABLE_CMDLOG
-        printf("[%5s] %s in %s %s:%-4d %s\n", LOG_LEVEL_STRS[level], t_str, file, func, line, msg_buff);
-#endif
-#ifdef ENABLE_FILELOG
-    if (log_file == NULL) {
-        log_file = fopen(LOG_FILE_NAME, "a+");
-        if (log_file == NULL) {
-            va_end(ap);
-            return;
-        }
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (tail - head >= LOG_RING_CAPACITY) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&log_total_dropped, 1, memory_order_relaxed);
+        va_end(ap);
+        return;
     }
-    /* fprintf(log_file, "[%5s] %s %s in %s:%d\n", LOG_LEVEL_STRS[level], t_str, msg_buff, file, line); */
-    fprintf(log_file, "[%5s] %s in %s %s:%-4d %s\n", LOG_LEVEL_STRS[level], t_str, file, func, line, msg_buff);
-#endif
+    struct log_record* rec = &ring->records[tail & LOG_RING_MASK];
+    rec->level = level;
+    rec->line = line;
+    rec->file = file;
+    rec->func = func;
+    /* threads running an event_loop reuse its clock snapshot, others read coarse clock from vDSO */
+    if (loop_clock_self != NULL) rec->ts = loop_clock_self->realtime;
+    else clock_gettime(CLOCK_REALTIME_COARSE, &rec->ts);
+    vsnprintf(rec->msg, sizeof(rec->msg), fmt, ap);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
     va_end(ap);
+    log_writer_wakeup();
+
+    if (level == LT_FATAL_ERROR) log_flush();
+}
+
+void log_set_level(int level)
+{
+    atomic_store_explicit(&log_level, level, memory_order_relaxed);
+}
+
+unsigned long log_dropped()
+{
+    return atomic_load_explicit(&log_total_dropped, memory_order_relaxed);
+}
+
+void log_flush()
+{
+    log_drain();
 }
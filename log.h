@@ -1,14 +1,12 @@
 #ifndef LOG_H
 #define LOG_H
 #include <stdarg.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <time.h>
 #include <errno.h>
 #include <string.h>
 
-#define LOG(level, format, arg...) server_log(level, __FILE__, __func__,  __LINE__, format, ##arg)
-#define LOG_SYSCALL_ERROR() server_log(LT_WARN, __FILE__, __func__,  __LINE__, "%s", strerror(errno))
-
 #define LT_DEBUG 0
 #define LT_INFO 1
 #define LT_WARN 2
@@ -16,11 +14,47 @@
 #define LT_FATAL_ERROR 4
 #define DISABLE_LOG 5
 
+/* levels below it are compiled out, LOG() of a constant level below it costs nothing */
+#ifndef LOG_COMPILE_LEVEL
+#ifdef DEBUG
+#define LOG_COMPILE_LEVEL LT_DEBUG
+#else
+#define LOG_COMPILE_LEVEL LT_INFO
+#endif
+#endif
+
+#define LOG(level, format, arg...)                                                                  \
+    do {                                                                                            \
+        if ((level) >= LOG_COMPILE_LEVEL && (level) >= atomic_load_explicit(&log_level, memory_order_relaxed)) \
+            server_log(level, __FILE__, __func__, __LINE__, format, ##arg);                         \
+    } while (0)
+#define LOG_SYSCALL_ERROR() LOG(LT_WARN, "%s", strerror(errno))
+
 #define ENABLE_CMDLOG
 #define ENABLE_FILELOG
 
 #define LOG_FILE_NAME "./logs/gchttp.log"
 
+#define LOG_RING_CAPACITY 512   // records buffered per logging thread, power of 2
+#define LOG_MSG_MAXLEN 472      // formatted message bytes kept per record, longer ones are truncated
+
+/* runtime minimum level, LT_INFO by default, DISABLE_LOG turns logging off */
+extern atomic_int log_level;
+
+/**
+ * format message into a lock-free ring owned by calling thread, written out later by a background writer thread
+ * never blocks: a message is dropped and counted when the ring of its thread is full
+ * LT_FATAL_ERROR messages are flushed before returning
+ */
 void server_log(int level, char* file, const char* func, int line, char* fmt, ...);
 
+/* change runtime minimum level, safe to call from any thread */
+void log_set_level(int level);
+
+/* number of messages dropped on full rings since start */
+unsigned long log_dropped();
+
+/* write out every buffered message in calling thread, called at exit as well */
+void log_flush();
+
 #endif
@@ -0,0 +1,39 @@
+#include "loop_clock.h"
+#include "timer_wheel.h"
+#include <stdio.h>
+#include <string.h>
+
+__thread const struct loop_clock* loop_clock_self = NULL;
+
+static const char* LOOP_CLOCK_WDAYS[7] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+static const char* LOOP_CLOCK_MONTHS[12] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+void loop_clock_init(struct loop_clock* clock)
+{
+    clock->formattedSec = -1;
+    loop_clock_update(clock);
+}
+
+/* HTTP-date is always English and GMT, so it's formatted by hand instead of the locale-dependent strftime */
+static void loop_clock_format(struct loop_clock* clock)
+{
+    struct tm tm;
+    char date[64];
+    time_t sec = clock->realtime.tv_sec;
+    gmtime_r(&sec, &tm);
+    snprintf(date, sizeof(date), "%s, %02d %s %04d %02d:%02d:%02d GMT",
+        LOOP_CLOCK_WDAYS[tm.tm_wday], tm.tm_mday, LOOP_CLOCK_MONTHS[tm.tm_mon], tm.tm_year + 1900,
+        tm.tm_hour, tm.tm_min, tm.tm_sec);
+    memcpy(clock->httpDate, date, LOOP_CLOCK_HTTP_DATE_LEN);
+    clock->httpDate[LOOP_CLOCK_HTTP_DATE_LEN] = '\0';
+    localtime_r(&sec, &tm);
+    strftime(clock->logTime, sizeof(clock->logTime), "%Y-%m-%d %H:%M:%S", &tm);
+    clock->formattedSec = sec;
+}
+
+void loop_clock_update(struct loop_clock* clock)
+{
+    clock->monotonicMs = timer_now_ms();
+    clock_gettime(CLOCK_REALTIME, &clock->realtime);
+    if (clock->realtime.tv_sec != clock->formattedSec) loop_clock_format(clock);
+}
@@ -0,0 +1,30 @@
+#ifndef LOOP_CLOCK_H
+#define LOOP_CLOCK_H
+#include <stdint.h>
+#include <time.h>
+
+#define LOOP_CLOCK_HTTP_DATE_LEN 29 // "Sun, 06 Nov 1994 08:49:37 GMT", IMF-fixdate of RFC 7231
+#define LOOP_CLOCK_LOG_TIME_LEN 19  // "2026-10-17 07:21:49", local time
+
+/**
+ * clock snapshot of one event_loop, refreshed once per loop round by its owner thread
+ * reading it costs a memory load, date strings are formatted again only when the second changes
+ */
+struct loop_clock {
+    uint64_t monotonicMs;       // monotonic clock in ms, same base as timer_now_ms()
+    struct timespec realtime;   // wall clock
+    time_t formattedSec;        // second of the date strings below
+    char httpDate[LOOP_CLOCK_HTTP_DATE_LEN + 1];
+    char logTime[LOOP_CLOCK_LOG_TIME_LEN + 1];
+};
+
+/* clock of the loop run by current thread, NULL if current thread doesn't run an event_loop */
+extern __thread const struct loop_clock* loop_clock_self;
+
+/* take the first snapshot */
+void loop_clock_init(struct loop_clock* clock);
+
+/* read monotonic and wall clocks, both served by vDSO, and reformat date strings on a new second */
+void loop_clock_update(struct loop_clock* clock);
+
+#endif
@@ -0,0 +1,72 @@
+#include "mpsc_queue.h"
+#include <stdint.h>
+
+struct mpsc_queue* mpsc_queue_new(size_t capacity)
+{
+    size_t size = 2;
+    while (size < capacity) size <<= 1;
+
+    struct mpsc_queue* queue = aligned_alloc(CACHE_LINE_SIZE, sizeof(struct mpsc_queue));
+    if (queue == NULL) return NULL;
+    queue->cells = malloc(size * sizeof(struct mpsc_cell));
+    if (queue->cells == NULL) {
+        free(queue);
+        return NULL;
+    }
+    for (size_t i = 0; i < size; i++)
+        atomic_init(&queue->cells[i].seq, i);
+    queue->mask = size - 1;
+    atomic_init(&queue->tail, 0);
+    queue->head = 0;
+    return queue;
+}
+
+int mpsc_queue_push(struct mpsc_queue* queue, int type, void* data, void* arg)
+{
+    struct mpsc_cell* cell;
+    size_t pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    for (;;) {
+        cell = &queue->cells[pos & queue->mask];
+        size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            /* cell is free for this position, claim it */
+            if (atomic_compare_exchange_weak_explicit(&queue->tail, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            /* cell still holds an entry from last lap, consumer is behind */
+            return -1;
+        } else {
+            /* another producer took this position */
+            pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+        }
+    }
+    cell->type = type;
+    cell->data = data;
+    cell->arg = arg;
+    atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+    return 0;
+}
+
+int mpsc_queue_pop(struct mpsc_queue* queue, int* type, void** data, void** arg)
+{
+    size_t pos = queue->head;
+    struct mpsc_cell* cell = &queue->cells[pos & queue->mask];
+    size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+    /* not published yet, a producer may have claimed it but not finished writing */
+    if (seq != pos + 1) return -1;
+    *type = cell->type;
+    *data = cell->data;
+    *arg = cell->arg;
+    /* hand cell over to producers of next lap */
+    atomic_store_explicit(&cell->seq, pos + queue->mask + 1, memory_order_release);
+    queue->head = pos + 1;
+    return 0;
+}
+
+void mpsc_queue_cleanup(struct mpsc_queue* queue)
+{
+    if (queue == NULL) return;
+    free(queue->cells);
+    free(queue);
+}
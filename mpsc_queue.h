@@ -0,0 +1,49 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#define MPSC_QUEUE_CAPACITY 4096    // default capacity, power of 2
+#define CACHE_LINE_SIZE 64
+
+/* one preallocated slot, seq tells whose turn it is */
+struct mpsc_cell {
+    atomic_size_t seq;
+    int type;
+    void* data;
+    void* arg;
+};
+
+/**
+ * bounded lock-free multi-producer/single-consumer queue (Vyukov's array queue)
+ * - cells are allocated once and recycled, pushing and popping never allocate or take a lock;
+ * - producers claim a position by CAS on tail, then publish the cell by its sequence number;
+ * - only one consumer thread pops, head is plain;
+ * - head and tail live on separate cache lines so that producers and consumer don't false-share.
+ */
+struct mpsc_queue {
+    struct mpsc_cell* cells;
+    size_t mask;
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t tail;
+    _Alignas(CACHE_LINE_SIZE) size_t head;
+};
+
+/* create a queue of capacity cells, capacity is rounded up to power of 2 */
+struct mpsc_queue* mpsc_queue_new(size_t capacity);
+
+/* push an entry, any thread, return -1 if queue is full */
+int mpsc_queue_push(struct mpsc_queue* queue, int type, void* data, void* arg);
+
+/* pop the oldest entry, consumer thread only, return -1 if queue is empty */
+int mpsc_queue_pop(struct mpsc_queue* queue, int* type, void** data, void** arg);
+
+/* number of cells */
+static inline size_t mpsc_queue_capacity(struct mpsc_queue* queue)
+{
+    return queue->mask + 1;
+}
+
+/* free queue, entries left are dropped */
+void mpsc_queue_cleanup(struct mpsc_queue* queue);
+
+#endif
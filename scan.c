@@ -0,0 +1,147 @@
+#include "scan.h"
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_X86
+#endif
+
+/* glibc memchr() is already vectorized and outruns a plain compare loop, every implementation uses it */
+static size_t scan_byte_scalar(const char* p, size_t n, char c)
+{
+    const char* hit = memchr(p, c, n);
+    return hit != NULL ? (size_t)(hit - p) : n;
+}
+
+static size_t scan_crlf_scalar(const char* p, size_t n)
+{
+    for (size_t i = 0; i + 1 < n; i++) {
+        const char* cr = memchr(p + i, '\r', n - 1 - i);
+        if (cr == NULL) break;
+        i = cr - p;
+        if (p[i + 1] == '\n') return i;
+    }
+    return n;
+}
+
+static size_t scan_crlfcrlf_scalar(const char* p, size_t n)
+{
+    for (size_t i = 0; i + 3 < n; i++) {
+        i += scan_crlf_scalar(p + i, n - i);
+        if (i + 3 >= n) break;
+        if (p[i + 2] == '\r' && p[i + 3] == '\n') return i;
+    }
+    return n;
+}
+
+#ifdef SCAN_X86
+/* every kernel compares a vector of bytes at p + i with shifted loads for the following pattern bytes, tail is left to scalar code */
+
+static size_t scan_crlf_sse2(const char* p, size_t n)
+{
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    size_t i = 0;
+    for (; i + 17 <= n; i += 16) {
+        __m128i a = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + i)), cr);
+        __m128i b = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + i + 1)), lf);
+        int mask = _mm_movemask_epi8(_mm_and_si128(a, b));
+        if (mask != 0) return i + __builtin_ctz(mask);
+    }
+    return i + scan_crlf_scalar(p + i, n - i);
+}
+
+static size_t scan_crlfcrlf_sse2(const char* p, size_t n)
+{
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    size_t i = 0;
+    for (; i + 19 <= n; i += 16) {
+        __m128i a = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + i)), cr);
+        __m128i b = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + i + 1)), lf);
+        __m128i c = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + i + 2)), cr);
+        __m128i d = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + i + 3)), lf);
+        int mask = _mm_movemask_epi8(_mm_and_si128(_mm_and_si128(a, b), _mm_and_si128(c, d)));
+        if (mask != 0) return i + __builtin_ctz(mask);
+    }
+    return i + scan_crlfcrlf_scalar(p + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_crlf_avx2(const char* p, size_t n)
+{
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    size_t i = 0;
+    for (; i + 33 <= n; i += 32) {
+        __m256i a = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + i)), cr);
+        __m256i b = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + i + 1)), lf);
+        unsigned mask = _mm256_movemask_epi8(_mm256_and_si256(a, b));
+        if (mask != 0) return i + __builtin_ctz(mask);
+    }
+    return i + scan_crlf_sse2(p + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_crlfcrlf_avx2(const char* p, size_t n)
+{
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    size_t i = 0;
+    for (; i + 35 <= n; i += 32) {
+        __m256i a = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + i)), cr);
+        __m256i b = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + i + 1)), lf);
+        __m256i c = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + i + 2)), cr);
+        __m256i d = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + i + 3)), lf);
+        unsigned mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, d)));
+        if (mask != 0) return i + __builtin_ctz(mask);
+    }
+    return i + scan_crlfcrlf_sse2(p + i, n - i);
+}
+#endif
+
+size_t (*scan_byte)(const char* p, size_t n, char c) = scan_byte_scalar;
+size_t (*scan_crlf)(const char* p, size_t n) = scan_crlf_scalar;
+size_t (*scan_crlfcrlf)(const char* p, size_t n) = scan_crlfcrlf_scalar;
+static const char* scan_impl = "scalar";
+
+int scan_select(const char* name)
+{
+    if (strcmp(name, "scalar") == 0) {
+        scan_byte = scan_byte_scalar;
+        scan_crlf = scan_crlf_scalar;
+        scan_crlfcrlf = scan_crlfcrlf_scalar;
+        scan_impl = "scalar";
+        return 0;
+    }
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+    if (strcmp(name, "sse2") == 0 && __builtin_cpu_supports("sse2")) {
+        scan_byte = scan_byte_scalar;
+        scan_crlf = scan_crlf_sse2;
+        scan_crlfcrlf = scan_crlfcrlf_sse2;
+        scan_impl = "sse2";
+        return 0;
+    }
+    if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+        scan_byte = scan_byte_scalar;
+        scan_crlf = scan_crlf_avx2;
+        scan_crlfcrlf = scan_crlfcrlf_avx2;
+        scan_impl = "avx2";
+        return 0;
+    }
+#endif
+    return -1;
+}
+
+const char* scan_impl_name()
+{
+    return scan_impl;
+}
+
+/* pick the widest kernels before main() runs, so that pointers never change while reactors use them */
+__attribute__((constructor))
+static void scan_init()
+{
+    if (scan_select("avx2") < 0 && scan_select("sse2") < 0)
+        scan_select("scalar");
+}
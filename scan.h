@@ -0,0 +1,20 @@
+#ifndef SCAN_H
+#define SCAN_H
+#include <stddef.h>
+
+/**
+ * delimiter search kernels used by buffer, every function returns the offset of the first match in [p, p + n), n if none
+ * implementation is chosen once at startup: AVX2 when cpu supports it, SSE2 on other x86-64, scalar elsewhere
+ * (single byte search is memchr() in every implementation)
+ */
+extern size_t (*scan_byte)(const char* p, size_t n, char c);
+extern size_t (*scan_crlf)(const char* p, size_t n);
+extern size_t (*scan_crlfcrlf)(const char* p, size_t n);
+
+/* name of selected implementation, "avx2", "sse2" or "scalar" */
+const char* scan_impl_name();
+
+/* force an implementation by name, for comparing them, return -1 if it's unknown or unsupported by cpu */
+int scan_select(const char* name);
+
+#endif
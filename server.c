@@ -1,4 +1,6 @@
+#define _GNU_SOURCE // accept4
 #include "server.h"
+#include <sys/sysinfo.h>
 
 /* extern struct tcp_connection*
  * tcp_connection_new(int connFd, struct sockaddr* peerAddr, struct event_loop* eventLoop,
@@ -7,7 +9,10 @@
  *         conn_msg_write_call_back connMsgWriteCallBack,
  *         conn_closed_call_back connClosedCallBack); */
 
-static int handle_tcp_connection_established(struct server* server);
+static int handle_tcp_connection_established(struct acceptor* acceptor);
+static int server_accept_connection(struct server* server, struct acceptor* acceptor);
+static void server_listen(struct server* server, struct acceptor* acceptor, struct event_loop* eventLoop);
+static int server_create_reuseport_acceptors(struct server* server);
 static struct event_loop* server_select_eventloop(struct server* server);
 
 struct server*
@@ -26,7 +31,7 @@ server_new(const char* name, int type, int port, int threadNum,
     server = malloc(sizeof(struct server));
     if (server == NULL) goto failed;
     
-    acceptor = acceptor_new(type, port);
+    acceptor = acceptor_new(type, port, 0);
     if (acceptor == NULL) goto failed;
     LOG(LT_INFO, "%s acceptor initialized", name);
 
@@ -47,8 +52,15 @@ server_new(const char* name, int type, int port, int threadNum,
     else
         LOG(LT_INFO, "%s thread pool(%d) initialized", name, threadNum);
 
+    server->type = type;
     server->acceptor = acceptor;
     server->eventLoop = eventLoop;
+    server->mainCpu = AFFINITY_CPU_UNBOUND;
+    server->rtPriority = 0;
+    server->acceptorFlags = 0;
+    server->reusePort = 0;
+    server->incomingCpu = 0;
+    server->reuseportAcceptors = NULL;
 
     server->connEstablishedCallBack = connEstablishedCallBack;
     server->connMsgReadCallBack = connMsgReadCallBack;
@@ -57,6 +69,10 @@ server_new(const char* name, int type, int port, int threadNum,
 
     server->threadPool = threadPool;
     server->threadNum = threadNum;
+    server->zerocopyThreshold = 0;
+    server->edgeTriggered = 0;
+    server->idleTimeout = 0;
+    server->workerPool = NULL;
 
     if (data != NULL) server->data = data;
     else server->data = NULL;
@@ -72,45 +88,214 @@ failed:
     return NULL;
 }
 
+void server_enable_zerocopy(struct server* server, size_t threshold)
+{
+    assertNotNULL(server);
+    server->zerocopyThreshold = threshold;
+}
+
+void server_set_idle_timeout(struct server* server, uint64_t timeout)
+{
+    assertNotNULL(server);
+    server->idleTimeout = timeout;
+}
+
+void server_enable_edge_triggered(struct server* server)
+{
+    assertNotNULL(server);
+    server->edgeTriggered = 1;
+}
+
+int server_enable_ipv6(struct server* server, int dualStack)
+{
+    assertNotNULL(server);
+    int flags = dualStack ? ACCEPTOR_DUALSTACK : ACCEPTOR_IPV6;
+    int port = server->acceptor->listen_port;
+    /* release the ipv4 listening socket first, dual-stack one binds the same port */
+    acceptor_cleanup(server->acceptor);
+    server->acceptor = acceptor_new(server->type, port, flags);
+    if (server->acceptor == NULL) return -1;
+    server->acceptorFlags = flags;
+    return 0;
+}
+
+void server_enable_reuseport(struct server* server, int incomingCpu)
+{
+    assertNotNULL(server);
+    server->reusePort = 1;
+    server->incomingCpu = incomingCpu;
+}
+
+void server_set_affinity(struct server* server, const int* cpus, int ncpu)
+{
+    assertNotNULL(server);
+    if (ncpu <= 0) return;
+    server->mainCpu = cpus[0];
+    if (server->threadPool == NULL) return;
+    int subCpus[server->threadNum];
+    for (int i = 0; i < server->threadNum; i++)
+        subCpus[i] = i + 1 < ncpu ? cpus[i + 1] : AFFINITY_CPU_UNBOUND;
+    thread_pool_set_affinity(server->threadPool, subCpus, server->rtPriority);
+}
+
+int server_use_isolated_cpus(struct server* server)
+{
+    assertNotNULL(server);
+    int isolated[AFFINITY_MAX_CPUS];
+    int n = affinity_isolated_cpus(isolated, AFFINITY_MAX_CPUS);
+    if (n == 0 || server->threadPool == NULL) {
+        LOG(LT_WARN, "no isolated cpu for sub-reactors");
+        return 0;
+    }
+    int subCpus[server->threadNum];
+    for (int i = 0; i < server->threadNum; i++)
+        subCpus[i] = i < n ? isolated[i] : AFFINITY_CPU_UNBOUND;
+    thread_pool_set_affinity(server->threadPool, subCpus, server->rtPriority);
+    return n < server->threadNum ? n : server->threadNum;
+}
+
+void server_set_realtime(struct server* server, int priority)
+{
+    assertNotNULL(server);
+    server->rtPriority = priority;
+    if (server->threadPool != NULL)
+        thread_pool_set_affinity(server->threadPool, NULL, priority);
+}
+
+int server_set_select_policy(struct server* server, int policy, const int* weights)
+{
+    assertNotNULL(server);
+    if (server->threadPool == NULL) return -1;
+    return thread_pool_set_policy(server->threadPool, policy, weights);
+}
+
+int server_enable_workers(struct server* server, int nworker, size_t capacity)
+{
+    assertNotNULL(server);
+    if (server->workerPool != NULL) return 0;
+    server->workerPool = worker_pool_new(nworker, capacity);
+    return server->workerPool != NULL ? 0 : -1;
+}
+
 void server_run(struct server* server)
 {
     assertNotNULL(server);
     assertNotNULL(server->acceptor);
 
+    /* a peer resetting while bytes are written to it must fail that write with EPIPE, not kill the process */
+    signal(SIGPIPE, SIG_IGN);
+
+    /* main-reactor runs in calling thread, its loop is already allocated, buffers taken from now on are local */
+    if (server->mainCpu != AFFINITY_CPU_UNBOUND && affinity_pin_current(server->mainCpu) == 0)
+        affinity_bind_memory_local();
+    if (server->rtPriority > 0)
+        affinity_set_current_realtime(server->rtPriority);
+
     // NOTE: server->threadPool may be NULL if threadNum = 0, thread_pool_run do nothing in this case
     thread_pool_run(server->threadPool);
-    
-    /* register channel for listening fd */
-    struct acceptor* acceptor = server->acceptor;
-    struct channel* chan = channel_new(acceptor->listen_fd, EVENT_READ, handle_tcp_connection_established, NULL, server);
-    /* register EVENT_READ for acceptor->listen_fd to start accepting established client connection */
-    event_loop_add_channel_event(server->eventLoop, chan->fd, chan);
+    worker_pool_run(server->workerPool);
+
+    if (server->reusePort && server->threadPool != NULL && server_create_reuseport_acceptors(server) == 0) {
+        /* sub-reactors accept on their own, main-reactor only keeps running for its timers and wakeups */
+        for (int i = 0; i < server->threadNum; i++)
+            server_listen(server, server->reuseportAcceptors[i], server->threadPool->threads[i].eventLoop);
+    } else {
+        server_listen(server, server->acceptor, server->eventLoop);
+    }
     event_loop_run(server->eventLoop);
 }
 
-/* only used as acceptor EVENT_READ callback */
-static int handle_tcp_connection_established(struct server* server)
+/* register EVENT_READ for acceptor->listen_fd on eventLoop to start accepting established client connection */
+static void server_listen(struct server* server, struct acceptor* acceptor, struct event_loop* eventLoop)
 {
-    assertNotNULL(server);
-    struct acceptor* acceptor = server->acceptor;
+    acceptor->eventLoop = eventLoop;
+    acceptor->data = server;
+    int events = server->edgeTriggered ? EVENT_READ | EVENT_EDGE_TRIGGERED : EVENT_READ;
+    struct channel* chan = channel_new(acceptor->listen_fd, events, handle_tcp_connection_established, NULL, acceptor);
+    event_loop_add_channel_event(eventLoop, chan->fd, chan);
+}
+
+/**
+ * replace the main acceptor by one SO_REUSEPORT listening socket per sub-reactor
+ * the main listening socket is closed first, otherwise it would still own the port and receive connections
+ */
+static int server_create_reuseport_acceptors(struct server* server)
+{
+    int port = server->acceptor->listen_port;
+    struct acceptor** acceptors = calloc(server->threadNum, sizeof(struct acceptor*));
+    if (acceptors == NULL) return -1;
+
+    acceptor_cleanup(server->acceptor);
+    server->acceptor = NULL;
+    for (int i = 0; i < server->threadNum; i++) {
+        acceptors[i] = acceptor_new(server->type, port, server->acceptorFlags | ACCEPTOR_REUSEPORT);
+        if (acceptors[i] == NULL) goto failed;
+        /* prefer the cpu sub-reactor i is pinned to, otherwise expect it to run on cpu i */
+        if (server->incomingCpu) {
+            int cpu = server->threadPool->threads[i].cpu;
+            acceptor_set_incoming_cpu(acceptors[i], cpu != AFFINITY_CPU_UNBOUND ? cpu : i % get_nprocs());
+        }
+    }
+    server->acceptor = acceptors[0];
+    server->reuseportAcceptors = acceptors;
+    LOG(LT_INFO, "%d sub-reactors accepting on port %d with SO_REUSEPORT", server->threadNum, port);
+    return 0;
+
+failed:
+    for (int i = 0; i < server->threadNum; i++)
+        if (acceptors[i] != NULL) acceptor_cleanup(acceptors[i]);
+    free(acceptors);
+    /* fall back to accepting in main-reactor */
+    server->acceptor = acceptor_new(server->type, port, server->acceptorFlags);
+    if (server->acceptor == NULL) LOG(LT_FATAL_ERROR, "failed to listen on port %d again", port);
+    return -1;
+}
 
-    /* TODO: only support ipv4 client addr for now, later support ipv6 */
-    struct sockaddr_in clientaddr;
+/**
+ * only used as acceptor EVENT_READ callback, runs in the thread of acceptor->eventLoop
+ * drains backlog until EAGAIN, at most SERVER_ACCEPT_BUDGET connections per wakeup so that a connection burst can't starve established connections,
+ * level-triggered listening socket is reported again while backlog is not empty, edge-triggered one is activated again next round.
+ */
+static int handle_tcp_connection_established(struct acceptor* acceptor)
+{
+    assertNotNULL(acceptor);
+    struct server* server = acceptor->data;
+
+    for (int i = 0; i < SERVER_ACCEPT_BUDGET; i++) {
+        int ret = server_accept_connection(server, acceptor);
+        if (ret <= 0) return ret;
+    }
+    if (server->edgeTriggered) {
+        struct event_loop* eventLoop = acceptor->eventLoop;
+        event_loop_activate_later(eventLoop, chanmap_get(eventLoop->channelMap, acceptor->listen_fd), EVENT_READ);
+    }
+    return 0;
+}
+
+/* accept one connection and hand it over to a reactor, return 1 if accepted, 0 if none is pending */
+static int server_accept_connection(struct server* server, struct acceptor* acceptor)
+{
+    /* large enough for ipv4 and ipv6 peers */
+    struct sockaddr_storage clientaddr;
     socklen_t addrlen = sizeof(clientaddr);
 
-    int clientfd = accept(acceptor->listen_fd, (SA*)&clientaddr, &addrlen);
-    if (clientfd < 0) {     // may never happen ? not sure
-        LOG(LT_DEBUG, "%s", strerror(errno));
+    /* accepted socket is non-blocking and close-on-exec without extra fcntl() round-trips */
+    int clientfd = accept4(acceptor->listen_fd, (SA*)&clientaddr, &addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (clientfd < 0) {
         if (errno == EWOULDBLOCK || errno == EAGAIN)
             return 0;
+        LOG(LT_DEBUG, "%s", strerror(errno));
+        /* connection aborted before being accepted, try next one */
+        if (errno == ECONNABORTED || errno == EINTR)
+            return 1;
         return -1;
     }
 
-    LOG(LT_INFO, "tcp connection established, socket fd = %d", clientfd);
+    LOG(LT_DEBUG, "tcp connection established, socket fd = %d", clientfd);
 
-    make_nonblocking(clientfd);
-
-    struct event_loop* eventLoop = server_select_eventloop(server);
+    /* SO_REUSEPORT acceptor belongs to a sub-reactor, which handles its connections itself without cross-thread handoff */
+    struct event_loop* eventLoop = acceptor->flags & ACCEPTOR_REUSEPORT ? acceptor->eventLoop : server_select_eventloop(server);
+    acceptor->connAccepted++;
     LOG(LT_DEBUG, "select %s for handling i/o events on connection(fd = %d)", eventLoop->thread_name, clientfd);
 
     struct tcp_connection* tcpConn = tcp_connection_new(clientfd, (SA*)&clientaddr, eventLoop,
@@ -118,18 +303,31 @@ static int handle_tcp_connection_established(struct server* server)
                                                         server->connMsgReadCallBack,
                                                         server->connMsgWriteCallBack,
                                                         server->connClosedCallBack);
-    // register EVENT_READ on connFd
-    event_loop_add_channel_event(tcpConn->eventLoop, clientfd, tcpConn->channel);
+    /* out of memory, drop this peer but keep accepting, next one may fit again */
+    if (tcpConn == NULL) {
+        close(clientfd);
+        return 1;
+    }
+    if (server->zerocopyThreshold > 0)
+        tcp_connection_enable_zerocopy(tcpConn, server->zerocopyThreshold);
+    if (server->edgeTriggered)
+        tcp_connection_set_edge_triggered(tcpConn);
+    if (server->idleTimeout > 0)
+        tcp_connection_set_idle_timeout(tcpConn, server->idleTimeout);
+    tcpConn->workerPool = server->workerPool;
+    /* for callback use, httpserver */
+    tcpConn->data = server->data;
 
-    // NOTE: execute connection established callback
+    // NOTE: execute connection established callback before EVENT_READ is registered,
+    // so that per-connection state it sets up is in place when the owning reactor reads first bytes
     if (tcpConn->connEstablishedCallBack != NULL) {
         tcpConn->connEstablishedCallBack(tcpConn);
     }
 
-    /* for callback use, httpserver */
-    /* tcpConndata = server->data; */
+    // register EVENT_READ on connFd
+    event_loop_add_channel_event(tcpConn->eventLoop, clientfd, tcpConn->channel);
 
-    return 0;
+    return 1;
 }
 
 /* select event loop of certain reactor thread */
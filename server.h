@@ -12,6 +12,12 @@ struct server {
     int type;
     /* acceptor for accepting connections */
     struct acceptor* acceptor;
+    /* ACCEPTOR_IPV6/ACCEPTOR_DUALSTACK of listening sockets */
+    int acceptorFlags;
+    /* SO_REUSEPORT mode: one acceptor per sub-reactor, each accepting in its own thread */
+    int reusePort;
+    int incomingCpu;
+    struct acceptor** reuseportAcceptors;
     /* event loop of main-reactor thread  */
     struct event_loop* eventLoop;
     /* callbacks */
@@ -22,6 +28,17 @@ struct server {
     /* holding sub-reactors thread info */
     struct thread_pool* threadPool;
     int threadNum;
+    /* cpu of main-reactor, AFFINITY_CPU_UNBOUND to leave it unpinned, and SCHED_FIFO priority of reactors, 0 for normal */
+    int mainCpu;
+    int rtPriority;
+    /* connections send queued writes of at least zerocopyThreshold bytes with MSG_ZEROCOPY, 0 to disable */
+    size_t zerocopyThreshold;
+    /* connections idle for idleTimeout ms are closed, 0 to disable */
+    uint64_t idleTimeout;
+    /* listening and connection channels are edge-triggered, see server_enable_edge_triggered() */
+    int edgeTriggered;
+    /* pool connection handlers offload blocking or cpu-heavy jobs to, NULL for none */
+    struct worker_pool* workerPool;
     /* for callback use: httpserver */
     void* data;
 };
@@ -35,6 +52,55 @@ server_new(const char* name, int type, int port, int threadNum,
         conn_closed_call_back connClosedCallBack,
         void* data);
 
+/* enable MSG_ZEROCOPY for connections accepted afterwards, see tcp_connection_enable_zerocopy() */
+void server_enable_zerocopy(struct server* server, size_t threshold);
+
+/* close connections accepted afterwards once they receive nothing for timeout ms, see tcp_connection_set_idle_timeout() */
+void server_set_idle_timeout(struct server* server, uint64_t timeout);
+
+/**
+ * use edge-triggered notification for listening socket and connections accepted afterwards,
+ * must be called before server_run(), only honored by epoll dispatcher, others stay level-triggered
+ */
+void server_enable_edge_triggered(struct server* server);
+
+/**
+ * listen on ipv6 wildcard address instead of ipv4 one, with dualStack ipv4 clients are accepted too as v4-mapped addresses
+ * must be called before server_run(), return -1 if listening socket can't be created
+ */
+int server_enable_ipv6(struct server* server, int dualStack);
+
+/**
+ * let every sub-reactor own a SO_REUSEPORT listening socket and accept locally instead of main-reactor accepting and handing off
+ * with incomingCpu, listening socket of sub-reactor i sets SO_INCOMING_CPU = i so that kernel prefers it for connections received on cpu i,
+ * which only pays off when sub-reactor i runs on cpu i
+ * must be called before server_run(), ignored when server has no sub-reactor
+ */
+void server_enable_reuseport(struct server* server, int incomingCpu);
+
+/**
+ * pin reactors to cpus: cpus[0] for main-reactor, cpus[1..threadNum] for sub-reactors, AFFINITY_CPU_UNBOUND leaves one unpinned
+ * a pinned reactor allocates its loop, buffers and connections from the numa node of its cpu
+ * ncpu < threadNum + 1 leaves the rest unpinned, must be called before server_run()
+ */
+void server_set_affinity(struct server* server, const int* cpus, int ncpu);
+
+/* pin sub-reactors to isolated cpus (kernel isolcpus=) in order, return number of reactors pinned */
+int server_use_isolated_cpus(struct server* server);
+
+/* run reactors with SCHED_FIFO at priority, needs CAP_SYS_NICE, must be called before server_run() */
+void server_set_realtime(struct server* server, int priority);
+
+/* choose how connections are spread over sub-reactors, see thread_pool_set_policy() */
+int server_set_select_policy(struct server* server, int policy, const int* weights);
+
+/**
+ * create a pool of nworker threads with capacity queued jobs each (0 for WORKER_POOL_QUEUE_CAPACITY),
+ * handlers of connections accepted afterwards offload jobs by tcp_connection_submit_work()
+ * must be called before server_run(), return -1 if pool can't be created
+ */
+int server_enable_workers(struct server* server, int nworker, size_t capacity);
+
 /* start a server by registering EVENT_READ on listening fd */
 void server_run(struct server* server);
 
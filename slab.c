@@ -0,0 +1,216 @@
+#include "slab.h"
+#include "log.h"
+#include <string.h>
+
+struct slab* slab_new(size_t objSize, int perChunk)
+{
+    struct slab* slab = calloc(1, sizeof(struct slab));
+    if (slab == NULL) return NULL;
+
+    slab->owner_tid = pthread_self();
+    /* room for the free list link, and a whole number of cache lines */
+    if (objSize < sizeof(void*)) objSize = sizeof(void*);
+    slab->objSize = (objSize + CACHE_LINE_SIZE - 1) & ~(size_t)(CACHE_LINE_SIZE - 1);
+    slab->perChunk = perChunk > 0 ? perChunk : SLAB_OBJECTS_PER_CHUNK;
+    pthread_mutex_init(&slab->sharedLock, NULL);
+    return slab;
+}
+
+static int slab_usable(struct slab* slab)
+{
+    return slab != NULL && pthread_equal(pthread_self(), slab->owner_tid);
+}
+
+/* carve a new chunk into the free list, objects are linked in address order so that consecutive allocations are adjacent */
+static int slab_grow(struct slab* slab)
+{
+    struct slab_chunk* chunk = malloc(sizeof(struct slab_chunk));
+    if (chunk == NULL) return -1;
+    size_t size = slab->objSize * slab->perChunk;
+    chunk->begin = aligned_alloc(CACHE_LINE_SIZE, size);
+    if (chunk->begin == NULL) {
+        free(chunk);
+        return -1;
+    }
+    chunk->end = chunk->begin + size;
+    chunk->next = slab->chunks;
+    slab->chunks = chunk;
+    slab->nchunk++;
+
+    for (char* p = chunk->end - slab->objSize; p >= chunk->begin; p -= slab->objSize) {
+        *(void**)p = slab->freelist;
+        slab->freelist = p;
+    }
+    slab->nfree += slab->perChunk;
+    return 0;
+}
+
+/* whether current thread is the taker, the first other thread allocating becomes it */
+static int slab_is_taker(struct slab* slab)
+{
+    if (!atomic_load_explicit(&slab->hasTaker, memory_order_acquire)) {
+        pthread_mutex_lock(&slab->sharedLock);
+        if (!atomic_load_explicit(&slab->hasTaker, memory_order_relaxed)) {
+            slab->taker_tid = pthread_self();
+            atomic_store_explicit(&slab->hasTaker, 1, memory_order_release);
+        }
+        pthread_mutex_unlock(&slab->sharedLock);
+    }
+    return pthread_equal(pthread_self(), slab->taker_tid);
+}
+
+/* object for another thread: taker pops its batch and refills it with the whole shared list, others pop one under lock */
+static void* slab_alloc_shared(struct slab* slab)
+{
+    void* p;
+    if (slab_is_taker(slab)) {
+        if (slab->taken == NULL) {
+            pthread_mutex_lock(&slab->sharedLock);
+            if (slab->shared != NULL) {
+                slab->taken = slab->shared;
+                slab->ntaken = slab->nshared;
+                slab->sharedHits += slab->nshared;
+                slab->shared = NULL;
+                slab->nshared = 0;
+            } else {
+                slab->sharedMisses++;
+            }
+            pthread_mutex_unlock(&slab->sharedLock);
+        }
+        if ((p = slab->taken) != NULL) {
+            slab->taken = *(void**)p;
+            slab->ntaken--;
+        }
+    } else {
+        pthread_mutex_lock(&slab->sharedLock);
+        if ((p = slab->shared) != NULL) {
+            slab->shared = *(void**)p;
+            slab->nshared--;
+            slab->sharedHits++;
+        } else {
+            slab->sharedMisses++;
+        }
+        pthread_mutex_unlock(&slab->sharedLock);
+    }
+    if (p == NULL && (p = aligned_alloc(CACHE_LINE_SIZE, slab->objSize)) == NULL) return NULL;
+    atomic_fetch_add_explicit(&slab->nforeign, 1, memory_order_relaxed);
+    return p;
+}
+
+void* slab_alloc(struct slab* slab)
+{
+    void* p;
+    if (!slab_usable(slab)) {
+        if ((p = slab_alloc_shared(slab)) == NULL) return NULL;
+    } else {
+        if (slab->freelist != NULL) {
+            slab->hits++;
+        } else {
+            slab->misses++;
+            if (slab_grow(slab) < 0) return NULL;
+        }
+        p = slab->freelist;
+        slab->freelist = *(void**)p;
+        slab->nfree--;
+    }
+    memset(p, 0, slab->objSize);
+    return p;
+}
+
+/* count one object of other threads as owed back, 0 if they hold none */
+static int slab_owe(struct slab* slab)
+{
+    size_t n = atomic_load_explicit(&slab->nforeign, memory_order_relaxed);
+    while (n > 0) {
+        if (atomic_compare_exchange_weak_explicit(&slab->nforeign, &n, n - 1, memory_order_relaxed, memory_order_relaxed))
+            return 1;
+    }
+    return 0;
+}
+
+/* put objects owed by owner on the shared list, under one lock */
+static void slab_flush_owed(struct slab* slab)
+{
+    void* last = slab->owed;
+    while (*(void**)last != NULL) last = *(void**)last;
+    pthread_mutex_lock(&slab->sharedLock);
+    *(void**)last = slab->shared;
+    slab->shared = slab->owed;
+    slab->nshared += slab->nowed;
+    pthread_mutex_unlock(&slab->sharedLock);
+    slab->owed = NULL;
+    slab->nowed = 0;
+}
+
+void slab_free(struct slab* slab, void* p)
+{
+    if (p == NULL) return;
+    /* object of another thread released by it, e.g. connection failed before registration */
+    if (!slab_usable(slab)) {
+        slab_owe(slab); // kept even if owner already owed one in its place, never dropped
+        if (slab_is_taker(slab)) {
+            *(void**)p = slab->taken;
+            slab->taken = p;
+            slab->ntaken++;
+            return;
+        }
+        pthread_mutex_lock(&slab->sharedLock);
+        *(void**)p = slab->shared;
+        slab->shared = p;
+        slab->nshared++;
+        pthread_mutex_unlock(&slab->sharedLock);
+        return;
+    }
+    if (slab_owe(slab)) {
+        *(void**)p = slab->owed;
+        slab->owed = p;
+        if (++slab->nowed >= SLAB_SHARED_BATCH) slab_flush_owed(slab);
+        return;
+    }
+    *(void**)p = slab->freelist;
+    slab->freelist = p;
+    slab->nfree++;
+}
+
+void slab_show_stats(struct slab* slab, const char* name)
+{
+    if (slab == NULL) return;
+    pthread_mutex_lock(&slab->sharedLock);
+    LOG(LT_INFO, "%s slab: hits = %lu, misses = %lu, chunks = %lu, free = %zu objects of %zu bytes, "
+        "shared hits = %lu, shared misses = %lu, shared free = %zu, owed = %zu",
+        name, slab->hits, slab->misses, slab->nchunk, slab->nfree, slab->objSize,
+        slab->sharedHits, slab->sharedMisses, slab->nshared, slab->nowed);
+    pthread_mutex_unlock(&slab->sharedLock);
+}
+
+static int slab_owns(struct slab* slab, void* p)
+{
+    for (struct slab_chunk* chunk = slab->chunks; chunk != NULL; chunk = chunk->next) {
+        if ((char*)p >= chunk->begin && (char*)p < chunk->end) return 1;
+    }
+    return 0;
+}
+
+void slab_cleanup(struct slab* slab)
+{
+    if (slab == NULL) return;
+    /* objects allocated by other threads are not part of any chunk, they may be on any list */
+    void* lists[4] = { slab->freelist, slab->owed, slab->shared, slab->taken };
+    for (int i = 0; i < 4; i++) {
+        void* p = lists[i];
+        while (p != NULL) {
+            void* next = *(void**)p;
+            if (!slab_owns(slab, p)) free(p);
+            p = next;
+        }
+    }
+    struct slab_chunk* chunk = slab->chunks;
+    while (chunk != NULL) {
+        struct slab_chunk* next = chunk->next;
+        free(chunk->begin);
+        free(chunk);
+        chunk = next;
+    }
+    pthread_mutex_destroy(&slab->sharedLock);
+    free(slab);
+}
@@ -0,0 +1,76 @@
+#ifndef SLAB_H
+#define SLAB_H
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include "mpsc_queue.h" // CACHE_LINE_SIZE
+
+#define SLAB_OBJECTS_PER_CHUNK 64
+#define SLAB_SHARED_BATCH 16 // objects owed to other threads put on the shared list under one lock
+
+/* objects carved from one cache-line-aligned allocation, kept until the slab is freed */
+struct slab_chunk {
+    struct slab_chunk* next;
+    char* begin;
+    char* end;
+};
+
+/**
+ * fixed-size object allocator owned by one event_loop, non-thread-safe
+ * - objects are rounded up to whole cache lines and start on a cache line, neighbours never share one;
+ * - owner thread takes objects from the free list, refilled perChunk objects at a time from one allocation;
+ * - the first other thread allocating (main-reactor accepting for a sub-reactor) becomes the taker: it moves the
+ *   whole shared list to its own batch under one lock and hands objects out of the batch without locking,
+ *   it makes a single aligned allocation when both are empty. other threads take objects one by one under the lock;
+ * - as many objects as other threads hold are owed back to them when released, the rest go to the free list,
+ *   so that a loop whose connections are all allocated by another thread recycles them instead of piling them up.
+ *   owner collects what it owes in a batch and puts it on the shared list under one lock every SLAB_SHARED_BATCH objects;
+ * - released objects are kept, chunks are only given back by slab_cleanup().
+ * an object carved from a chunk must be released by the owner thread, or go back to the shared list.
+ */
+struct slab {
+    pthread_t owner_tid;
+    size_t objSize;
+    int perChunk;
+    void* freelist;
+    size_t nfree;
+    void* owed;                 // objects released by owner for other threads, not yet on shared list
+    size_t nowed;
+    struct slab_chunk* chunks;
+
+    pthread_mutex_t sharedLock; // guards the fields below
+    void* shared;               // free objects for other threads
+    size_t nshared;
+    atomic_size_t nforeign;     // objects held by other threads not owed back yet, changed without lock
+    atomic_int hasTaker;        // taker is set, once under sharedLock
+
+    /* only used by taker thread */
+    pthread_t taker_tid;
+    void* taken;                // batch moved off the shared list
+    size_t ntaken;
+
+    /* statistics, only updated by owner thread */
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long nchunk;
+    /* statistics of other threads, under sharedLock */
+    unsigned long sharedHits;   // objects moved off the shared list
+    unsigned long sharedMisses; // allocations finding it empty
+};
+
+/* create a slab owned by current thread for objects of objSize bytes */
+struct slab* slab_new(size_t objSize, int perChunk);
+
+/* allocate one zeroed object, NULL if out of memory */
+void* slab_alloc(struct slab* slab);
+
+/* release object allocated by slab_alloc */
+void slab_free(struct slab* slab, void* p);
+
+/* log hit/miss counters and free objects */
+void slab_show_stats(struct slab* slab, const char* name);
+
+/* free every chunk, objects of other threads on both lists and the slab itself, objects in use become invalid */
+void slab_cleanup(struct slab* slab);
+
+#endif
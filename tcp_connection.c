@@ -1,6 +1,14 @@
 #include "tcp_connection.h"
+#include <sys/sendfile.h>
 
-static void tcp_connection_set_peeraddr(struct tcp_connection* tcpConn, const struct sockaddr* peerAddr);
+static void tcp_connection_set_peeraddr(struct tcp_connection* tcpConn, struct sockaddr_storage* storage, const struct sockaddr* peerAddr);
+static ssize_t tcp_connection_read_edge_triggered(struct tcp_connection* tcpConn);
+static int tcp_connection_can_write_directly(struct tcp_connection* tcpConn);
+static int handle_tcp_connection_idle(struct tcp_connection* tcpConn);
+static void tcp_connection_account_queued(struct tcp_connection* tcpConn, size_t before);
+static void tcp_connection_wait_writable(struct tcp_connection* tcpConn);
+static void tcp_connection_linger_zerocopy(struct tcp_connection* tcpConn);
+static int handle_tcp_connection_linger(struct tcp_connection* tcpConn);
 
 struct tcp_connection*
 tcp_connection_new(int connFd, struct sockaddr* peerAddr, struct event_loop* eventLoop,
@@ -12,20 +20,27 @@ tcp_connection_new(int connFd, struct sockaddr* peerAddr, struct event_loop* eve
     assert(connFd > 0);
     assert(eventLoop != NULL);
 
-    struct tcp_connection* tcpConn = malloc(sizeof(struct tcp_connection));
-    if (tcpConn == NULL) goto failed;
+    /* zeroed block from the loop slab, or a fresh one adopted by the slab on close when accepting thread is not the owner */
+    struct tcp_connection_block* block = slab_alloc(eventLoop->connSlab);
+    if (block == NULL) {
+        LOG(LT_WARN, "failed to new tcp connection for socket fd %d", connFd);
+        return NULL;
+    }
     
+    struct tcp_connection* tcpConn = &block->conn;
     tcpConn->eventLoop = eventLoop;
+    tcpConn->refCount = 1;
 
-    struct channel* chan = channel_new(connFd, EVENT_READ, handle_tcp_connection_read, handle_tcp_connection_write, tcpConn);
-    if (chan == NULL) goto failed;
-    tcpConn->channel = chan;
+    channel_init(&block->channel, connFd, EVENT_READ, handle_tcp_connection_read, handle_tcp_connection_write, tcpConn);
+    tcpConn->channel = &block->channel;
 
-    tcp_connection_set_peeraddr(tcpConn, peerAddr);
+    tcp_connection_set_peeraddr(tcpConn, &block->peerAddr, peerAddr);
 
-    tcpConn->inBuffer = buffer_new();
+    /* buffer storage comes from the pool of the loop handling this connection, allocated lazily by its thread */
+    tcpConn->inBuffer = buffer_new_with_pool(eventLoop->bufferPool);
     if (tcpConn->inBuffer == NULL) goto failed;
-    tcpConn->outBuffer = buffer_new();
+    /* output buffer is chained so that queued bytes are never moved when a large response keeps growing */
+    tcpConn->outBuffer = buffer_chain_new(eventLoop->bufferPool);
     if (tcpConn->outBuffer == NULL) goto failed;
 
     tcpConn->connEstablishedCallBack = connEstablishedCallBack;
@@ -33,32 +48,34 @@ tcp_connection_new(int connFd, struct sockaddr* peerAddr, struct event_loop* eve
     tcpConn->connMsgWriteCallBack = connMsgWriteCallBack;
     tcpConn->connClosedCallBack = connClosedCallBack;
 
+    /* counted at once by the accepting thread, so that a burst accepted before the loop registers it doesn't pile on one loop */
+    if (eventLoop->load != NULL) {
+        atomic_fetch_add_explicit(&eventLoop->load->activeConns, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&eventLoop->load->connHandled, 1, memory_order_relaxed);
+    }
 
     return tcpConn;
 
 failed:
-    // TODO: then how to deal with this failed connection
+    /* connFd stays open, caller decides what to do with it */
     LOG(LT_WARN, "failed to new tcp connection for socket fd %d", connFd);
     if (tcpConn->inBuffer != NULL) buffer_cleanup(tcpConn->inBuffer);
     if (tcpConn->outBuffer != NULL) buffer_cleanup(tcpConn->outBuffer);
-    if (tcpConn->channel != NULL) free(tcpConn->channel);
-    if (tcpConn->peerAddr != NULL) free(tcpConn->peerAddr);
-    if (tcpConn != NULL) free(tcpConn);
+    slab_free(eventLoop->connSlab, block);
     return NULL;
 }
 
-static void tcp_connection_set_peeraddr(struct tcp_connection* tcpConn, const struct sockaddr* peerAddr)
+/* copy peer address into storage inlined in connection block */
+static void tcp_connection_set_peeraddr(struct tcp_connection* tcpConn, struct sockaddr_storage* storage, const struct sockaddr* peerAddr)
 {
-    struct sockaddr* addr;
+    struct sockaddr* addr = (struct sockaddr*)storage;
     sa_family_t addrFamily = peerAddr->sa_family;
     /* ipv4, ipv6 supported */
     switch(addrFamily) {
         case AF_INET:
-            addr = malloc(sizeof(struct sockaddr_in));
             memcpy(addr, peerAddr, sizeof(struct sockaddr_in));
             break;
         case AF_INET6:
-            addr = malloc(sizeof(struct sockaddr_in6));
             memcpy(addr, peerAddr, sizeof(struct sockaddr_in6));
             break;
         default:
@@ -71,10 +88,28 @@ static void tcp_connection_set_peeraddr(struct tcp_connection* tcpConn, const st
 ssize_t handle_tcp_connection_read(struct tcp_connection* tcpConn)
 {
     struct buffer* inBuffer = tcpConn->inBuffer;
-    if (buffer_read_fd(inBuffer, tcpConn->channel->fd) > 0) {
+    struct buffer* outBuffer = tcpConn->outBuffer;
+    int fd = tcpConn->channel->fd;
+
+    /* zerocopy completions arrive on error queue, which is reported as EPOLLERR and dispatched as EVENT_READ */
+    if (outBuffer->zerocopyThreshold > 0 || buffer_zerocopy_pending(outBuffer))
+        buffer_zerocopy_complete(outBuffer, fd);
+
+    /* peer is alive, push idle deadline back */
+    if (tcpConn->idleTimeout > 0)
+        channel_timeout_enable(tcpConn->eventLoop, tcpConn->channel, tcpConn->idleTimeout, (event_timeout_callback)handle_tcp_connection_idle);
+
+    if (channel_is_edge_triggered(tcpConn->channel))
+        return tcp_connection_read_edge_triggered(tcpConn);
+
+    ssize_t n = buffer_read_fd(inBuffer, fd);
+    if (n > 0) {
         /* excute connection read callback */
         if (tcpConn->connMsgReadCallBack != NULL)
             tcpConn->connMsgReadCallBack(tcpConn);
+    } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        /* woken up by error queue only */
+        return 0;
     } else {
         /* NOTE: read EOF or error occured */
         handle_tcp_connection_closed(tcpConn);
@@ -82,6 +117,43 @@ ssize_t handle_tcp_connection_read(struct tcp_connection* tcpConn)
     return 0;
 }
 
+/**
+ * no new edge is reported while unread bytes stay in socket, so read until EAGAIN,
+ * but at most TCP_READ_BUDGET bytes per wakeup to keep one busy connection from starving the others,
+ * a connection stopped by budget is activated again in next loop round.
+ */
+static ssize_t tcp_connection_read_edge_triggered(struct tcp_connection* tcpConn)
+{
+    struct buffer* inBuffer = tcpConn->inBuffer;
+    int fd = tcpConn->channel->fd;
+    size_t total = 0;
+
+    for (;;) {
+        ssize_t n = buffer_read_fd(inBuffer, fd);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            /* NOTE: read EOF or error occured, deliver bytes read so far before closing */
+            if (total > 0 && tcpConn->connMsgReadCallBack != NULL)
+                tcpConn->connMsgReadCallBack(tcpConn);
+            handle_tcp_connection_closed(tcpConn);
+            return 0;
+        }
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;  // drained
+        }
+        total += n;
+        if (total >= TCP_READ_BUDGET) {
+            event_loop_activate_later(tcpConn->eventLoop, tcpConn->channel, EVENT_READ);
+            break;
+        }
+    }
+
+    /* excute connection read callback */
+    if (total > 0 && tcpConn->connMsgReadCallBack != NULL)
+        tcpConn->connMsgReadCallBack(tcpConn);
+    return total;
+}
+
 ssize_t handle_tcp_connection_write(struct tcp_connection* tcpConn)
 {
     struct event_loop* eventLoop = tcpConn->eventLoop;
@@ -91,17 +163,31 @@ ssize_t handle_tcp_connection_write(struct tcp_connection* tcpConn)
     struct buffer* outBuffer = tcpConn->outBuffer;
     struct channel* chan = tcpConn->channel;
 
-    size_t nleft = buffer_readable_size(outBuffer);
-    /* write as much bytes as it can, non-blocking */
-    ssize_t nwritten = write(chan->fd, &outBuffer->data[outBuffer->readIdx], nleft);
+    /* release blocks of completed zerocopy sends, for dispatchers not reporting error queue */
+    if (buffer_zerocopy_pending(outBuffer))
+        buffer_zerocopy_complete(outBuffer, chan->fd);
+
+    /* write as much bytes as it can, non-blocking, gathering queued blocks by writev() and file regions by sendfile() */
+    size_t queued = buffer_readable_size(outBuffer);
+    if (queued == 0) {
+        /* deferred activations are keyed by fd, which may belong to a newer connection by now: only answer one asked for */
+        if (tcpConn->wantWritable) {
+            tcpConn->wantWritable = 0;
+            if (tcpConn->connMsgWriteCallBack != NULL)
+                tcpConn->connMsgWriteCallBack(tcpConn);
+        }
+        return 0;
+    }
+    ssize_t nwritten = buffer_write_fd(outBuffer, chan->fd);
     if (nwritten > 0) {
-        outBuffer->readIdx += nwritten;
+        tcp_connection_account_queued(tcpConn, queued);
         /* if there is no readable byte in buffer, remove EVENT_WRITE on corresponding channel */
         if (buffer_readable_size(outBuffer) == 0) {
-            channel_write_event_disable(chan);
+            channel_write_event_disable(eventLoop, chan);
         }
 
-        /* excute connection write callback */
+        /* excute connection write callback, it covers a pending tcp_connection_want_writable() too */
+        tcpConn->wantWritable = 0;
         if (tcpConn->connMsgWriteCallBack != NULL)
             tcpConn->connMsgWriteCallBack(tcpConn);
     }
@@ -120,6 +206,8 @@ int handle_tcp_connection_closed(struct tcp_connection* tcpConn)
     assert(tcpConn != NULL);
     struct event_loop* eventLoop = tcpConn->eventLoop;
     assertInOwnerThread(eventLoop);
+    if (tcpConn->closed) return 0;
+    tcpConn->closed = 1;
 
     struct channel* chan = tcpConn->channel;
     /* remove registered fd event */
@@ -131,12 +219,114 @@ int handle_tcp_connection_closed(struct tcp_connection* tcpConn)
     if (tcpConn->connClosedCallBack != NULL) {
         tcpConn->connClosedCallBack(tcpConn);
     }
-    // TODO: figure out what work should be done to clean up close connection?
-    close(tcpConn->channel->fd);
-    free(tcpConn);
+    if (eventLoop->load != NULL) {
+        atomic_fetch_sub_explicit(&eventLoop->load->activeConns, 1, memory_order_relaxed);
+        atomic_fetch_sub_explicit(&eventLoop->load->queuedBytes, buffer_readable_size(tcpConn->outBuffer), memory_order_relaxed);
+    }
+    /* give buffer storage back to the loop pool, in the thread owning it */
+    buffer_cleanup(tcpConn->inBuffer);
+    /* unsent bytes are dropped, blocks pinned by zerocopy sends in flight move to the pending list */
+    buffer_drain(tcpConn->outBuffer, buffer_readable_size(tcpConn->outBuffer));
+    if (buffer_zerocopy_pending(tcpConn->outBuffer))
+        buffer_zerocopy_complete(tcpConn->outBuffer, chan->fd);
+    if (buffer_zerocopy_pending(tcpConn->outBuffer)) {
+        tcp_connection_linger_zerocopy(tcpConn);
+    } else {
+        close(chan->fd);
+        buffer_cleanup(tcpConn->outBuffer);
+    }
+    tcpConn->inBuffer = NULL;
+    tcpConn->outBuffer = NULL;
+    /* unfinished jobs still hold the connection */
+    tcp_connection_release(tcpConn);
     return 0;
 }
 
+/**
+ * kernel may still read blocks sent with MSG_ZEROCOPY after close(), and their storage would be reused meanwhile:
+ * peer is told the connection is over, but socket and blocks are kept, holding the connection,
+ * until every completion is read from the socket error queue, which is polled since the channel is gone.
+ */
+static void tcp_connection_linger_zerocopy(struct tcp_connection* tcpConn)
+{
+    shutdown(tcpConn->channel->fd, SHUT_RDWR);
+    tcpConn->zcLinger = tcpConn->outBuffer;
+    timer_init(&tcpConn->zcTimer, (timer_callback)handle_tcp_connection_linger, tcpConn);
+    tcp_connection_hold(tcpConn);
+    event_loop_add_timer(tcpConn->eventLoop, &tcpConn->zcTimer, TCP_ZEROCOPY_LINGER_POLL, 0);
+}
+
+static int handle_tcp_connection_linger(struct tcp_connection* tcpConn)
+{
+    int fd = tcpConn->channel->fd;
+    buffer_zerocopy_complete(tcpConn->zcLinger, fd);
+    if (buffer_zerocopy_pending(tcpConn->zcLinger)) {
+        event_loop_add_timer(tcpConn->eventLoop, &tcpConn->zcTimer, TCP_ZEROCOPY_LINGER_POLL, 0);
+        return 0;
+    }
+    close(fd);
+    buffer_cleanup(tcpConn->zcLinger);
+    tcpConn->zcLinger = NULL;
+    tcp_connection_release(tcpConn);
+    return 0;
+}
+
+void tcp_connection_hold(struct tcp_connection* tcpConn)
+{
+    assertInOwnerThread(tcpConn->eventLoop);
+    tcpConn->refCount++;
+}
+
+void tcp_connection_release(struct tcp_connection* tcpConn)
+{
+    assertInOwnerThread(tcpConn->eventLoop);
+    assert(tcpConn->refCount > 0);
+    if (--tcpConn->refCount > 0) return;
+    assert(tcpConn->closed);
+    /* channel and peer address live in the same block */
+    slab_free(tcpConn->eventLoop->connSlab, tcpConn);
+}
+
+int tcp_connection_is_closed(struct tcp_connection* tcpConn)
+{
+    return tcpConn->closed;
+}
+
+int tcp_connection_submit_work(struct tcp_connection* tcpConn, struct work* work)
+{
+    if (tcpConn->workerPool == NULL || tcpConn->closed) return -1;
+    work->eventLoop = tcpConn->eventLoop;
+    work->tcpConn = tcpConn;
+    tcp_connection_hold(tcpConn);
+    if (worker_pool_submit(tcpConn->workerPool, work) < 0) {
+        work->tcpConn = NULL;
+        tcp_connection_release(tcpConn);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * nothing queued and socket not known to be full, so bytes can go to socket right away
+ * edge-triggered channel keeps EVENT_WRITE registered, an empty outBuffer alone tells that socket is not full
+ */
+static int tcp_connection_can_write_directly(struct tcp_connection* tcpConn)
+{
+    if (tcpConn->corked) return 0;
+    if (buffer_readable_size(tcpConn->outBuffer) > 0) return 0;
+    return channel_is_edge_triggered(tcpConn->channel) || !channel_write_event_is_enabled(tcpConn->channel);
+}
+
+/* report change of outBuffer size since it held before bytes to loop load counters */
+static void tcp_connection_account_queued(struct tcp_connection* tcpConn, size_t before)
+{
+    struct event_loop_load* load = tcpConn->eventLoop->load;
+    if (load == NULL) return;
+    long delta = (long)buffer_readable_size(tcpConn->outBuffer) - (long)before;
+    if (delta != 0)
+        atomic_fetch_add_explicit(&load->queuedBytes, delta, memory_order_relaxed);
+}
+
 /**
  * NOTE
  * - when EVENT_WRITE on chan->fd is off(indicating that write() will not block) and outBuffer is empty, directy write to socket out buffer.
@@ -149,13 +339,15 @@ int handle_tcp_connection_closed(struct tcp_connection* tcpConn)
 ssize_t tcp_connection_send(struct tcp_connection* tcpConn, void* data, size_t size)
 {
     size_t nleft = size;
-    size_t nwritten = 0;
+    ssize_t nwritten = 0;
     int error = 0;
 
+    if (tcpConn->closed) return -1;
+
     struct buffer* outBuffer = tcpConn->outBuffer;
     struct channel* chan = tcpConn->channel;
 
-    if (!channel_write_event_is_enabled(chan) && buffer_readable_size(outBuffer) == 0) {
+    if (tcp_connection_can_write_directly(tcpConn)) {
         nwritten = write(chan->fd, data, size);
         if (nwritten >= 0) {
             nleft -= nwritten;
@@ -171,26 +363,198 @@ ssize_t tcp_connection_send(struct tcp_connection* tcpConn, void* data, size_t s
 
     /* no error occured and left bytes to be sent, hand over to framework */
     if (!error && nleft > 0) {
-        buffer_append(outBuffer, data + nwritten, nleft);
-        if (!channel_write_event_is_enabled(chan))
-            channel_write_event_enable(chan);
+        size_t queued = buffer_readable_size(outBuffer);
+        buffer_append(outBuffer, (char*)data + nwritten, nleft);
+        tcp_connection_account_queued(tcpConn, queued);
+        tcp_connection_wait_writable(tcpConn);
     }
 
     // NOTE: return value seems to be useless
     return nwritten;
 }
 
+/* every readable byte of buff is either sent or handed over to outBuffer, so buff is drained entirely */
 ssize_t tcp_connection_send_buffer(struct tcp_connection* tcpConn, struct buffer* buff)
 {
-    size_t size = buffer_readable_size(buff);
-    // TODO: tcp_connection_send() return bytes already being sent?
-    size_t nwritten = tcp_connection_send(tcpConn, buff->data + buff->readIdx, size);
-    buff->readIdx += nwritten;
+    if (tcpConn->closed) return -1;
+    if (buff->mode == BUFFER_MODE_CHAIN) {
+        /* hand blocks over to outBuffer without copying, then write what socket can take now */
+        struct buffer* outBuffer = tcpConn->outBuffer;
+        struct channel* chan = tcpConn->channel;
+        int idle = tcp_connection_can_write_directly(tcpConn);
+        size_t queued = buffer_readable_size(outBuffer);
+        ssize_t nwritten = 0;
+        buffer_move(outBuffer, buff);
+        if (idle && (nwritten = buffer_write_fd(outBuffer, chan->fd)) < 0)
+            nwritten = 0;
+        tcp_connection_account_queued(tcpConn, queued);
+        if (buffer_readable_size(outBuffer) > 0)
+            tcp_connection_wait_writable(tcpConn);
+        return nwritten;
+    }
+
+    ssize_t nwritten = 0;
+    size_t len;
+    char* data;
+    while ((data = buffer_peek(buff, &len)) != NULL && len > 0) {
+        nwritten += tcp_connection_send(tcpConn, data, len);
+        buffer_drain(buff, len);
+    }
+    return nwritten;
+}
+
+ssize_t tcp_connection_send_shared(struct tcp_connection* tcpConn, const void* data, size_t size,
+    buffer_release_callback release, void* arg)
+{
+    struct buffer* outBuffer = tcpConn->outBuffer;
+    ssize_t nwritten = 0;
+
+    if (tcpConn->closed) {
+        if (release != NULL) release(arg);
+        return -1;
+    }
+    if (tcp_connection_can_write_directly(tcpConn)) {
+        nwritten = write(tcpConn->channel->fd, data, size);
+        if (nwritten < 0) {
+            nwritten = 0;
+            if (errno == EPIPE || errno == ECONNRESET) {
+                if (release != NULL) release(arg);
+                return 0;
+            }
+        }
+    }
+
+    /* left bytes are queued by reference, not copied */
+    if ((size_t)nwritten < size) {
+        size_t queued = buffer_readable_size(outBuffer);
+        buffer_append_shared(outBuffer, (const char*)data + nwritten, size - nwritten, release, arg);
+        tcp_connection_account_queued(tcpConn, queued);
+        tcp_connection_wait_writable(tcpConn);
+    } else if (release != NULL) {
+        release(arg);
+    }
     return nwritten;
 }
 
+ssize_t tcp_connection_sendfile(struct tcp_connection* tcpConn, int fd, off_t offset, size_t len)
+{
+    return tcp_connection_sendfile_shared(tcpConn, fd, offset, len, NULL, NULL);
+}
+
+ssize_t tcp_connection_sendfile_shared(struct tcp_connection* tcpConn, int fd, off_t offset, size_t len,
+    buffer_release_callback release, void* arg)
+{
+    struct buffer* outBuffer = tcpConn->outBuffer;
+    struct channel* chan = tcpConn->channel;
+    ssize_t nwritten = 0;
+
+    if (tcpConn->closed) {
+        if (release != NULL) release(arg);
+        return -1;
+    }
+    /* nothing queued, same as tcp_connection_send(), try to send directly */
+    if (tcp_connection_can_write_directly(tcpConn)) {
+        off_t off = offset;
+        nwritten = sendfile(chan->fd, fd, &off, len);
+        if (nwritten < 0) {
+            nwritten = 0;
+            if (errno == EPIPE || errno == ECONNRESET) {
+                if (release != NULL) release(arg);
+                return 0;
+            }
+        }
+    }
+
+    if ((size_t)nwritten < len) {
+        size_t queued = buffer_readable_size(outBuffer);
+        buffer_append_file_shared(outBuffer, fd, offset + nwritten, len - nwritten, release, arg);
+        tcp_connection_account_queued(tcpConn, queued);
+        tcp_connection_wait_writable(tcpConn);
+    } else if (release != NULL) {
+        release(arg);
+    }
+    return nwritten;
+}
+
+/* let write callback send what is left in outBuffer, corked bytes wait for tcp_connection_uncork() instead */
+static void tcp_connection_wait_writable(struct tcp_connection* tcpConn)
+{
+    struct channel* chan = tcpConn->channel;
+    if (!tcpConn->corked && !channel_write_event_is_enabled(chan))
+        channel_write_event_enable(tcpConn->eventLoop, chan);
+}
+
+void tcp_connection_cork(struct tcp_connection* tcpConn)
+{
+    if (tcpConn->corked) return;
+    tcpConn->corkWritable = tcp_connection_can_write_directly(tcpConn);
+    tcpConn->corked = 1;
+}
+
+ssize_t tcp_connection_uncork(struct tcp_connection* tcpConn)
+{
+    if (!tcpConn->corked) return 0;
+    tcpConn->corked = 0;
+    if (tcpConn->closed) return -1;
+
+    struct buffer* outBuffer = tcpConn->outBuffer;
+    size_t queued = buffer_readable_size(outBuffer);
+    if (queued == 0) return 0;
+
+    /* socket full before corking: bytes queued behind earlier ones, write callback sends them all */
+    ssize_t nwritten = 0;
+    if (tcpConn->corkWritable && (nwritten = buffer_write_fd(outBuffer, tcpConn->channel->fd)) < 0)
+        nwritten = 0;
+    tcp_connection_account_queued(tcpConn, queued);
+    if (buffer_readable_size(outBuffer) > 0)
+        tcp_connection_wait_writable(tcpConn);
+    return nwritten;
+}
+
+void tcp_connection_set_idle_timeout(struct tcp_connection* tcpConn, uint64_t timeout)
+{
+    tcpConn->idleTimeout = timeout;
+    if (timeout > 0)
+        channel_timeout_enable(tcpConn->eventLoop, tcpConn->channel, timeout, (event_timeout_callback)handle_tcp_connection_idle);
+    else
+        channel_timeout_disable(tcpConn->eventLoop, tcpConn->channel);
+}
+
+/* EVENT_TIMEOUT callback, nothing received within idleTimeout */
+static int handle_tcp_connection_idle(struct tcp_connection* tcpConn)
+{
+    LOG(LT_DEBUG, "connection(fd = %d) idle for %lu ms, closing", tcpConn->channel->fd, (unsigned long)tcpConn->idleTimeout);
+    handle_tcp_connection_closed(tcpConn);
+    return 0;
+}
+
+void tcp_connection_want_writable(struct tcp_connection* tcpConn)
+{
+    assertInOwnerThread(tcpConn->eventLoop);
+    if (tcpConn->closed) return;
+    tcpConn->wantWritable = 1;
+    event_loop_activate_later(tcpConn->eventLoop, tcpConn->channel, EVENT_WRITE);
+}
+
+void tcp_connection_set_edge_triggered(struct tcp_connection* tcpConn)
+{
+    tcpConn->channel->events |= EVENT_EDGE_TRIGGERED | EVENT_WRITE;
+}
+
+int tcp_connection_enable_zerocopy(struct tcp_connection* tcpConn, size_t threshold)
+{
+    int on = 1;
+    if (setsockopt(tcpConn->channel->fd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) < 0) {
+        LOG(LT_WARN, "failed to enable zerocopy on socket(fd = %d) %s", tcpConn->channel->fd, strerror(errno));
+        return -1;
+    }
+    tcpConn->outBuffer->zerocopyThreshold = threshold;
+    return 0;
+}
+
 void tcp_connection_shutdown(struct tcp_connection* tcpConn)
 {
+    if (tcpConn->closed) return;
     if (shutdown(tcpConn->channel->fd, SHUT_WR) < 0) {
         // TODO: how to handle shutdown failure
         LOG(LT_WARN, "failed to shutdown socket(fd = %d) %s", tcpConn->channel->fd, strerror(errno));
@@ -2,6 +2,18 @@
 #define TCP_CONNECTION_H
 #include "channel.h"
 #include "event_loop.h"
+#include "worker_pool.h"
+
+/**
+ * default size from which queued bytes are sent with MSG_ZEROCOPY, measured by test/bench_zerocopy:
+ * - on loopback there is no crossover, kernel copies anyway and completions cost extra,
+ *   zerocopy runs at 0.57x of writev() for 4KB writes and 0.64-0.73x from 16KB to 1MB, so keep it off for local peers;
+ * - toward a remote peer pinning saves the copy, which only outweighs page pinning and completion handling
+ *   for large writes, 64KB is the kernel guidance, run the bench against a sink behind the actual NIC to tune it.
+ */
+#define TCP_ZEROCOPY_THRESHOLD (64 << 10)
+#define TCP_READ_BUDGET (256 << 10)       // max bytes read from one edge-triggered connection per wakeup
+#define TCP_ZEROCOPY_LINGER_POLL 100      // ms between error queue reads of a closed connection waiting for zerocopy completions
 
 struct tcp_connection;
 
@@ -14,10 +26,19 @@ typedef int (*conn_closed_call_back)(struct tcp_connection* tcpConn);
 struct tcp_connection {
     struct event_loop* eventLoop; // event loop handling this connection
     struct channel* channel;      // conn fd and interested event
-    struct sockaddr* peerAddr;  // store peer address
+    struct sockaddr* peerAddr;    // store peer address, NULL for unsupported address family
 
     struct buffer* inBuffer;  // application-level input buffer
     struct buffer* outBuffer; // application-level output buffer
+    uint64_t idleTimeout;     // ms without incoming bytes before connection is closed, 0 to disable
+    struct worker_pool* workerPool; // pool jobs of this connection are offloaded to, NULL for none
+    int refCount;             // open connection and every unfinished job hold one, owner thread only
+    int closed;               // closed and buffers released, memory stays valid until refCount drops to 0
+    int corked;               // sends only queue bytes into outBuffer until tcp_connection_uncork()
+    int corkWritable;         // socket was not known to be full when connection was corked
+    int wantWritable;         // tcp_connection_want_writable() called, write callback is due even with nothing queued
+    struct buffer* zcLinger;  // output buffer of closed connection, kept with its socket until zerocopy sends complete
+    struct timer zcTimer;     // polls error queue of zcLinger socket
 
     conn_established_call_back connEstablishedCallBack;
     conn_msg_read_call_back connMsgReadCallBack;
@@ -29,6 +50,16 @@ struct tcp_connection {
     void* response; // for call back use
 };
 
+/**
+ * one allocation per connection, taken from the connSlab of the loop handling it and recycled on close
+ * connection, its channel and peer address are adjacent, so dispatching an event touches a few neighbouring cache lines
+ */
+struct tcp_connection_block {
+    struct tcp_connection conn;
+    struct channel channel;
+    struct sockaddr_storage peerAddr;
+};
+
 /**
  * create a new tcp connection
  * key operations:
@@ -43,7 +74,7 @@ tcp_connection_new(int connFd, struct sockaddr* peerAddr, struct event_loop* eve
     conn_msg_write_call_back connMsgWriteCallBack,
     conn_closed_call_back connClosedCallBack);
 
-/* using as socket fd EVENT_WRITE callback */
+/* using as socket fd EVENT_WRITE callback, connection write callback runs after bytes are written, or when tcp_connection_want_writable() asked for it */
 ssize_t handle_tcp_connection_write(struct tcp_connection* tcpConn);
 
 /* using as socket fd EVENT_READ callback */
@@ -55,7 +86,88 @@ ssize_t tcp_connection_send(struct tcp_connection* tcpConn, void* data, size_t s
 /* application-level interface, try to write all buffer readable bytes to socket buffer */
 ssize_t tcp_connection_send_buffer(struct tcp_connection* tcpConn, struct buffer* buff);
 
-/* handle connection closure by peer */
+/**
+ * application-level interface, send size bytes of data without copying what can't be sent at once:
+ * the rest is queued by reference, so data must stay unchanged until release(arg) is called,
+ * which happens exactly once, as soon as connection no longer needs data, i.e. bytes sent, dropped, or connection closed
+ */
+ssize_t tcp_connection_send_shared(struct tcp_connection* tcpConn, const void* data, size_t size,
+    buffer_release_callback release, void* arg);
+
+/**
+ * application-level interface, send len bytes of file fd starting from offset by sendfile()
+ * the region is queued behind bytes already in outBuffer, bytes sent afterwards are queued behind it,
+ * file bytes are never copied into user space.
+ * fd is not owned by connection, caller must keep it open until the region is sent or connection is closed.
+ * return number of bytes sent immediately, the rest is sent when socket becomes writable.
+ */
+ssize_t tcp_connection_sendfile(struct tcp_connection* tcpConn, int fd, off_t offset, size_t len);
+
+/**
+ * same as tcp_connection_sendfile(), but fd may be shared: release(arg) is called exactly once,
+ * as soon as connection no longer needs fd, i.e. region sent, dropped, or connection closed
+ */
+ssize_t tcp_connection_sendfile_shared(struct tcp_connection* tcpConn, int fd, off_t offset, size_t len,
+    buffer_release_callback release, void* arg);
+
+/**
+ * hold back sends of connection: bytes and file regions are queued into outBuffer without any syscall,
+ * so that responses built one after another leave by a single writev() on tcp_connection_uncork()
+ * no-op if already corked, only called by owner thread
+ */
+void tcp_connection_cork(struct tcp_connection* tcpConn);
+
+/**
+ * write everything queued while corked at once, the rest is sent when socket becomes writable
+ * return number of bytes written now, -1 if connection is closed
+ */
+ssize_t tcp_connection_uncork(struct tcp_connection* tcpConn);
+
+/**
+ * run connection write callback in next loop round even if nothing is queued by then, e.g. to produce more output
+ * after socket took every queued byte and no write event is coming. only called by owner thread
+ */
+void tcp_connection_want_writable(struct tcp_connection* tcpConn);
+
+/**
+ * switch connection channel to edge-triggered mode, must be called before its channel is registered
+ * EVENT_WRITE stays registered for the connection lifetime, reads drain socket until EAGAIN or TCP_READ_BUDGET
+ */
+void tcp_connection_set_edge_triggered(struct tcp_connection* tcpConn);
+
+/**
+ * enable MSG_ZEROCOPY on connection socket, writes of at least threshold queued bytes in outBuffer are sent
+ * without kernel copy, their blocks are released when completion is read from socket error queue.
+ * hand large payloads over by tcp_connection_send_buffer() with a chain buffer so they are not copied at all.
+ * return -1 if kernel doesn't support SO_ZEROCOPY
+ */
+int tcp_connection_enable_zerocopy(struct tcp_connection* tcpConn, size_t threshold);
+
+/**
+ * close connection after timeout ms without incoming bytes, 0 to disable
+ * every read only moves the connection timer in its loop timing wheel, so no syscall is spent per connection
+ * called before the channel is registered, or by the thread owning the connection
+ */
+void tcp_connection_set_idle_timeout(struct tcp_connection* tcpConn, uint64_t timeout);
+
+/**
+ * offload work to the worker pool of connection, its doneCallBack runs later in the thread owning the connection
+ * connection memory stays valid until doneCallBack returned, but it may be closed meanwhile:
+ * sending on a closed connection returns -1, check tcp_connection_is_closed() before doing more.
+ * return -1 if connection has no pool, is closed or every worker queue is full, so that caller can push back
+ */
+int tcp_connection_submit_work(struct tcp_connection* tcpConn, struct work* work);
+
+/* whether connection has been closed, only called by owner thread */
+int tcp_connection_is_closed(struct tcp_connection* tcpConn);
+
+/* keep connection memory alive across a deferred callback, only called by owner thread */
+void tcp_connection_hold(struct tcp_connection* tcpConn);
+
+/* drop a reference, connection is freed when it's closed and the last reference is dropped, only called by owner thread */
+void tcp_connection_release(struct tcp_connection* tcpConn);
+
+/* handle connection closure by peer, no-op for a connection already closed */
 int handle_tcp_connection_closed(struct tcp_connection* tcpConn);
 
 /* close tcp connection write end */
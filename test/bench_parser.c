@@ -0,0 +1,120 @@
+/**
+ * HTTP request parser throughput: a batch of pipelined requests is appended to a flat buffer and parsed with
+ * http_parser_execute()/http_parser_consume(), whole or delivered in reads of a few bytes to exercise resuming.
+ * for reference the same bytes are framed by buffer_find_CRLFCRLF() only, the cost of finding the header end
+ * without validating or slicing anything.
+ *
+ * usage: ./test/bench_parser [rounds] [read size ...]
+ */
+#include "http/http_parser.h"
+#include "scan.h"
+#include <time.h>
+
+#define BENCH_PIPELINE 64
+
+static const char* REQUEST =
+    "GET /static/js/app.3f2a91c.js?v=20240501&lang=en HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/124.0 Safari/537.36\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Accept-Language: en-US,en;q=0.9\r\n"
+    "Cache-Control: no-cache\r\n"
+    "Connection: keep-alive\r\n"
+    "Cookie: session=8f14e45fceea167a5a36dedd4bea2543; theme=dark; _ga=GA1.2.1234567890.1700000000\r\n"
+    "Referer: https://www.example.com/index.html\r\n"
+    "If-None-Match: \"5d41402abc4b2a76b9719d911017c592\"\r\n"
+    "\r\n";
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* requests parsed in rounds of BENCH_PIPELINE pipelined ones, bytes delivered step at a time, 0 for all at once */
+static uint64_t bench_parse(const char* batch, size_t len, int rounds, size_t step)
+{
+    struct buffer* buff = buffer_new();
+    struct http_parser parser;
+    http_parser_init(&parser);
+    uint64_t nrequest = 0;
+    if (step == 0) step = len;
+
+    for (int r = 0; r < rounds; r++) {
+        for (size_t off = 0; off < len; off += step) {
+            buffer_append(buff, batch + off, off + step < len ? step : len - off);
+            int ret;
+            while ((ret = http_parser_execute(&parser, buff)) == HTTP_PARSE_DONE) {
+                nrequest++;
+                http_parser_consume(&parser, buff);
+            }
+            if (ret == HTTP_PARSE_ERROR) {
+                printf("parse error %d\n", parser.error);
+                exit(1);
+            }
+        }
+    }
+    buffer_cleanup(buff);
+    return nrequest;
+}
+
+/* same batches framed at CRLFCRLF only */
+static uint64_t bench_frame(const char* batch, size_t len, int rounds)
+{
+    struct buffer* buff = buffer_new();
+    uint64_t nrequest = 0;
+    size_t scanned = 0;
+
+    for (int r = 0; r < rounds; r++) {
+        buffer_append(buff, batch, len);
+        ssize_t off;
+        while ((off = buffer_find_CRLFCRLF(buff, &scanned)) >= 0) {
+            nrequest++;
+            buffer_drain(buff, off + 4);
+            scanned = 0;
+        }
+    }
+    buffer_cleanup(buff);
+    return nrequest;
+}
+
+static void report(const char* name, uint64_t nrequest, size_t bytes, uint64_t elapsed)
+{
+    printf("%-24s %12.0f %10.0f %10.1f\n", name, nrequest / (elapsed / 1e9), (double)bytes / (elapsed / 1e3), (double)elapsed / nrequest);
+}
+
+int main(int argc, char** argv)
+{
+    int rounds = argc > 1 ? atoi(argv[1]) : 20000;
+    size_t reqlen = strlen(REQUEST);
+    size_t len = reqlen * BENCH_PIPELINE;
+    char* batch = malloc(len);
+    for (int i = 0; i < BENCH_PIPELINE; i++) memcpy(batch + i * reqlen, REQUEST, reqlen);
+    size_t total = len * rounds;
+
+    printf("%d byte requests, %d pipelined per round, %d rounds, scan kernels: %s\n", (int)reqlen, BENCH_PIPELINE, rounds, scan_impl_name());
+    printf("%-24s %12s %10s %10s\n", "", "requests/s", "MB/s", "ns/req");
+
+    uint64_t start = now_ns();
+    uint64_t n = bench_frame(batch, len, rounds);
+    report("CRLFCRLF framing", n, total, now_ns() - start);
+
+    static const size_t defaults[] = {0, 1460, 64, 8};
+    size_t nstep = argc > 2 ? argc - 2 : sizeof(defaults) / sizeof(defaults[0]);
+    for (size_t i = 0; i < nstep; i++) {
+        size_t step = argc > 2 ? (size_t)atoi(argv[i + 2]) : defaults[i];
+        char name[48];
+        if (step == 0) snprintf(name, sizeof(name), "parser, whole batch");
+        else snprintf(name, sizeof(name), "parser, %zu byte reads", step);
+        /* short reads append one syscall's worth at a time, fewer rounds keep runtime bounded */
+        int r = step == 0 || step >= 1024 ? rounds : rounds / 10 > 0 ? rounds / 10 : 1;
+        start = now_ns();
+        n = bench_parse(batch, len, r, step);
+        report(name, n, len * r, now_ns() - start);
+        if (n != (uint64_t)BENCH_PIPELINE * r) printf("parsed %lu of %lu requests\n", n, (uint64_t)BENCH_PIPELINE * r);
+    }
+    free(batch);
+    return 0;
+}
@@ -0,0 +1,129 @@
+/**
+ * channel registration at scale: n eventfds (or socketpairs standing in for accepted connections) are created,
+ * registered on an event_loop owned by this thread, looked up by fd and removed again, for n = 10k, 100k, 500k.
+ * every registration is chanmap_set() plus the dispatcher's ctl call, the same path an accepted connection takes.
+ *
+ * RLIMIT_NOFILE is raised to fit n before the loop (and its channel map) is created, which needs root above the hard limit.
+ *
+ * usage: ./test/bench_registration [eventfd|socketpair] [n ...]
+ */
+#include "event_loop.h"
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static long rss_kb()
+{
+    long kb = -1;
+    char line[128];
+    FILE* fp = fopen("/proc/self/status", "r");
+    if (fp == NULL) return -1;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (sscanf(line, "VmRSS: %ld", &kb) == 1) break;
+    }
+    fclose(fp);
+    return kb;
+}
+
+static int raise_nofile(rlim_t want)
+{
+    struct rlimit rlim;
+    if (getrlimit(RLIMIT_NOFILE, &rlim) < 0) return -1;
+    if (rlim.rlim_cur >= want) return 0;
+    rlim.rlim_cur = want;
+    if (rlim.rlim_max != RLIM_INFINITY && rlim.rlim_max < want) rlim.rlim_max = want;
+    return setrlimit(RLIMIT_NOFILE, &rlim);
+}
+
+static int on_read(void* data)
+{
+    return 0;
+}
+
+/* creation, add, lookup and remove cost of n channels in ns per fd */
+static void bench_run(int n, int pair)
+{
+    /* socketpair keeps the peer open too, two fds per channel */
+    if (raise_nofile((rlim_t)n * (pair ? 2 : 1) + 1024) < 0) {
+        printf("%9d  skipped, can't raise RLIMIT_NOFILE to %d: %s\n", n, n * (pair ? 2 : 1) + 1024, strerror(errno));
+        return;
+    }
+    int* fds = malloc(n * sizeof(int));
+    int* peers = pair ? malloc(n * sizeof(int)) : NULL;
+    struct channel* chans = malloc(n * sizeof(struct channel));
+    if (fds == NULL || chans == NULL || (pair && peers == NULL)) {
+        perror("malloc");
+        exit(1);
+    }
+    long rssBefore = rss_kb();
+    struct event_loop* eventLoop = event_loop_new(strdup("bench-registration"));
+    if (eventLoop == NULL) exit(1);
+
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < n; i++) {
+        if (pair) {
+            int sv[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sv) < 0) {
+                perror("socketpair");
+                exit(1);
+            }
+            fds[i] = sv[0];
+            peers[i] = sv[1];
+        } else if ((fds[i] = eventfd(0, EFD_NONBLOCK)) < 0) {
+            perror("eventfd");
+            exit(1);
+        }
+    }
+    uint64_t t1 = now_ns();
+    for (int i = 0; i < n; i++) {
+        channel_init(&chans[i], fds[i], EVENT_READ, on_read, NULL, NULL);
+        event_loop_add_channel_event(eventLoop, fds[i], &chans[i]);
+    }
+    uint64_t t2 = now_ns();
+    long rssAdded = rss_kb();
+    /* strided lookup so consecutive fds don't share a cache line */
+    unsigned long found = 0;
+    for (int i = 0; i < n; i++)
+        found += chanmap_get(eventLoop->channelMap, fds[(i * 7919L) % n]) != NULL;
+    uint64_t t3 = now_ns();
+    for (int i = 0; i < n; i++)
+        event_loop_remove_channel_event(eventLoop, fds[i], &chans[i]);
+    uint64_t t4 = now_ns();
+
+    if (found != (unsigned long)n) printf("lookup found %lu of %d channels\n", found, n);
+    printf("%9d %10.0f %10.0f %10.1f %10.0f %10ld\n", n, (double)(t1 - t0) / n, (double)(t2 - t1) / n,
+           (double)(t3 - t2) / n, (double)(t4 - t3) / n, rssAdded - rssBefore);
+
+    for (int i = 0; i < n; i++) {
+        close(fds[i]);
+        if (pair) close(peers[i]);
+    }
+    event_loop_cleanup(eventLoop);
+    free(eventLoop);
+    free(chans);
+    free(peers);
+    free(fds);
+}
+
+int main(int argc, char** argv)
+{
+    int pair = argc > 1 && strcmp(argv[1], "socketpair") == 0;
+    static const int defaults[] = {10000, 100000, 500000};
+
+    printf("%9s %10s %10s %10s %10s %10s\n", "fds", "create ns", "add ns", "lookup ns", "remove ns", "rss KB");
+    if (argc > 2) {
+        for (int i = 2; i < argc; i++) bench_run(atoi(argv[i]), pair);
+    } else {
+        for (size_t i = 0; i < sizeof(defaults) / sizeof(defaults[0]); i++) bench_run(defaults[i], pair);
+    }
+    return 0;
+}
@@ -0,0 +1,127 @@
+/**
+ * delimiter scanning: scan.h kernels (scalar, sse2, avx2) against memchr()/memmem() over header-like text whose
+ * only match is at its end, after a randomized check that every kernel agrees with memmem().
+ * then the resumable buffer_find_CRLFCRLF() is compared with rescanning from the front while a large header
+ * arrives in reads of 1460 bytes, the case it exists for.
+ *
+ * usage: ./test/bench_scan [text KB] [rounds]
+ */
+#define _GNU_SOURCE
+#include "buffer.h"
+#include "scan.h"
+#include <time.h>
+
+static const char* IMPLS[] = {"scalar", "sse2", "avx2"};
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static size_t memchr_offset(const char* p, size_t n, char c)
+{
+    const char* hit = memchr(p, c, n);
+    return hit != NULL ? (size_t)(hit - p) : n;
+}
+
+static size_t memmem_offset(const char* p, size_t n, const char* pat, size_t len)
+{
+    const char* hit = memmem(p, n, pat, len);
+    return hit != NULL ? (size_t)(hit - p) : n;
+}
+
+/* random short strings over an alphabet dense in '\r' and '\n', return number of mismatches */
+static int check_impl()
+{
+    char text[96];
+    int bad = 0;
+    for (int round = 0; round < 200000; round++) {
+        size_t n = rand() % sizeof(text);
+        for (size_t i = 0; i < n; i++) text[i] = "\r\nab:"[rand() % 5];
+        bad += scan_byte(text, n, ':') != memchr_offset(text, n, ':');
+        bad += scan_crlf(text, n) != memmem_offset(text, n, "\r\n", 2);
+        bad += scan_crlfcrlf(text, n) != memmem_offset(text, n, "\r\n\r\n", 4);
+    }
+    return bad;
+}
+
+/* GB/s of search over text, every search runs to its end */
+static double bench_search(const char* text, size_t n, int rounds, int which, int kernel)
+{
+    volatile size_t sink = 0;
+    uint64_t start = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        if (which == 0) sink += kernel ? scan_byte(text, n, '\0') : memchr_offset(text, n, '\0');
+        else if (which == 1) sink += kernel ? scan_crlf(text, n) : memmem_offset(text, n, "\r\n", 2);
+        else sink += kernel ? scan_crlfcrlf(text, n) : memmem_offset(text, n, "\r\n\r\n", 4);
+    }
+    (void)sink;
+    return (double)n * rounds / (now_ns() - start);
+}
+
+/* us to find the end of a header of n bytes arriving in reads of step bytes, resuming or rescanning every read */
+static double bench_arrival(const char* header, size_t n, size_t step, int rounds, int resume)
+{
+    struct buffer* buff = buffer_new();
+    uint64_t start = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        size_t scanned = 0;
+        ssize_t found = -1;
+        for (size_t off = 0; off < n && found < 0; off += step) {
+            buffer_append(buff, header + off, off + step < n ? step : n - off);
+            if (!resume) scanned = 0;
+            found = buffer_find_CRLFCRLF(buff, &scanned);
+        }
+        if (found != (ssize_t)n - 4) {
+            printf("header end at %zd instead of %zu\n", found, n - 4);
+            exit(1);
+        }
+        buffer_drain(buff, buffer_readable_size(buff));
+    }
+    double elapsed = (double)(now_ns() - start);
+    buffer_cleanup(buff);
+    return elapsed / rounds / 1e3;
+}
+
+int main(int argc, char** argv)
+{
+    size_t n = (argc > 1 ? atoi(argv[1]) : 64) << 10;
+    int rounds = argc > 2 ? atoi(argv[2]) : 20000;
+    const char* best = scan_impl_name();
+
+    /* header lines of 24 bytes, a CRLF ends each of them but no CRLFCRLF appears until the end */
+    if (n < 1024) n = 1024;
+    char* text = malloc(n);
+    for (size_t i = 0; i < n; i++) text[i] = i % 24 == 22 ? '\r' : i % 24 == 23 ? '\n' : 'a' + i % 23;
+    memcpy(text + n - 4, "\r\n\r\n", 4);
+    /* single byte and CRLF searches get text without any match, lone CRs keep the CRLF scan from skipping ahead */
+    char* plain = malloc(n);
+    for (size_t i = 0; i < n; i++) plain[i] = i % 24 == 22 ? '\r' : i % 24 == 23 ? ' ' : 'a' + i % 23;
+
+    printf("%zuKB text, %d rounds, %s selected at startup\n", n >> 10, rounds, best);
+    printf("%-8s %6s %12s %12s %12s\n", "impl", "check", "byte GB/s", "CRLF GB/s", "CRLFCRLF GB/s");
+    printf("%-8s %6s %12.2f %12.2f %12.2f\n", "libc", "-", bench_search(plain, n, rounds, 0, 0),
+           bench_search(plain, n, rounds, 1, 0), bench_search(text, n, rounds, 2, 0));
+    for (size_t i = 0; i < sizeof(IMPLS) / sizeof(IMPLS[0]); i++) {
+        if (scan_select(IMPLS[i]) < 0) {
+            printf("%-8s unsupported by cpu\n", IMPLS[i]);
+            continue;
+        }
+        int bad = check_impl();
+        printf("%-8s %6s %12.2f %12.2f %12.2f\n", IMPLS[i], bad == 0 ? "ok" : "FAIL", bench_search(plain, n, rounds, 0, 1),
+               bench_search(plain, n, rounds, 1, 1), bench_search(text, n, rounds, 2, 1));
+    }
+    scan_select(best);
+
+    printf("\n%-10s %14s %14s\n", "header", "rescan us", "resume us");
+    for (size_t size = 1 << 10; size <= n; size <<= 2) {
+        int r = rounds / (size >> 10) > 0 ? rounds / (size >> 10) : 1;
+        printf("%9zuK %14.2f %14.2f\n", size >> 10, bench_arrival(text + n - size, size, 1460, r, 0),
+               bench_arrival(text + n - size, size, 1460, r, 1));
+    }
+    free(plain);
+    free(text);
+    return 0;
+}
@@ -0,0 +1,128 @@
+/**
+ * MSG_ZEROCOPY crossover: the same bytes are queued into a chain buffer by reference and written to a TCP socket
+ * by buffer_write_fd(), once with plain writev() and once with MSG_ZEROCOPY, for write sizes from 4KB to 1MB.
+ * a receiver thread drains the socket, on loopback by default, or the bytes go to a discard sink at <host> <port>.
+ *
+ * usage: ./test/bench_zerocopy [MB per size] [host port]
+ */
+#include "buffer.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_MAX_WRITE (1 << 20)
+
+static char payload[BENCH_MAX_WRITE];
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void* receiver_routine(void* arg)
+{
+    int fd = (int)(intptr_t)arg;
+    static char sink[1 << 20];
+    while (read(fd, sink, sizeof(sink)) > 0)
+        ;
+    close(fd);
+    return NULL;
+}
+
+/* connected socket, either to sink at host:port or to a receiver thread on loopback */
+static int bench_connect(const char* host, int port, pthread_t* receiver)
+{
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    int listenFd = -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    if (host == NULL) {
+        listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(listenFd, 1) < 0 ||
+            getsockname(listenFd, (struct sockaddr*)&addr, &len) < 0) {
+            perror("listen");
+            return -1;
+        }
+    } else {
+        addr.sin_port = htons(port);
+        inet_pton(AF_INET, host, &addr.sin_addr);
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("connect");
+        return -1;
+    }
+    if (listenFd >= 0) {
+        int peer = accept(listenFd, NULL, NULL);
+        close(listenFd);
+        pthread_create(receiver, NULL, receiver_routine, (void*)(intptr_t)peer);
+    }
+    return fd;
+}
+
+/* MB/s writing total bytes in writes of size bytes, zerocopy if zc, and zerocopy sends kernel copied anyway */
+static double bench_run(const char* host, int port, size_t size, size_t total, int zc, unsigned long* copied)
+{
+    pthread_t receiver = 0;
+    int fd = bench_connect(host, port, &receiver);
+    if (fd < 0) exit(1);
+    int on = 1;
+    if (zc && setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) < 0) {
+        perror("SO_ZEROCOPY");
+        exit(1);
+    }
+
+    struct buffer* buff = buffer_chain_new(NULL);
+    buff->zerocopyThreshold = zc ? 1 : 0;
+    uint64_t start = now_ns();
+    for (size_t sent = 0; sent < total; sent += size) {
+        buffer_append_shared(buff, payload, size, NULL, NULL);
+        /* blocking socket, every queued byte is written */
+        while (buffer_readable_size(buff) > 0) {
+            if (buffer_write_fd(buff, fd) < 0) {
+                perror("write");
+                exit(1);
+            }
+        }
+        if (buffer_zerocopy_pending(buff))
+            buffer_zerocopy_complete(buff, fd);
+    }
+    /* payload must stay untouched until kernel let go of it */
+    while (buffer_zerocopy_pending(buff))
+        buffer_zerocopy_complete(buff, fd);
+    uint64_t elapsed = now_ns() - start;
+
+    *copied = buff->zcCopied;
+    buffer_cleanup(buff);
+    shutdown(fd, SHUT_WR);
+    if (receiver != 0) pthread_join(receiver, NULL);
+    close(fd);
+    return (double)total / (1 << 20) / (elapsed / 1e9);
+}
+
+int main(int argc, char** argv)
+{
+    size_t total = (argc > 1 ? atoi(argv[1]) : 1024) * (size_t)(1 << 20);
+    const char* host = argc > 3 ? argv[2] : NULL;
+    int port = argc > 3 ? atoi(argv[3]) : 0;
+    memset(payload, 'z', sizeof(payload));
+
+    printf("%10s %14s %14s %8s %10s\n", "write", "writev MB/s", "zerocopy MB/s", "ratio", "copied");
+    for (size_t size = 4 << 10; size <= BENCH_MAX_WRITE; size <<= 1) {
+        unsigned long copied = 0, ignored;
+        double plain = bench_run(host, port, size, total, 0, &ignored);
+        double zc = bench_run(host, port, size, total, 1, &copied);
+        printf("%9zuK %14.0f %14.0f %8.2f %10lu\n", size >> 10, plain, zc, zc / plain, copied);
+    }
+    return 0;
+}
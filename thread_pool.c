@@ -1,19 +1,30 @@
 #include "thread_pool.h"
 #include <assert.h>
+#include <time.h>
+
+static struct event_loop_thread* thread_pool_select_round_robin(struct thread_pool* threadPool);
+static struct event_loop_thread* thread_pool_select_least_connections(struct thread_pool* threadPool);
+static struct event_loop_thread* thread_pool_select_power_of_two(struct thread_pool* threadPool);
+static struct event_loop_thread* thread_pool_select_weighted(struct thread_pool* threadPool);
 
 struct thread_pool* thread_pool_new(struct event_loop* mainLoop, int nthread)
 {
     if (nthread <= 0) return NULL;
 
-    struct thread_pool* threadPool = malloc(sizeof(struct thread_pool));
+    struct thread_pool* threadPool = calloc(1, sizeof(struct thread_pool));
     if (threadPool == NULL) goto failed;
 
     threadPool->main_loop = mainLoop;
     threadPool->started = 0;
     threadPool->nthread = nthread;
     threadPool->next = 0;
+    threadPool->select = thread_pool_select_round_robin;
+    threadPool->seed = (unsigned int)time(NULL);
+    threadPool->weights = NULL;
+    threadPool->currentWeights = NULL;
 
-    threadPool->threads = malloc(sizeof(struct event_loop_thread) * nthread);
+    /* load counters of every thread are cache-line aligned */
+    threadPool->threads = aligned_alloc(CACHE_LINE_SIZE, sizeof(struct event_loop_thread) * nthread);
     if (threadPool->threads == NULL) goto failed;
 
     for (int i = 0; i < threadPool->nthread; i++)
@@ -22,8 +33,10 @@ struct thread_pool* thread_pool_new(struct event_loop* mainLoop, int nthread)
     return threadPool;
 
 failed:
-    if (threadPool->threads != NULL) free(threadPool->threads);
-    if (threadPool != NULL) free(threadPool);
+    if (threadPool != NULL) {
+        if (threadPool->threads != NULL) free(threadPool->threads);
+        free(threadPool);
+    }
     LOG(LT_WARN, "failed to created sub-reactor thread pool!");
     return NULL;
 }
@@ -45,11 +58,118 @@ struct event_loop_thread* thread_pool_select_thread(struct thread_pool* threadPo
 {
     assert(threadPool != NULL);
     assert(threadPool->nthread > 0);
+    return threadPool->select(threadPool);
+}
+
+int thread_pool_set_policy(struct thread_pool* threadPool, int policy, const int* weights)
+{
+    assert(threadPool != NULL);
+    switch (policy) {
+        case THREAD_POOL_ROUND_ROBIN:
+            threadPool->select = thread_pool_select_round_robin;
+            break;
+        case THREAD_POOL_LEAST_CONNECTIONS:
+            threadPool->select = thread_pool_select_least_connections;
+            break;
+        case THREAD_POOL_POWER_OF_TWO:
+            threadPool->select = thread_pool_select_power_of_two;
+            break;
+        case THREAD_POOL_WEIGHTED:
+            if (weights == NULL) return -1;
+            int* w = malloc(sizeof(int) * threadPool->nthread);
+            int* cw = calloc(threadPool->nthread, sizeof(int));
+            if (w == NULL || cw == NULL) {
+                free(w);
+                free(cw);
+                return -1;
+            }
+            for (int i = 0; i < threadPool->nthread; i++)
+                w[i] = weights[i] > 0 ? weights[i] : 0;
+            free(threadPool->weights);
+            free(threadPool->currentWeights);
+            threadPool->weights = w;
+            threadPool->currentWeights = cw;
+            threadPool->select = thread_pool_select_weighted;
+            break;
+        default:
+            LOG(LT_WARN, "unknown thread pool policy %d", policy);
+            return -1;
+    }
+    return 0;
+}
+
+void thread_pool_set_affinity(struct thread_pool* threadPool, const int* cpus, int rtPriority)
+{
+    assert(threadPool != NULL);
+    assert(!threadPool->started);
+    for (int i = 0; i < threadPool->nthread; i++) {
+        if (cpus != NULL) threadPool->threads[i].cpu = cpus[i];
+        threadPool->threads[i].rtPriority = rtPriority;
+    }
+}
+
+/* load of a thread in units of connections */
+static long thread_load(struct event_loop_thread* thread)
+{
+    long conns = atomic_load_explicit(&thread->load.activeConns, memory_order_relaxed);
+    long queued = atomic_load_explicit(&thread->load.queuedBytes, memory_order_relaxed);
+    return conns + queued / THREAD_POOL_BYTES_PER_CONN;
+}
+
+static struct event_loop_thread* thread_pool_select_round_robin(struct thread_pool* threadPool)
+{
     int selected = threadPool->next;
     threadPool->next = (selected + 1) % threadPool->nthread;
     return &threadPool->threads[selected];
 }
 
+/* scan every thread, ties are broken in turn so that idle threads share new connections */
+static struct event_loop_thread* thread_pool_select_least_connections(struct thread_pool* threadPool)
+{
+    int n = threadPool->nthread;
+    int start = threadPool->next;
+    int selected = start;
+    long least = atomic_load_explicit(&threadPool->threads[start].load.activeConns, memory_order_relaxed);
+    for (int i = 1; i < n && least > 0; i++) {
+        int idx = (start + i) % n;
+        long conns = atomic_load_explicit(&threadPool->threads[idx].load.activeConns, memory_order_relaxed);
+        if (conns < least) {
+            least = conns;
+            selected = idx;
+        }
+    }
+    threadPool->next = (start + 1) % n;
+    return &threadPool->threads[selected];
+}
+
+/* sample two distinct threads and take the less loaded, reads two counters instead of all of them */
+static struct event_loop_thread* thread_pool_select_power_of_two(struct thread_pool* threadPool)
+{
+    int n = threadPool->nthread;
+    if (n == 1) return &threadPool->threads[0];
+    int a = rand_r(&threadPool->seed) % n;
+    int b = rand_r(&threadPool->seed) % (n - 1);
+    if (b >= a) b++;
+    struct event_loop_thread* ta = &threadPool->threads[a];
+    struct event_loop_thread* tb = &threadPool->threads[b];
+    return thread_load(tb) < thread_load(ta) ? tb : ta;
+}
+
+/* smooth weighted round-robin: every pick raises all current weights by their weight, the highest wins and pays back the total */
+static struct event_loop_thread* thread_pool_select_weighted(struct thread_pool* threadPool)
+{
+    int total = 0, selected = 0;
+    for (int i = 0; i < threadPool->nthread; i++) {
+        threadPool->currentWeights[i] += threadPool->weights[i];
+        total += threadPool->weights[i];
+        if (threadPool->currentWeights[i] > threadPool->currentWeights[selected])
+            selected = i;
+    }
+    if (total == 0) return thread_pool_select_round_robin(threadPool);
+    threadPool->currentWeights[selected] -= total;
+    return &threadPool->threads[selected];
+}
+
 void thread_pool_cleanup(struct thread_pool* threadPool)
 {
     if (threadPool == NULL) return;
@@ -2,7 +2,19 @@
 #define THREAD_POOL_H
 #include "event_loop_thread.h"
 
+/* sub-reactor selection policies */
+#define THREAD_POOL_ROUND_ROBIN 0       // in turn
+#define THREAD_POOL_LEAST_CONNECTIONS 1 // fewest active connections
+#define THREAD_POOL_POWER_OF_TWO 2      // less loaded of two random threads, by active connections and queued bytes
+#define THREAD_POOL_WEIGHTED 3          // smooth weighted round-robin
+
+/* queued output bytes counted as one more active connection when comparing load */
+#define THREAD_POOL_BYTES_PER_CONN (64 << 10)
+
 struct event_loop;
+struct thread_pool;
+
+typedef struct event_loop_thread* (*thread_select_policy)(struct thread_pool* threadPool);
 
 /* sub-reactor thread pool */
 struct thread_pool {
@@ -12,6 +24,11 @@ struct thread_pool {
     int next;
     struct event_loop_thread* threads;
     int nthread;
+    /* selection policy, only used by main-reactor thread */
+    thread_select_policy select;
+    unsigned int seed;      // random state of power-of-two-choices
+    int* weights;           // weight of every thread, weighted policy only
+    int* currentWeights;
 };
 
 /**
@@ -26,11 +43,23 @@ struct thread_pool* thread_pool_new(struct event_loop* mainLoop, int nthread);
 void thread_pool_run(struct thread_pool* threadPool);
 
 /*
- * select a sub-reactor thread from thread pool
- * TODO: now polling, implement dynamic selection according to current connection count
+ * select a sub-reactor thread from thread pool with current policy, round-robin by default
  */
 struct event_loop_thread* thread_pool_select_thread(struct thread_pool* threadPool);
 
+/**
+ * set selection policy, one of THREAD_POOL_*
+ * weights gives the share of every thread for THREAD_POOL_WEIGHTED and is copied, ignored by other policies
+ * return -1 for unknown policy or invalid weights
+ */
+int thread_pool_set_policy(struct thread_pool* threadPool, int policy, const int* weights);
+
+/**
+ * place sub-reactor i on cpus[i] (AFFINITY_CPU_UNBOUND to leave it unpinned) with SCHED_FIFO rtPriority (0 for normal)
+ * cpus holds nthread entries or is NULL, must be called before thread_pool_run()
+ */
+void thread_pool_set_affinity(struct thread_pool* threadPool, const int* cpus, int rtPriority);
+
 /* clean up thread pool */
 void thread_pool_cleanup(struct thread_pool* threadPool);
 
@@ -0,0 +1,158 @@
+#include "timer_wheel.h"
+#include <time.h>
+
+uint64_t timer_now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+struct timer_wheel* timer_wheel_new(uint64_t now)
+{
+    struct timer_wheel* wheel = calloc(1, sizeof(struct timer_wheel));
+    if (wheel == NULL) return NULL;
+    wheel->now = now;
+    return wheel;
+}
+
+void timer_init(struct timer* timer, timer_callback callBack, void* data)
+{
+    timer->next = NULL;
+    timer->pprev = NULL;
+    timer->expire = 0;
+    timer->interval = 0;
+    timer->callBack = callBack;
+    timer->data = data;
+}
+
+int timer_is_armed(struct timer* timer)
+{
+    return timer->pprev != NULL;
+}
+
+static void timer_link(struct timer** slot, struct timer* timer)
+{
+    timer->next = *slot;
+    if (timer->next != NULL) timer->next->pprev = &timer->next;
+    *slot = timer;
+    timer->pprev = slot;
+}
+
+static void timer_unlink(struct timer* timer)
+{
+    *timer->pprev = timer->next;
+    if (timer->next != NULL) timer->next->pprev = timer->pprev;
+    timer->next = NULL;
+    timer->pprev = NULL;
+}
+
+/* place timer in the lowest level whose span covers its distance from wheel->now */
+static void timer_wheel_place(struct timer_wheel* wheel, struct timer* timer)
+{
+    /* already due, expire on next processed tick */
+    if (timer->expire < wheel->now) timer->expire = wheel->now;
+    uint64_t delta = timer->expire - wheel->now;
+    if (delta > TIMER_WHEEL_MAX_DELAY) {
+        timer->expire = wheel->now + TIMER_WHEEL_MAX_DELAY;
+        delta = TIMER_WHEEL_MAX_DELAY;
+    }
+
+    int level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (1ULL << (TIMER_WHEEL_BITS * (level + 1))))
+        level++;
+    int idx = (timer->expire >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+    timer_link(&wheel->slots[level][idx], timer);
+}
+
+void timer_wheel_add(struct timer_wheel* wheel, struct timer* timer, uint64_t expire)
+{
+    if (timer_is_armed(timer)) timer_unlink(timer);
+    else wheel->ntimer++;
+    timer->expire = expire;
+    timer_wheel_place(wheel, timer);
+}
+
+void timer_wheel_cancel(struct timer_wheel* wheel, struct timer* timer)
+{
+    if (!timer_is_armed(timer)) return;
+    timer_unlink(timer);
+    wheel->ntimer--;
+}
+
+/* move timers of one upper level slot down, their expiry is now within reach of lower levels */
+static void timer_wheel_cascade(struct timer_wheel* wheel, int level, int idx)
+{
+    struct timer* timer = wheel->slots[level][idx];
+    wheel->slots[level][idx] = NULL;
+    while (timer != NULL) {
+        struct timer* next = timer->next;
+        timer->pprev = NULL;
+        timer_wheel_place(wheel, timer);
+        timer = next;
+    }
+}
+
+int64_t timer_wheel_next_timeout(struct timer_wheel* wheel, uint64_t now, int64_t maxWait)
+{
+    if (wheel->ntimer == 0) return -1;
+
+    /* wheel runs ahead of now after expiring, tick wheel->now + i is i + lag ms away */
+    int64_t lag = (int64_t)(wheel->now - now);
+    for (int64_t i = 0; i < TIMER_WHEEL_SLOTS && i + lag < maxWait; i++) {
+        /* next tick wraps level 0 and cascades upper timers, which may be due right then */
+        if (((wheel->now + i) & TIMER_WHEEL_MASK) == 0)
+            return i + lag > 0 ? i + lag : 0;
+        if (wheel->slots[0][(wheel->now + i) & TIMER_WHEEL_MASK] != NULL)
+            return i + lag > 0 ? i + lag : 0;
+    }
+    return maxWait;
+}
+
+int timer_wheel_expire(struct timer_wheel* wheel, uint64_t now)
+{
+    int nexpired = 0;
+    while (wheel->now <= now) {
+        /* nothing armed, skip idle ticks at once */
+        if (wheel->ntimer == 0) {
+            wheel->now = now + 1;
+            break;
+        }
+
+        uint64_t tick = wheel->now;
+        int idx = tick & TIMER_WHEEL_MASK;
+        /* level n-1 wrapped around, bring timers of the current level n slot down */
+        for (int level = 1; idx == 0 && level < TIMER_WHEEL_LEVELS; level++) {
+            int upperIdx = (tick >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+            timer_wheel_cascade(wheel, level, upperIdx);
+            if (upperIdx != 0) break;
+        }
+
+        /* detach slot into a local list, callbacks may cancel any timer of it through pprev */
+        struct timer* expired = wheel->slots[0][idx];
+        wheel->slots[0][idx] = NULL;
+        if (expired != NULL) expired->pprev = &expired;
+        wheel->now++;
+
+        struct timer* timer;
+        while ((timer = expired) != NULL) {
+            timer_unlink(timer);
+            if (timer->interval > 0) {
+                /* rearm first so that callback can cancel or reschedule it */
+                timer->expire = tick + timer->interval;
+                timer_wheel_place(wheel, timer);
+            } else {
+                wheel->ntimer--;
+            }
+            nexpired++;
+            if (timer->callBack != NULL) timer->callBack(timer->data);
+        }
+    }
+    return nexpired;
+}
+
+void timer_wheel_cleanup(struct timer_wheel* wheel)
+{
+    if (wheel == NULL) return;
+    free(wheel);
+}
@@ -0,0 +1,69 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+#include <stdint.h>
+#include <stdlib.h>
+
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_BITS 8                              // slots per level = 256
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_MAX_DELAY ((1ULL << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_BITS)) - 1) // ~49 days in ms
+
+typedef int (*timer_callback)(void* data);
+
+/**
+ * timer entry, embedded in its owner so that arming and cancelling never allocate
+ * linked in one wheel slot by next/pprev, pprev == NULL means not armed
+ */
+struct timer {
+    struct timer* next;
+    struct timer** pprev;
+    uint64_t expire;        // absolute expiry in ms of monotonic clock
+    uint64_t interval;      // period in ms, 0 for one-shot
+    timer_callback callBack;
+    void* data;
+};
+
+/**
+ * hierarchical timing wheel with 1ms resolution, non-thread-safe, driven by its event_loop
+ * - level 0 holds timers expiring in the next 256ms, one slot per ms;
+ * - level n slot covers 256^n ms, its timers are cascaded down when level n-1 wraps around;
+ * - adding and cancelling are O(1), every timer is moved at most LEVELS-1 times before it expires.
+ */
+struct timer_wheel {
+    uint64_t now;           // every tick below it has been expired
+    int ntimer;
+    struct timer* slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+};
+
+/* monotonic clock in ms */
+uint64_t timer_now_ms();
+
+/* create a wheel starting at now */
+struct timer_wheel* timer_wheel_new(uint64_t now);
+
+/* init a timer entry before first use */
+void timer_init(struct timer* timer, timer_callback callBack, void* data);
+
+/* whether timer is waiting in a wheel */
+int timer_is_armed(struct timer* timer);
+
+/* arm timer to expire at expire ms, an armed timer is rescheduled */
+void timer_wheel_add(struct timer_wheel* wheel, struct timer* timer, uint64_t expire);
+
+/* disarm timer, no-op if it's not armed */
+void timer_wheel_cancel(struct timer_wheel* wheel, struct timer* timer);
+
+/**
+ * ms from now until the next tick that may expire a timer, at most maxWait, -1 if no timer is armed
+ * exact for timers in level 0, otherwise the time to next cascade
+ */
+int64_t timer_wheel_next_timeout(struct timer_wheel* wheel, uint64_t now, int64_t maxWait);
+
+/* run callbacks of every timer expiring up to now, periodic timers are rearmed before their callback runs */
+int timer_wheel_expire(struct timer_wheel* wheel, uint64_t now);
+
+/* free wheel, timers are owned by their users and left untouched */
+void timer_wheel_cleanup(struct timer_wheel* wheel);
+
+#endif
@@ -0,0 +1,207 @@
+#define _GNU_SOURCE // pthread_setname_np
+#include "worker_pool.h"
+#include "event_loop.h"
+#include "tcp_connection.h"
+#include <sched.h>
+#include <stdio.h>
+
+static void* worker_routine(void* arg);
+static void worker_pool_complete_task(void* arg);
+
+struct worker_pool* worker_pool_new(int nworker, size_t capacity)
+{
+    if (nworker <= 0) return NULL;
+    if (capacity == 0) capacity = WORKER_POOL_QUEUE_CAPACITY;
+
+    struct worker_pool* pool = calloc(1, sizeof(struct worker_pool));
+    if (pool == NULL) goto failed;
+    pool->nworker = nworker;
+    pool->capacity = capacity;
+    pthread_mutex_init(&pool->idleLock, NULL);
+    pthread_cond_init(&pool->idleCond, NULL);
+
+    /* deques of different workers are locked independently, keep them on separate cache lines */
+    pool->workers = aligned_alloc(CACHE_LINE_SIZE, sizeof(struct worker) * nworker);
+    if (pool->workers == NULL) goto failed;
+    memset(pool->workers, 0, sizeof(struct worker) * nworker);
+    for (int i = 0; i < nworker; i++) {
+        struct worker* worker = &pool->workers[i];
+        pthread_mutex_init(&worker->lock, NULL);
+        worker->pool = pool;
+        worker->index = i;
+        worker->jobs = malloc(sizeof(struct work*) * capacity);
+        if (worker->jobs == NULL) goto failed;
+    }
+    return pool;
+
+failed:
+    LOG(LT_WARN, "failed to create worker pool!");
+    if (pool != NULL) {
+        if (pool->workers != NULL) {
+            for (int i = 0; i < nworker; i++)
+                if (pool->workers[i].jobs != NULL) free(pool->workers[i].jobs);
+            free(pool->workers);
+        }
+        free(pool);
+    }
+    return NULL;
+}
+
+int worker_pool_run(struct worker_pool* pool)
+{
+    if (pool == NULL || pool->started) return 0;
+    for (int i = 0; i < pool->nworker; i++) {
+        if (pthread_create(&pool->workers[i].tid, NULL, worker_routine, &pool->workers[i]) != 0) {
+            LOG(LT_ERROR, "failed to create worker thread %d", i);
+            return -1;
+        }
+        pool->started++;
+    }
+    LOG(LT_INFO, "worker pool(%d) run successfully!", pool->nworker);
+    return 0;
+}
+
+int worker_pool_submit(struct worker_pool* pool, struct work* work)
+{
+    assert(work->eventLoop != NULL);
+    unsigned int start = atomic_fetch_add_explicit(&pool->next, 1, memory_order_relaxed);
+    for (int i = 0; i < pool->nworker; i++) {
+        struct worker* worker = &pool->workers[(start + i) % pool->nworker];
+        pthread_mutex_lock(&worker->lock);
+        if (worker->tail - worker->head < pool->capacity) {
+            work->pool = pool;
+            worker->jobs[worker->tail % pool->capacity] = work;
+            worker->tail++;
+            atomic_fetch_add(&pool->queued, 1);
+            pthread_mutex_unlock(&worker->lock);
+
+            atomic_fetch_add_explicit(&pool->submitted, 1, memory_order_relaxed);
+            /* pairs with worker_wait(): either the worker sees queued > 0, or we see it idle and signal it */
+            if (atomic_load(&pool->nidle) > 0) {
+                pthread_mutex_lock(&pool->idleLock);
+                pthread_cond_signal(&pool->idleCond);
+                pthread_mutex_unlock(&pool->idleLock);
+            }
+            return 0;
+        }
+        pthread_mutex_unlock(&worker->lock);
+    }
+    atomic_fetch_add_explicit(&pool->rejected, 1, memory_order_relaxed);
+    return -1;
+}
+
+/* take oldest job of own deque, otherwise the newest one of another worker */
+static struct work* worker_take(struct worker* self)
+{
+    struct worker_pool* pool = self->pool;
+    struct work* work = NULL;
+
+    pthread_mutex_lock(&self->lock);
+    if (self->head != self->tail) {
+        work = self->jobs[self->head % pool->capacity];
+        self->head++;
+    }
+    pthread_mutex_unlock(&self->lock);
+    if (work != NULL) return work;
+
+    for (int i = 1; i < pool->nworker && work == NULL; i++) {
+        struct worker* victim = &pool->workers[(self->index + i) % pool->nworker];
+        /* trylock, a thief never waits behind the victim or a submitter */
+        if (pthread_mutex_trylock(&victim->lock) != 0) continue;
+        if (victim->head != victim->tail) {
+            victim->tail--;
+            work = victim->jobs[victim->tail % pool->capacity];
+        }
+        pthread_mutex_unlock(&victim->lock);
+    }
+    if (work != NULL) atomic_fetch_add_explicit(&self->stolen, 1, memory_order_relaxed);
+    return work;
+}
+
+/* sleep until a job is submitted or pool stops */
+static void worker_wait(struct worker_pool* pool)
+{
+    pthread_mutex_lock(&pool->idleLock);
+    atomic_fetch_add(&pool->nidle, 1);
+    if (atomic_load(&pool->queued) == 0 && !atomic_load(&pool->stop))
+        pthread_cond_wait(&pool->idleCond, &pool->idleLock);
+    atomic_fetch_sub(&pool->nidle, 1);
+    pthread_mutex_unlock(&pool->idleLock);
+}
+
+static void* worker_routine(void* arg)
+{
+    struct worker* self = arg;
+    struct worker_pool* pool = self->pool;
+    char name[16];
+    snprintf(name, sizeof(name), "%s%d", WORKER_THREAD_PREFIX, self->index);
+    pthread_setname_np(pthread_self(), name);
+
+    while (!atomic_load_explicit(&pool->stop, memory_order_relaxed)) {
+        struct work* work = worker_take(self);
+        if (work == NULL) {
+            /* queued > 0 while deques look empty means a job is being pushed or its deque was busy, retry */
+            if (atomic_load(&pool->queued) > 0) sched_yield();
+            else worker_wait(pool);
+            continue;
+        }
+        atomic_fetch_sub(&pool->queued, 1);
+        atomic_fetch_add_explicit(&pool->running, 1, memory_order_relaxed);
+        if (work->workCallBack != NULL) work->workCallBack(work);
+        atomic_fetch_sub_explicit(&pool->running, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&self->executed, 1, memory_order_relaxed);
+        event_loop_queue_in_loop(work->eventLoop, worker_pool_complete_task, work);
+    }
+    return NULL;
+}
+
+void worker_pool_complete(struct work* work)
+{
+    /* doneCallBack may free work */
+    struct tcp_connection* tcpConn = work->tcpConn;
+    atomic_fetch_add_explicit(&work->pool->completed, 1, memory_order_relaxed);
+    if (work->doneCallBack != NULL) work->doneCallBack(work);
+    if (tcpConn != NULL) tcp_connection_release(tcpConn);
+}
+
+static void worker_pool_complete_task(void* arg)
+{
+    worker_pool_complete(arg);
+}
+
+long worker_pool_queued(struct worker_pool* pool)
+{
+    return atomic_load_explicit(&pool->queued, memory_order_relaxed);
+}
+
+void worker_pool_show_stats(struct worker_pool* pool)
+{
+    if (pool == NULL) return;
+    unsigned long stolen = 0;
+    for (int i = 0; i < pool->nworker; i++)
+        stolen += atomic_load_explicit(&pool->workers[i].stolen, memory_order_relaxed);
+    LOG(LT_INFO, "worker pool: queued = %ld, running = %ld, submitted = %lu, completed = %lu, rejected = %lu, stolen = %lu",
+        worker_pool_queued(pool), atomic_load_explicit(&pool->running, memory_order_relaxed),
+        atomic_load_explicit(&pool->submitted, memory_order_relaxed),
+        atomic_load_explicit(&pool->completed, memory_order_relaxed),
+        atomic_load_explicit(&pool->rejected, memory_order_relaxed), stolen);
+}
+
+void worker_pool_cleanup(struct worker_pool* pool)
+{
+    if (pool == NULL) return;
+    atomic_store(&pool->stop, 1);
+    pthread_mutex_lock(&pool->idleLock);
+    pthread_cond_broadcast(&pool->idleCond);
+    pthread_mutex_unlock(&pool->idleLock);
+    for (int i = 0; i < pool->started; i++)
+        pthread_join(pool->workers[i].tid, NULL);
+    for (int i = 0; i < pool->nworker; i++) {
+        pthread_mutex_destroy(&pool->workers[i].lock);
+        free(pool->workers[i].jobs);
+    }
+    pthread_mutex_destroy(&pool->idleLock);
+    pthread_cond_destroy(&pool->idleCond);
+    free(pool->workers);
+    free(pool);
+}
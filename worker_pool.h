@@ -0,0 +1,97 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include "mpsc_queue.h" // CACHE_LINE_SIZE
+
+#define WORKER_POOL_QUEUE_CAPACITY 1024 // default jobs queued per worker
+#define WORKER_THREAD_PREFIX "worker-"
+
+struct event_loop;
+struct tcp_connection;
+struct worker_pool;
+struct work;
+
+typedef void (*work_callback)(struct work* work);
+
+/**
+ * job offloaded from an event_loop to a worker thread, memory owned by submitter
+ * workCallBack runs in a worker and must not touch state owned by the loop, e.g. connection buffers;
+ * doneCallBack then runs in the owner thread of eventLoop, where the result can be sent, and may free the work.
+ */
+struct work {
+    work_callback workCallBack;
+    work_callback doneCallBack;
+    struct event_loop* eventLoop;   // loop the completion is posted to
+    struct tcp_connection* tcpConn; // connection kept alive until doneCallBack returned, NULL for none
+    void* data;                     // for call back use
+    struct worker_pool* pool;       // set by worker_pool_submit()
+};
+
+/* one worker thread and its bounded job deque */
+struct worker {
+    _Alignas(CACHE_LINE_SIZE) pthread_mutex_t lock;
+    struct work** jobs;     // ring of capacity entries
+    size_t head;            // owner takes oldest job from head
+    size_t tail;            // submitters append at tail, thieves take newest job before tail
+    struct worker_pool* pool;
+    pthread_t tid;
+    int index;
+    atomic_ulong executed;
+    atomic_ulong stolen;    // jobs this worker took from other workers
+};
+
+/**
+ * pool of worker threads for blocking or cpu-heavy handlers, decoupled from reactors
+ * - every worker owns a bounded deque, jobs are submitted round-robin and a full deque passes the job to the next one;
+ * - an idle worker steals from the others before going to sleep, so one long job doesn't hold back jobs queued behind it;
+ * - submitting fails when every deque is full, the caller decides how to push back, e.g. stop reading from the connection;
+ * - finished jobs are posted back to their event_loop, submitters are woken only when some worker sleeps.
+ */
+struct worker_pool {
+    struct worker* workers;
+    int nworker;
+    size_t capacity;
+    int started;
+    atomic_uint next;
+    atomic_int stop;
+
+    /* idle workers sleep on idleCond, nidle tells submitters whether signaling is needed */
+    pthread_mutex_t idleLock;
+    pthread_cond_t idleCond;
+    atomic_int nidle;
+
+    /* metrics */
+    atomic_long queued;     // jobs waiting in deques
+    atomic_long running;    // jobs being executed
+    atomic_ulong submitted;
+    atomic_ulong rejected;  // submissions refused because every deque was full
+    atomic_ulong completed; // jobs whose doneCallBack has run
+};
+
+/* create a pool of nworker threads with capacity jobs per worker deque, threads start in worker_pool_run() */
+struct worker_pool* worker_pool_new(int nworker, size_t capacity);
+
+/* start worker threads */
+int worker_pool_run(struct worker_pool* pool);
+
+/**
+ * queue work, any thread, work->eventLoop must be set
+ * return -1 if every deque is full, work is untouched then
+ */
+int worker_pool_submit(struct worker_pool* pool, struct work* work);
+
+/* finish work in owner thread of its event_loop: run doneCallBack, then drop the connection reference */
+void worker_pool_complete(struct work* work);
+
+/* jobs waiting to be executed */
+long worker_pool_queued(struct worker_pool* pool);
+
+/* log queue depth and counters */
+void worker_pool_show_stats(struct worker_pool* pool);
+
+/* stop and join worker threads, queued jobs are dropped, free pool */
+void worker_pool_cleanup(struct worker_pool* pool);
+
+#endif